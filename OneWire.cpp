@@ -144,30 +144,145 @@ sample code bearing this copyright.
 //--------------------------------------------------------------------------
 */
 
+#ifdef ARDUINO
 #include <Arduino.h>
+#endif
 #include "OneWire.h"
 #include "util/OneWire_direct_gpio.h"
 
 #ifdef ARDUINO_ARCH_ESP32
-// due to the dual core esp32, a critical section works better than disabling interrupts
-#  define noInterrupts() {portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;portENTER_CRITICAL(&mux)
-#  define interrupts() portEXIT_CRITICAL(&mux);}
+// due to the dual core esp32, a critical section works better than disabling
+// interrupts; OneWire_direct_gpio.h makes them lock onewire_mux, see below
 // for info on this, search "IRAM_ATTR" at https://docs.espressif.com/projects/esp-idf/en/latest/esp32/api-guides/general-notes.html 
 #  define CRIT_TIMING IRAM_ATTR
 #else
 #  define CRIT_TIMING 
 #endif
 
+#if ONEWIRE_TELEMETRY
+// The slots time each interrupts-disabled window into the telemetry of
+// the bus which ran them.  The window is inside the bus's critical
+// section, so nothing else touches these fields meanwhile.
+static inline void irq_window(OneWireTelemetry *t, unsigned long usec)
+{
+	t->irq_usec += usec;
+	if (usec > t->irq_max_usec) t->irq_max_usec = usec;
+}
+
+#  define SLOT_IRQ_OFF()  (irq->irq_start = micros())
+#  define SLOT_IRQ_ON()   irq_window(irq, micros() - irq->irq_start)
+#  define SLOT_IRQ_PARAM  , OneWireTelemetry *irq
+#  define SLOT_IRQ_ARG    , &telemetry
+#  define COUNT(field, n) (telemetry.field += (n))
+#else
+#  define COUNT(field, n)
+#endif
+
+#if ONEWIRE_TRACE
+#  define TRACE(op, v)             trace.add(ONEWIRE_TRACE_##op, (v))
+#  define TRACE_BYTES(op, buf, n)  trace.add_bytes(ONEWIRE_TRACE_##op, (buf), (n))
+#  define TRACE_CRC_ERROR()        (trace.paused |= trace.stop_on_error)
+#else
+#  define TRACE(op, v)
+#  define TRACE_BYTES(op, buf, n)
+#  define TRACE_CRC_ERROR()
+#endif
+
+#if ONEWIRE_AUTO_SELECT
+// select_flags
+#  define SELECT_AUTO     0x01    // set_auto_select(true)
+#  define SELECT_RESUME   0x02    // selected[] has its Resume flag set
+#  define SELECT_SINGLE   0x04    // selected[] is the only device on the bus
+#  define SELECT_FRESH    0x08    // a reset, and no ROM command since
+// a write straight after a reset is a ROM command select() didn't send
+#  define ROM_COMMAND()   do { if (select_flags & SELECT_FRESH) addressed(NULL); } while (0)
+#else
+#  define ROM_COMMAND()
+#endif
+#include "util/OneWire_direct_slots.h"
+
+#ifdef ARDUINO_ARCH_ESP32
+// the critical sections in OneWire's functions lock this bus
+#  define onewire_mux (&mux)
+#endif
+
+#if ONEWIRE_TELEMETRY
+void OneWireTelemetry::clear(void)
+{
+	uint8_t *p = (uint8_t *)this;
+	for (uint16_t i = 0; i < sizeof(*this); i++) p[i] = 0;
+}
+#endif
+
 
 void OneWire::begin(uint8_t pin)
 {
 	pinMode(pin, INPUT);
 	bitmask = PIN_TO_BITMASK(pin);
 	baseReg = PIN_TO_BASEREG(pin);
-#if ONEWIRE_SEARCH
+	speed = ONEWIRE_STANDARD;
+	timing = &OneWireTiming::standard;
+#if ONEWIRE_BACKEND
+	backend = NULL;
+#endif
+#if ONEWIRE_TELEMETRY
+	telemetry.clear();
+#endif
+#if ONEWIRE_TRACE
+	trace.clear();
+#endif
+#if ONEWIRE_SEARCH && ONEWIRE_SEARCH_STATE
+	reset_search();
+#endif
+#if ONEWIRE_AUTO_SELECT
+	select_flags = 0;
+#endif
+#if ONEWIRE_LOCK
+	if (!bus_lock) bus_lock = xSemaphoreCreateRecursiveMutex();
+#endif
+}
+
+#if ONEWIRE_BACKEND
+void OneWire::begin(OneWireBackend &bus)
+{
+	bitmask = 0;
+	baseReg = NULL;
+	speed = ONEWIRE_STANDARD;
+	timing = &OneWireTiming::standard;
+	backend = &bus;
+#if ONEWIRE_TELEMETRY
+	telemetry.clear();
+#endif
+#if ONEWIRE_TRACE
+	trace.clear();
+#endif
+#if ONEWIRE_SEARCH && ONEWIRE_SEARCH_STATE
 	reset_search();
 #endif
+#if ONEWIRE_AUTO_SELECT
+	select_flags = 0;
+#endif
+#if ONEWIRE_LOCK
+	if (!bus_lock) bus_lock = xSemaphoreCreateRecursiveMutex();
+#endif
 }
+#endif
+
+#if ONEWIRE_LOCK
+// A recursive mutex, so a task can hold the bus with OneWireLock and
+// still call transaction(), which takes it again
+bool OneWire::lock(uint32_t timeout)
+{
+	if (!bus_lock) return true;
+	return xSemaphoreTakeRecursive(bus_lock, timeout == ONEWIRE_LOCK_FOREVER ?
+		portMAX_DELAY : pdMS_TO_TICKS(timeout)) == pdTRUE;
+}
+
+void OneWire::unlock(void)
+{
+	if (bus_lock) xSemaphoreGiveRecursive(bus_lock);
+}
+#endif
 
 
 // Perform the onewire reset function.  We will wait up to 250uS for
@@ -180,29 +295,23 @@ uint8_t CRIT_TIMING OneWire::reset(void)
 {
 	IO_REG_TYPE mask IO_REG_MASK_ATTR = bitmask;
 	__attribute__((unused)) volatile IO_REG_TYPE *reg IO_REG_BASE_ATTR = baseReg;
-	uint8_t r;
-	uint8_t retries = 125;
 
-	noInterrupts();
-	DIRECT_MODE_INPUT(reg, mask);
-	interrupts();
-	// wait until the wire is high... just in case
-	do {
-		if (--retries == 0) return 0;
-		delayMicroseconds(2);
-	} while ( !DIRECT_READ(reg, mask));
+	uint8_t r;
 
-	noInterrupts();
-	DIRECT_WRITE_LOW(reg, mask);
-	DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
-	interrupts();
-	delayMicroseconds(480);
-	noInterrupts();
-	DIRECT_MODE_INPUT(reg, mask);	// allow it to float
-	delayMicroseconds(70);
-	r = !DIRECT_READ(reg, mask);
-	interrupts();
-	delayMicroseconds(410);
+#if ONEWIRE_BACKEND
+	if (backend) {
+		r = backend->reset();
+	} else
+#endif
+	{
+		r = slot_reset(reg, mask, speed, timing ONEWIRE_MUX_ARG(onewire_mux) SLOT_IRQ_ARG);
+	}
+	COUNT(resets, 1);
+	COUNT(no_presence, !r);
+	TRACE(RESET, r);
+#if ONEWIRE_AUTO_SELECT
+	select_flags |= SELECT_FRESH;
+#endif
 	return r;
 }
 
@@ -215,23 +324,16 @@ void CRIT_TIMING OneWire::write_bit(uint8_t v)
 	IO_REG_TYPE mask IO_REG_MASK_ATTR = bitmask;
 	__attribute__((unused)) volatile IO_REG_TYPE *reg IO_REG_BASE_ATTR = baseReg;
 
-	if (v & 1) {
-		noInterrupts();
-		DIRECT_WRITE_LOW(reg, mask);
-		DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
-		delayMicroseconds(10);
-		DIRECT_WRITE_HIGH(reg, mask);	// drive output high
-		interrupts();
-		delayMicroseconds(55);
-	} else {
-		noInterrupts();
-		DIRECT_WRITE_LOW(reg, mask);
-		DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
-		delayMicroseconds(65);
-		DIRECT_WRITE_HIGH(reg, mask);	// drive output high
-		interrupts();
-		delayMicroseconds(5);
+	COUNT(bits_written, 1);
+	TRACE(WRITE_BIT, v & 1);
+	ROM_COMMAND();
+#if ONEWIRE_BACKEND
+	if (backend) {
+		backend->write_bit(v);
+		return;
 	}
+#endif
+	slot_write(reg, mask, speed, timing, v ONEWIRE_MUX_ARG(onewire_mux) SLOT_IRQ_ARG);
 }
 
 //
@@ -242,17 +344,19 @@ uint8_t CRIT_TIMING OneWire::read_bit(void)
 {
 	IO_REG_TYPE mask IO_REG_MASK_ATTR = bitmask;
 	__attribute__((unused)) volatile IO_REG_TYPE *reg IO_REG_BASE_ATTR = baseReg;
+
 	uint8_t r;
 
-	noInterrupts();
-	DIRECT_MODE_OUTPUT(reg, mask);
-	DIRECT_WRITE_LOW(reg, mask);
-	delayMicroseconds(3);
-	DIRECT_MODE_INPUT(reg, mask);	// let pin float, pull up will raise
-	delayMicroseconds(10);
-	r = DIRECT_READ(reg, mask);
-	interrupts();
-	delayMicroseconds(53);
+	COUNT(bits_read, 1);
+#if ONEWIRE_BACKEND
+	if (backend) {
+		r = backend->read_bit();
+	} else
+#endif
+	{
+		r = slot_read(reg, mask, speed, timing ONEWIRE_MUX_ARG(onewire_mux) SLOT_IRQ_ARG);
+	}
+	TRACE(READ_BIT, r);
 	return r;
 }
 
@@ -263,11 +367,22 @@ uint8_t CRIT_TIMING OneWire::read_bit(void)
 // go tri-state at the end of the write to avoid heating in a short or
 // other mishap.
 //
-void OneWire::write(uint8_t v, uint8_t power /* = 0 */) {
+void CRIT_TIMING OneWire::write(uint8_t v, uint8_t power /* = 0 */) {
+    IO_REG_TYPE mask IO_REG_MASK_ATTR = bitmask;
+    __attribute__((unused)) volatile IO_REG_TYPE *reg IO_REG_BASE_ATTR = baseReg;
     uint8_t bitMask;
 
+    COUNT(bytes_written, 1);
+    TRACE(WRITE_BYTE, v);
+    ROM_COMMAND();
+#if ONEWIRE_BACKEND
+    if (backend) {
+	backend->write(v, power);
+	return;
+    }
+#endif
     for (bitMask = 0x01; bitMask; bitMask <<= 1) {
-	OneWire::write_bit( (bitMask & v)?1:0);
+	slot_write(reg, mask, speed, timing, v & bitMask ONEWIRE_MUX_ARG(onewire_mux) SLOT_IRQ_ARG);
     }
     if ( !power) {
 	noInterrupts();
@@ -278,6 +393,15 @@ void OneWire::write(uint8_t v, uint8_t power /* = 0 */) {
 }
 
 void OneWire::write_bytes(const uint8_t *buf, uint16_t count, bool power /* = 0 */) {
+#if ONEWIRE_BACKEND
+  if (backend) {
+    ROM_COMMAND();
+    COUNT(bytes_written, count);
+    TRACE_BYTES(WRITE_BYTE, buf, count);
+    backend->write_bytes(buf, count, power);
+    return;
+  }
+#endif
   for (uint16_t i = 0 ; i < count ; i++)
     write(buf[i]);
   if (!power) {
@@ -291,17 +415,36 @@ void OneWire::write_bytes(const uint8_t *buf, uint16_t count, bool power /* = 0
 //
 // Read a byte
 //
-uint8_t OneWire::read() {
+uint8_t CRIT_TIMING OneWire::read() {
+    IO_REG_TYPE mask IO_REG_MASK_ATTR = bitmask;
+    __attribute__((unused)) volatile IO_REG_TYPE *reg IO_REG_BASE_ATTR = baseReg;
     uint8_t bitMask;
     uint8_t r = 0;
 
-    for (bitMask = 0x01; bitMask; bitMask <<= 1) {
-	if ( OneWire::read_bit()) r |= bitMask;
+    COUNT(bytes_read, 1);
+#if ONEWIRE_BACKEND
+    if (backend) {
+	r = backend->read();
+    } else
+#endif
+    {
+	for (bitMask = 0x01; bitMask; bitMask <<= 1) {
+	    if (slot_read(reg, mask, speed, timing ONEWIRE_MUX_ARG(onewire_mux) SLOT_IRQ_ARG)) r |= bitMask;
+	}
     }
+    TRACE(READ_BYTE, r);
     return r;
 }
 
 void OneWire::read_bytes(uint8_t *buf, uint16_t count) {
+#if ONEWIRE_BACKEND
+  if (backend) {
+    COUNT(bytes_read, count);
+    backend->read_bytes(buf, count);
+    TRACE_BYTES(READ_BYTE, buf, count);
+    return;
+  }
+#endif
   for (uint16_t i = 0 ; i < count ; i++)
     buf[i] = read();
 }
@@ -313,6 +456,13 @@ void OneWire::select(const uint8_t rom[8])
 {
     uint8_t i;
 
+#if ONEWIRE_AUTO_SELECT
+    uint8_t cmd = select_command(rom);
+    if (cmd != 0x55) {
+        write(cmd);        // Skip ROM or Resume ROM
+        return;
+    }
+#endif
     write(0x55);           // Choose ROM
 
     for (i = 0; i < 8; i++) write(rom[i]);
@@ -323,32 +473,493 @@ void OneWire::select(const uint8_t rom[8])
 //
 void OneWire::skip()
 {
+#if ONEWIRE_AUTO_SELECT
+    addressed(NULL);
+#endif
     write(0xCC);           // Skip ROM
 }
 
+#if ONEWIRE_AUTO_SELECT
+void OneWire::set_auto_select(bool on)
+{
+    if (on) select_flags |= SELECT_AUTO;
+    else select_flags &= ~SELECT_AUTO;
+}
+
+void OneWire::forget_selected(void)
+{
+    select_flags &= SELECT_AUTO | SELECT_FRESH;
+}
+
+// Families with the Resume ROM command
+static bool resumable(uint8_t family)
+{
+    switch (family) {
+    case 0x1C:  // DS28E04
+    case 0x29:  // DS2408
+    case 0x2D:  // DS2431
+    case 0x3A:  // DS2413
+    case 0x42:  // DS28EA00
+    case 0x43:  // DS28EC20
+        return true;
+    }
+    return false;
+}
+
+static bool same_rom(const uint8_t *a, const uint8_t *b)
+{
+    for (uint8_t i = 0; i < 8; i++) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+//
+// After a ROM command: 'rom' was matched or found by a search, and is
+// now the only device with its Resume flag set.  NULL for any other
+// command, which clears the flag of every device.
+//
+void OneWire::addressed(const uint8_t *rom)
+{
+    select_flags &= ~(SELECT_FRESH | SELECT_RESUME);
+    if (!rom) return;
+    if (!same_rom(rom, selected)) {
+        // the only device stays remembered, this one isn't on the bus
+        if (select_flags & SELECT_SINGLE) return;
+        for (uint8_t i = 0; i < 8; i++) selected[i] = rom[i];
+    }
+    if (resumable(rom[0])) select_flags |= SELECT_RESUME;
+}
+
+//
+// The ROM command to address 'rom' with: Skip ROM or Resume ROM if
+// that reaches it alone, otherwise Match ROM (the ROM follows).
+//
+uint8_t OneWire::select_command(const uint8_t *rom)
+{
+    if ((select_flags & SELECT_AUTO) && (select_flags & (SELECT_SINGLE | SELECT_RESUME)) &&
+        same_rom(rom, selected)) {
+        select_flags &= ~SELECT_FRESH;
+        if (select_flags & SELECT_SINGLE) {
+            select_flags &= ~SELECT_RESUME;
+            return 0xCC;       // Skip ROM
+        }
+        return 0xA5;           // Resume ROM
+    }
+    addressed(rom);
+    return 0x55;               // Match ROM
+}
+#endif
+
+bool OneWire::set_speed(uint8_t s)
+{
+#if ONEWIRE_BACKEND
+    if (backend && !backend->set_speed(s)) return false;
+#endif
+    speed = s;
+    return true;
+}
+
+// reset low, sample, high, recovery; write 1 low, high; write 0 low,
+// high; read low, sample, high; fast reset
+const OneWireTiming OneWireTiming::standard = {
+    480, 70, 410, 10, 10, 55, 65, 5, 3, 10, 53, false
+};
+
+// 60us slots and the shortest recovery a short bus needs after a 0.
+// The reset is already at its minimum, see fast_reset.
+const OneWireTiming OneWireTiming::minimum = {
+    480, 70, 410, 5, 6, 55, 60, 2, 3, 9, 49, false
+};
+
+// the write 1 and read low times stay short, to leave the slow rise of
+// a long bus time to reach high before the devices sample it
+const OneWireTiming OneWireTiming::conservative = {
+    560, 70, 500, 20, 6, 84, 75, 15, 3, 9, 78, false
+};
+
+bool OneWire::set_timing(const OneWireTiming *t)
+{
+#if ONEWIRE_BACKEND
+    if (backend && !backend->set_timing(t)) return false;
+#endif
+    timing = t;
+    return true;
+}
+
+//
+// Overdrive Skip ROM.  The command goes at standard speed, and
+// everything after it at overdrive speed.
+//
+void OneWire::overdrive_skip()
+{
+#if ONEWIRE_AUTO_SELECT
+    addressed(NULL);
+#endif
+    write(0x3C);           // Overdrive Skip ROM
+    set_speed(ONEWIRE_OVERDRIVE);
+}
+
+//
+// Overdrive Match ROM.  The ROM itself is sent at overdrive speed.
+//
+void OneWire::overdrive_select(const uint8_t rom[8])
+{
+    uint8_t i;
+
+#if ONEWIRE_AUTO_SELECT
+    addressed(rom);
+#endif
+    write(0x69);           // Overdrive Match ROM
+    set_speed(ONEWIRE_OVERDRIVE);
+    for (i = 0; i < 8; i++) write(rom[i]);
+}
+
+//
+// Search triplet: the id bit, its complement, then the chosen direction
+//
+uint8_t OneWire::triplet(uint8_t direction)
+{
+    uint8_t id_bit, cmp_id_bit;
+
+#if ONEWIRE_BACKEND
+    if (backend) {
+        uint8_t r = backend->triplet(direction);
+        COUNT(bits_read, 2);
+        COUNT(bits_written, 1);
+        TRACE(READ_BIT, r & 1);
+        TRACE(READ_BIT, (r >> 1) & 1);
+        TRACE(WRITE_BIT, (r >> 2) & 1);
+        return r;
+    }
+#endif
+    id_bit = read_bit();
+    cmp_id_bit = read_bit();
+    if (id_bit != cmp_id_bit) direction = id_bit;
+    write_bit(direction);
+    return id_bit | (cmp_id_bit << 1) | (direction << 2);
+}
+
 void OneWire::depower()
 {
+#if ONEWIRE_BACKEND
+	if (backend) {
+		backend->depower();
+		return;
+	}
+#endif
 	noInterrupts();
 	DIRECT_MODE_INPUT(baseReg, bitmask);
 	interrupts();
 }
 
+//
+// The 1-Wire CRCs are sent LSB first, the same as the data, so both can
+// be updated a bit at a time in the recovery time after each read slot.
+// 'poly' is 0x8C for the CRC8, 0xA001 for the CRC16, or 0 for none.  Run
+// over the data and the CRC the device sent, the result is 0 for a good
+// CRC8, or ONEWIRE_CRC16_RESIDUE for a good (inverted) CRC16.
+//
+#define ONEWIRE_POLY_CRC8       0x8C
+#define ONEWIRE_POLY_CRC16      0xA001
+#define ONEWIRE_CRC16_RESIDUE   0xB001
+
+static inline __attribute__((always_inline))
+uint16_t crc_bit(uint16_t crc, uint8_t bit, uint16_t poly)
+{
+	uint8_t mix = (crc ^ bit) & 1;
+	crc >>= 1;
+	if (mix) crc ^= poly;
+	return crc;
+}
+
+static uint16_t crc_bytes(const uint8_t *buf, uint16_t count, uint16_t crc, uint16_t poly)
+{
+	if (!poly) return crc;
+	while (count--) {
+		uint8_t v = *buf++;
+		for (uint8_t i = 8; i; i--) {
+			crc = crc_bit(crc, v, poly);
+			v >>= 1;
+		}
+	}
+	return crc;
+}
+
+//
+// Read bytes, updating a CRC as each bit arrives
+//
+uint16_t CRIT_TIMING OneWire::read_bytes_crc(uint8_t *buf, uint16_t count,
+	uint16_t crc, uint16_t poly)
+{
+	IO_REG_TYPE mask IO_REG_MASK_ATTR = bitmask;
+	__attribute__((unused)) volatile IO_REG_TYPE *reg IO_REG_BASE_ATTR = baseReg;
+	uint8_t bitMask, v, b;
+
+	COUNT(bytes_read, count);
+#if ONEWIRE_BACKEND
+	if (backend) {
+		backend->read_bytes(buf, count);
+		TRACE_BYTES(READ_BYTE, buf, count);
+		return crc_bytes(buf, count, crc, poly);
+	}
+#endif
+	for (uint16_t i = 0; i < count; i++) {
+		v = 0;
+		for (bitMask = 0x01; bitMask; bitMask <<= 1) {
+			b = slot_read(reg, mask, speed, timing ONEWIRE_MUX_ARG(onewire_mux) SLOT_IRQ_ARG);
+			if (b) v |= bitMask;
+			if (poly) crc = crc_bit(crc, b, poly);
+		}
+		buf[i] = v;
+	}
+	TRACE_BYTES(READ_BYTE, buf, count);
+	return crc;
+}
+
+#if ONEWIRE_CRC
+bool OneWire::read_bytes_crc8(uint8_t *buf, uint16_t count, uint8_t crc)
+{
+	if (read_bytes_crc(buf, count, crc, ONEWIRE_POLY_CRC8) == 0) return true;
+	COUNT(crc_errors, 1);
+	TRACE_CRC_ERROR();
+	return false;
+}
+
+#if ONEWIRE_CRC16
+bool OneWire::read_bytes_crc16(uint8_t *buf, uint16_t count, uint16_t crc)
+{
+	if (read_bytes_crc(buf, count, crc, ONEWIRE_POLY_CRC16) == ONEWIRE_CRC16_RESIDUE) {
+		return true;
+	}
+	COUNT(crc_errors, 1);
+	TRACE_CRC_ERROR();
+	return false;
+}
+#endif
+#endif
+
+//
+// A whole exchange with one device.  The ROM command, tx bytes and rx
+// bytes go out as one stream of slots, without releasing the pin or
+// looking up the pin registers between bytes.  The CRC is updated as
+// the bits go by, so it is known as soon as the last slot is done.
+//
+uint8_t OneWire::transaction(uint8_t address, const uint8_t *rom,
+	const uint8_t *tx, uint16_t txcount, uint8_t *rx, uint16_t rxcount,
+	uint8_t check, bool power)
+{
+#if ONEWIRE_LOCK
+	OneWireLock hold(*this);
+#endif
+#if ONEWIRE_TELEMETRY
+	unsigned long start = micros();
+	uint8_t r = exchange(address, rom, tx, txcount, rx, rxcount, check, power);
+	unsigned long usec = micros() - start;
+	uint8_t bin = 0;
+
+	for (unsigned long ms = usec / 1000; ms && bin < ONEWIRE_TELEMETRY_BINS - 1; ms >>= 1) {
+		bin++;
+	}
+	telemetry.transaction_ms[bin]++;
+	if (usec > telemetry.transaction_max_usec) telemetry.transaction_max_usec = usec;
+	telemetry.transactions++;
+	if (r == ONEWIRE_CRC_ERROR) telemetry.crc_errors++;
+	return r;
+#else
+	return exchange(address, rom, tx, txcount, rx, rxcount, check, power);
+#endif
+}
+
+uint8_t CRIT_TIMING OneWire::exchange(uint8_t address, const uint8_t *rom,
+	const uint8_t *tx, uint16_t txcount, uint8_t *rx, uint16_t rxcount,
+	uint8_t check, bool power)
+{
+	uint8_t head[9];
+	uint8_t headcount = 0;
+	uint16_t poly = 0, txpoly, crc = 0, good = 0;
+
+#if ONEWIRE_CRC
+	if (check & ONEWIRE_CHECK_CRC8) {
+		if (rxcount < 1) return ONEWIRE_CRC_ERROR;
+		poly = ONEWIRE_POLY_CRC8;
+	}
+#if ONEWIRE_CRC16
+	if (check & ONEWIRE_CHECK_CRC16) {
+		if (rxcount < 2) return ONEWIRE_CRC_ERROR;
+		poly = ONEWIRE_POLY_CRC16;
+		good = ONEWIRE_CRC16_RESIDUE;
+	}
+#endif
+#endif
+	txpoly = (check & ONEWIRE_CHECK_TX) ? poly : 0;
+	if (address != ONEWIRE_ADDR_NONE) {
+		if (!reset()) return ONEWIRE_NO_PRESENCE;
+		if (address == ONEWIRE_ADDR_SKIP) {
+			head[headcount++] = 0xCC;       // Skip ROM
+		} else if (address == ONEWIRE_ADDR_RESUME) {
+			head[headcount++] = 0xA5;       // Resume ROM
+		} else if (address == ONEWIRE_ADDR_MATCH) {
+#if ONEWIRE_AUTO_SELECT
+			uint8_t cmd = select_command(rom);
+#else
+			uint8_t cmd = 0x55;             // Match ROM
+#endif
+			head[headcount++] = cmd;
+			if (cmd == 0x55) {
+				for (uint8_t i = 0; i < 8; i++) head[headcount++] = rom[i];
+			}
+		}
+#if ONEWIRE_AUTO_SELECT
+		if (address == ONEWIRE_ADDR_RESUME) select_flags &= ~SELECT_FRESH;
+		else if (address != ONEWIRE_ADDR_MATCH) addressed(NULL);
+#endif
+	}
+	// after the caller's own reset(), tx begins with a ROM command
+	ROM_COMMAND();
+	COUNT(bytes_written, headcount + txcount);
+	if (headcount) {
+		TRACE_BYTES(WRITE_BYTE, head, headcount);
+	}
+	TRACE_BYTES(WRITE_BYTE, tx, txcount);
+#if ONEWIRE_BACKEND
+	if (backend) {
+		if (headcount) backend->write_bytes(head, headcount, 1);
+		if (txcount) backend->write_bytes(tx, txcount, 1);
+		crc = crc_bytes(tx, txcount, 0, txpoly);
+	} else
+#endif
+	{
+		IO_REG_TYPE mask IO_REG_MASK_ATTR = bitmask;
+		__attribute__((unused)) volatile IO_REG_TYPE *reg IO_REG_BASE_ATTR = baseReg;
+		uint8_t bitMask, v;
+
+		for (uint16_t i = 0; i < headcount + txcount; i++) {
+			v = (i < headcount) ? head[i] : tx[i - headcount];
+			for (bitMask = 0x01; bitMask; bitMask <<= 1) {
+				slot_write(reg, mask, speed, timing, v & bitMask ONEWIRE_MUX_ARG(onewire_mux) SLOT_IRQ_ARG);
+				if (txpoly && i >= headcount) {
+					crc = crc_bit(crc, (v & bitMask) ? 1 : 0, txpoly);
+				}
+			}
+		}
+	}
+	crc = read_bytes_crc(rx, rxcount, crc, poly);
+	if (!power) {
+#if ONEWIRE_BACKEND
+		if (backend) {
+			backend->depower();
+		} else
+#endif
+		{
+			noInterrupts();
+			DIRECT_MODE_INPUT(baseReg, bitmask);
+			DIRECT_WRITE_LOW(baseReg, bitmask);
+			interrupts();
+		}
+	}
+	if (poly && crc != good) {
+		TRACE_CRC_ERROR();
+#if ONEWIRE_AUTO_SELECT
+		// maybe nobody answered a Resume, or another device a Skip ROM
+		forget_selected();
+#endif
+		return ONEWIRE_CRC_ERROR;
+	}
+	return ONEWIRE_OK;
+}
+
+#if ONEWIRE_BACKEND
+
+//
+// Default byte and search functions for backends which can only do
+// single bits.  The 'power' flags are passed on through depower().
+//
+void OneWireBackend::write(uint8_t v, uint8_t power)
+{
+    uint8_t bitMask;
+
+    for (bitMask = 0x01; bitMask; bitMask <<= 1) {
+	write_bit((bitMask & v)?1:0);
+    }
+    if (!power) depower();
+}
+
+uint8_t OneWireBackend::read()
+{
+    uint8_t bitMask;
+    uint8_t r = 0;
+
+    for (bitMask = 0x01; bitMask; bitMask <<= 1) {
+	if (read_bit()) r |= bitMask;
+    }
+    return r;
+}
+
+void OneWireBackend::write_bytes(const uint8_t *buf, uint16_t count, bool power)
+{
+  for (uint16_t i = 0 ; i < count ; i++)
+    write(buf[i], 1);
+  if (!power) depower();
+}
+
+void OneWireBackend::read_bytes(uint8_t *buf, uint16_t count)
+{
+  for (uint16_t i = 0 ; i < count ; i++)
+    buf[i] = read();
+}
+
+uint8_t OneWireBackend::triplet(uint8_t direction)
+{
+    uint8_t id_bit = read_bit();
+    uint8_t cmp_id_bit = read_bit();
+
+    if (id_bit != cmp_id_bit) direction = id_bit;
+    write_bit(direction);
+    return id_bit | (cmp_id_bit << 1) | (direction << 2);
+}
+
+#endif
+
 #if ONEWIRE_SEARCH
 
+void OneWireSearchCursor::reset(void)
+{
+   // reset the search state
+   last_discrepancy = 0;
+   last_device = false;
+   last_family_discrepancy = 0;
+   previous = 0;
+   previous_family = 0;
+   for (uint8_t i = 0; i < 8; i++) rom[i] = 0;
+}
+
+void OneWireSearchCursor::target(uint8_t family)
+{
+   // set the search state to find SearchFamily type devices
+   reset();
+   rom[0] = family;
+   last_discrepancy = 64;
+   previous = 64;
+}
+
+// The passes of the last search() only changed the ROM bits from the
+// discrepancy they began at, so beginning there again repeats them
+void OneWireSearchCursor::rollback(void)
+{
+   last_discrepancy = previous;
+   last_family_discrepancy = previous_family;
+   last_device = false;
+}
+
+#if ONEWIRE_SEARCH_STATE
 //
 // You need to use this function to start a search again from the beginning.
 // You do not need to do it for the first search, though you could.
 //
 void OneWire::reset_search()
 {
-  // reset the search state
-  LastDiscrepancy = 0;
-  LastDeviceFlag = false;
-  LastFamilyDiscrepancy = 0;
-  for(int i = 7; ; i--) {
-    ROM_NO[i] = 0;
-    if ( i == 0) break;
-  }
+   cursor.reset();
 }
 
 // Setup the search to find the device type 'family_code' on the next call
@@ -356,146 +967,437 @@ void OneWire::reset_search()
 //
 void OneWire::target_search(uint8_t family_code)
 {
-   // set the search state to find SearchFamily type devices
-   ROM_NO[0] = family_code;
-   for (uint8_t i = 1; i < 8; i++)
-      ROM_NO[i] = 0;
-   LastDiscrepancy = 64;
-   LastFamilyDiscrepancy = 0;
-   LastDeviceFlag = false;
+   cursor.target(family_code);
 }
+#endif
+
+// Families whose low 'count' bits match: every 2^count'th code from
+// the prefix
+bool OneWireFamilyFilter::any(uint8_t prefix, uint8_t count) const
+{
+   uint16_t step = 1 << count;
+
+   for (uint16_t f = prefix & (step - 1); f < 256; f += step) {
+      if (bits[f >> 3] & (1 << (f & 7))) return true;
+   }
+   return false;
+}
+
+// bit 'n' (1 to 64) of a ROM or discrepancy map
+#define ROM_BIT(buf, n)   ((buf)[((n) - 1) >> 3] & (1 << (((n) - 1) & 7)))
+
+// true if the family bits of rom[] before bit 'n' (1 to 8), then 'dir',
+// begin some family in the filter
+#define FAMILY_ALLOWED(filter, rom, n, dir) \
+   (filter)->any(((rom)[0] & ((1 << ((n) - 1)) - 1)) | ((dir) << ((n) - 1)), (n))
+
+// The highest position above 'from' and up to 'to' where devices
+// disagreed and the 0 branch was taken, or 0 if none.
+static uint8_t last_zero(const uint8_t *rom, const uint8_t *discrepancy,
+	uint8_t from, uint8_t to)
+{
+   for (uint8_t n = to; n > from; n--) {
+      if (ROM_BIT(discrepancy, n) && !ROM_BIT(rom, n)) return n;
+   }
+   return 0;
+}
+
+#if ONEWIRE_BACKEND
+#if ONEWIRE_TRACE
+// Trace an accelerated search pass as the triplets it stands for, so
+// the trace reads the same as one done a bit at a time
+void OneWire::trace_search(const uint8_t *direction, const uint8_t *bits,
+	const uint8_t *conflict)
+{
+   for (uint8_t n = 1; n <= 64; n++) {
+      bool got = ROM_BIT(bits, n), want = ROM_BIT(direction, n);
+      if (!ROM_BIT(conflict, n)) {
+         TRACE(READ_BIT, got);
+         TRACE(READ_BIT, !got);
+      } else if (got == want) {
+         TRACE(READ_BIT, 0);
+         TRACE(READ_BIT, 0);
+      } else {
+         // nobody answered, the search ends here
+         TRACE(READ_BIT, 1);
+         TRACE(READ_BIT, 1);
+         return;
+      }
+      TRACE(WRITE_BIT, got);
+   }
+}
+#endif
 
 //
-// Perform a search. If this function returns a '1' then it has
-// enumerated the next device and you may retrieve the ROM from the
-// OneWire::address variable. If there are no devices, no further
-// devices, or something horrible happens in the middle of the
-// enumeration then a 0 is returned.  If a new device is found then
-// its address is copied to newAddr.  Use OneWire::reset_search() to
-// start over.
+// The rest of a search pass on a backend with a search accelerator.  The
+// direction for every bit is known before the pass starts, so the whole
+// pass is one backend command; what the devices did is worked out from
+// the bits written and the discrepancies afterwards.  Returns false if
+// the backend has no accelerator, else sets 'found'.
 //
-// --- Replaced by the one from the Dallas Semiconductor web site ---
-//--------------------------------------------------------------------------
-// Perform the 1-Wire Search Algorithm on the 1-Wire bus using the existing
-// search state.
-// Return TRUE  : device found, ROM number in ROM_NO buffer
-//        FALSE : device not found, end of search
+bool OneWire::search_accelerated(uint8_t *rom, uint8_t last, uint8_t prefix,
+	uint8_t *discrepancy, bool &found)
+{
+   uint8_t direction[8], bits[8], conflict[8];
+
+   for (uint8_t i = 0; i < 8; i++) direction[i] = rom[i];
+   for (uint8_t n = (prefix > last - 1 ? prefix : last - 1) + 1; n <= 64; n++) {
+      // 1 at the last discrepancy, then the 0 branch
+      if (n == last) direction[(n - 1) >> 3] |= 1 << ((n - 1) & 7);
+      else direction[(n - 1) >> 3] &= ~(1 << ((n - 1) & 7));
+   }
+   if (!backend->search_bits(direction, bits, conflict)) return false;
+#if ONEWIRE_TRACE
+   trace_search(direction, bits, conflict);
+#endif
+
+   found = false;
+   for (uint8_t n = 1; n <= 64; n++) {
+      bool want = ROM_BIT(direction, n), got = ROM_BIT(bits, n);
+      if (ROM_BIT(conflict, n)) {
+         // both bits 1 (nobody answered) shows as the 1 branch taken
+         // at a discrepancy, so is only seen here when 0 was wanted
+         if (got != want) return true;
+         discrepancy[(n - 1) >> 3] |= 1 << ((n - 1) & 7);
+      } else if (n <= prefix && got != want) {
+         // nothing on the required branch
+         discrepancy[(n - 1) >> 3] |= 1 << ((n - 1) & 7);
+         return true;
+      }
+   }
+   for (uint8_t i = 0; i < 8; i++) rom[i] = bits[i];
+   found = true;
+   return true;
+}
+#endif
+
 //
-bool OneWire::search(uint8_t *newAddr, bool search_mode /* = true */)
+// One pass of the search algorithm, down the branch described by rom[]
+// and 'last': bits before 'last' follow rom[], at 'last' take the 1
+// branch, and after it take the 0 branch at every discrepancy.  The
+// first 'prefix' bits must match rom[], no other branch is taken there.
+// The ROM found is left in rom[], and each position where the devices
+// disagreed, or where the prefix was not found, is set in discrepancy[].
+//
+// With a filter, the family bits only follow branches which lead to a
+// family in it, and a discrepancy is only recorded where both branches
+// do.  If the devices only offer a branch outside the filter the pass
+// stops there, returning false with 'pruned' set.
+//
+bool OneWire::search_pass(uint8_t *rom, uint8_t last, uint8_t prefix,
+	bool search_mode, uint8_t *discrepancy,
+	const OneWireFamilyFilter *filter, bool *pruned)
 {
    uint8_t id_bit_number;
-   uint8_t last_zero, rom_byte_number;
-   bool    search_result;
-   uint8_t id_bit, cmp_id_bit;
+   uint8_t rom_byte_number;
+   uint8_t id_bit, cmp_id_bit, triplet_bits;
 
    unsigned char rom_byte_mask, search_direction;
 
+   for (rom_byte_number = 0; rom_byte_number < 8; rom_byte_number++) {
+      discrepancy[rom_byte_number] = 0;
+   }
+
+   // 1-Wire reset
+   if (!reset()) return false;
+
+   // issue the search command
+   if (search_mode == true) {
+     write(0xF0);   // NORMAL SEARCH
+   } else {
+     write(0xEC);   // CONDITIONAL SEARCH
+   }
+
+#if ONEWIRE_BACKEND
+   // an accelerated pass can't change direction part way, so filtered
+   // searches go a bit at a time
+   bool found;
+   if (backend && !filter && search_accelerated(rom, last, prefix, discrepancy, found)) {
+      return found;
+   }
+#endif
+
    // initialize for search
    id_bit_number = 1;
-   last_zero = 0;
    rom_byte_number = 0;
    rom_byte_mask = 1;
-   search_result = false;
-
-   // if the last call was not the last one
-   if (!LastDeviceFlag) {
-      // 1-Wire reset
-      if (!reset()) {
-         // reset the search
-         LastDiscrepancy = 0;
-         LastDeviceFlag = false;
-         LastFamilyDiscrepancy = 0;
-         return false;
-      }
 
-      // issue the search command
-      if (search_mode == true) {
-        write(0xF0);   // NORMAL SEARCH
+   // loop to do the search
+   do
+   {
+      // the direction to take if the devices disagree on this bit:
+      // if this discrepancy if before the Last Discrepancy
+      // on a previous next then pick the same as last time
+      if (id_bit_number <= prefix || id_bit_number < last) {
+         search_direction = ((rom[rom_byte_number] & rom_byte_mask) > 0);
       } else {
-        write(0xEC);   // CONDITIONAL SEARCH
+         // if equal to last pick 1, if not then pick 0
+         search_direction = (id_bit_number == last);
+      }
+      if (filter && id_bit_number <= 8 &&
+          !FAMILY_ALLOWED(filter, rom, id_bit_number, search_direction)) {
+         search_direction = !search_direction;
       }
 
-      // loop to do the search
-      do
-      {
-         // read a bit and its complement
-         id_bit = read_bit();
-         cmp_id_bit = read_bit();
-
-         // check for no devices on 1-wire
-         if ((id_bit == 1) && (cmp_id_bit == 1)) {
-            break;
-         } else {
-            // all devices coupled have 0 or 1
-            if (id_bit != cmp_id_bit) {
-               search_direction = id_bit;  // bit write value for search
-            } else {
-               // if this discrepancy if before the Last Discrepancy
-               // on a previous next then pick the same as last time
-               if (id_bit_number < LastDiscrepancy) {
-                  search_direction = ((ROM_NO[rom_byte_number] & rom_byte_mask) > 0);
-               } else {
-                  // if equal to last pick 1, if not then pick 0
-                  search_direction = (id_bit_number == LastDiscrepancy);
-               }
-               // if 0 was picked then record its position in LastZero
-               if (search_direction == 0) {
-                  last_zero = id_bit_number;
-
-                  // check for Last discrepancy in family
-                  if (last_zero < 9)
-                     LastFamilyDiscrepancy = last_zero;
-               }
-            }
-
-            // set or clear the bit in the ROM byte rom_byte_number
-            // with mask rom_byte_mask
-            if (search_direction == 1)
-              ROM_NO[rom_byte_number] |= rom_byte_mask;
-            else
-              ROM_NO[rom_byte_number] &= ~rom_byte_mask;
-
-            // serial number search direction write bit
-            write_bit(search_direction);
-
-            // increment the byte counter id_bit_number
-            // and shift the mask rom_byte_mask
-            id_bit_number++;
-            rom_byte_mask <<= 1;
-
-            // if the mask is 0 then go to new SerialNum byte rom_byte_number and reset mask
-            if (rom_byte_mask == 0) {
-                rom_byte_number++;
-                rom_byte_mask = 1;
-            }
+      // read a bit and its complement, and write the direction
+      // (bridge chips do all three as one command)
+      triplet_bits = triplet(search_direction);
+      id_bit = triplet_bits & 1;
+      cmp_id_bit = (triplet_bits >> 1) & 1;
+
+      // check for no devices on 1-wire
+      if ((id_bit == 1) && (cmp_id_bit == 1)) return false;
+
+      if (id_bit != cmp_id_bit) {
+         // all devices coupled have 0 or 1
+         if (id_bit_number <= prefix && id_bit != search_direction) {
+            // nothing on the required branch
+            discrepancy[rom_byte_number] |= rom_byte_mask;
+            return false;
          }
+         search_direction = id_bit;  // bit write value for search
+         if (filter && id_bit_number <= 8 &&
+             !FAMILY_ALLOWED(filter, rom, id_bit_number, id_bit)) {
+            // only devices the filter excludes down this branch
+            *pruned = true;
+            return false;
+         }
+      } else if (!filter || id_bit_number > 8 ||
+                 FAMILY_ALLOWED(filter, rom, id_bit_number, !search_direction)) {
+         discrepancy[rom_byte_number] |= rom_byte_mask;
+      }
+
+      // set or clear the bit in the ROM byte rom_byte_number
+      // with mask rom_byte_mask
+      if (search_direction == 1)
+        rom[rom_byte_number] |= rom_byte_mask;
+      else
+        rom[rom_byte_number] &= ~rom_byte_mask;
+
+      // increment the byte counter id_bit_number
+      // and shift the mask rom_byte_mask
+      id_bit_number++;
+      rom_byte_mask <<= 1;
+
+      // if the mask is 0 then go to new SerialNum byte rom_byte_number and reset mask
+      if (rom_byte_mask == 0) {
+          rom_byte_number++;
+          rom_byte_mask = 1;
       }
-      while(rom_byte_number < 8);  // loop until through all ROM bytes 0-7
+   }
+   while(rom_byte_number < 8);  // loop until through all ROM bytes 0-7
+
+   return true;
+}
+
+//
+// Perform a search. If this function returns a '1' then it has
+// enumerated the next device and you may retrieve the ROM from the
+// OneWire::address variable. If there are no devices, no further
+// devices, or something horrible happens in the middle of the
+// enumeration then a 0 is returned.  If a new device is found then
+// its address is copied to newAddr.  Use OneWire::reset_search() to
+// start over.
+//
+// --- Replaced by the one from the Dallas Semiconductor web site ---
+//--------------------------------------------------------------------------
+// Perform the 1-Wire Search Algorithm on the 1-Wire bus using the existing
+// search state.
+// Return TRUE  : device found, ROM number in the cursor's rom[]
+//        FALSE : device not found, end of search
+//
+bool OneWire::search_next(OneWireSearchCursor &c, uint8_t *newAddr,
+	bool search_mode, const OneWireFamilyFilter *filter)
+{
+   uint8_t discrepancy[8];
+   uint8_t family_zero;
+   uint8_t retries = 0;
+   bool    search_result = false;
+   bool    found = false, pruned = false;
+#if ONEWIRE_LOCK
+   OneWireLock hold(*this);
+#endif
 
-      // if the search was successful then
-      if (!(id_bit_number < 65)) {
+   COUNT(searches, 1);
+   c.previous = c.last_discrepancy;
+   c.previous_family = c.last_family_discrepancy;
+   // if the last call was not the last one, and there is anything to find
+   if (!c.last_device && (!filter || filter->any(0, 0))) {
+      for (;;) {
+         pruned = false;
+         found = search_pass(c.rom, c.last_discrepancy, 0, search_mode,
+                             discrepancy, filter, &pruned);
+         if (pruned) {
+            // back to the last branch point where the 0 branch was taken
+            c.last_discrepancy = last_zero(c.rom, discrepancy, 0, 64);
+            if (c.last_discrepancy == 0) break;
+            continue;
+         }
+         // a bit misread: the same branch again, last_discrepancy is
+         // only moved on by a pass which found a good ROM
+#if ONEWIRE_CRC
+         bool bad = found ? crc8(c.rom, 7) != c.rom[7] : c.last_discrepancy != 0;
+#else
+         bool bad = !found && c.last_discrepancy != 0;
+#endif
+         if (!bad || retries++ == ONEWIRE_SEARCH_RETRIES) break;
+      }
+      if (found) {
          // search successful so set LastDiscrepancy,LastDeviceFlag,search_result
-         LastDiscrepancy = last_zero;
+         c.last_discrepancy = last_zero(c.rom, discrepancy, 0, 64);
+         family_zero = last_zero(c.rom, discrepancy, 0, 8);
+         if (family_zero)
+            c.last_family_discrepancy = family_zero;
 
          // check for last device
-         if (LastDiscrepancy == 0) {
-            LastDeviceFlag = true;
+         if (c.last_discrepancy == 0) {
+            c.last_device = true;
          }
          search_result = true;
+#if ONEWIRE_AUTO_SELECT
+         // the pass left this device addressed, and if it was the first
+         // pass of a whole search, nothing else disagreed with it
+         bool whole = c.previous == 0 && search_mode && !filter;
+         if (whole || !same_rom(c.rom, selected)) select_flags &= ~SELECT_SINGLE;
+         addressed(c.rom);
+         if (whole && c.last_discrepancy == 0) select_flags |= SELECT_SINGLE;
+#endif
+      } else if (c.last_discrepancy && !pruned) {
+         // lost part way through the devices, the next search starts over
+         COUNT(search_restarts, 1);
       }
    }
 
    // if no device found then reset counters so next 'search' will be like a first
-   if (!search_result || !ROM_NO[0]) {
-      LastDiscrepancy = 0;
-      LastDeviceFlag = false;
-      LastFamilyDiscrepancy = 0;
+   if (!search_result || !c.rom[0]) {
+      c.last_discrepancy = 0;
+      c.last_device = false;
+      c.last_family_discrepancy = 0;
       search_result = false;
    } else {
-      for (int i = 0; i < 8; i++) newAddr[i] = ROM_NO[i];
+      for (int i = 0; i < 8; i++) newAddr[i] = c.rom[i];
    }
    return search_result;
-  }
+}
+
+#if ONEWIRE_SEARCH_STATE
+bool OneWire::search(uint8_t *newAddr, bool search_mode /* = true */)
+{
+   return search_next(cursor, newAddr, search_mode, NULL);
+}
+
+//
+// A search for some families.  A pass which was pruned has found no
+// device, but the branches it passed over may still hold some, so the
+// search goes back to the last one and tries again.
+//
+bool OneWire::search(uint8_t *newAddr, const OneWireFamilyFilter &filter,
+	bool search_mode /* = true */)
+{
+   return search_next(cursor, newAddr, search_mode, &filter);
+}
+#endif
+
+bool OneWire::search(OneWireSearchCursor &c, uint8_t *newAddr,
+	bool search_mode /* = true */)
+{
+   return search_next(c, newAddr, search_mode, NULL);
+}
+
+bool OneWire::search(OneWireSearchCursor &c, uint8_t *newAddr,
+	const OneWireFamilyFilter &filter, bool search_mode /* = true */)
+{
+   return search_next(c, newAddr, search_mode, &filter);
+}
+
+//
+// Verify a ROM: a search pass with every bit forced to the ROM's value
+//
+bool OneWire::verify(const uint8_t rom[8])
+{
+   uint8_t addr[8], discrepancy[8];
+#if ONEWIRE_LOCK
+   OneWireLock hold(*this);
+#endif
+
+   for (uint8_t i = 0; i < 8; i++) addr[i] = rom[i];
+   return search_pass(addr, 0, 64, true, discrepancy, NULL, NULL);
+}
+
+// true if any of the 'count' ROMs begins with the first 'bits' of rom[]
+static bool rom_prefix_known(uint8_t roms[][8], uint8_t count,
+	const uint8_t *rom, uint8_t bits)
+{
+   for (uint8_t i = 0; i < count; i++) {
+      uint8_t n;
+      for (n = 1; n <= bits; n++) {
+         if (!ROM_BIT(roms[i], n) != !ROM_BIT(rom, n)) break;
+      }
+      if (n > bits) return true;
+   }
+   return false;
+}
+
+//
+// Enumerate every device whose ROM begins with the first 'prefix' bits
+// of rom[], adding them to the table.
+//
+uint8_t OneWire::search_branch(uint8_t roms[][8], uint8_t count,
+	uint8_t max_count, bool *present, uint8_t *rom, uint8_t prefix)
+{
+   uint8_t discrepancy[8];
+   uint8_t last = 0;
+
+   while (count < max_count) {
+      if (!search_pass(rom, last, prefix, true, discrepancy, NULL, NULL)) break;
+#if ONEWIRE_CRC
+      if (crc8(rom, 7) == rom[7])
+#endif
+      {
+         for (uint8_t i = 0; i < 8; i++) roms[count][i] = rom[i];
+         present[count++] = true;
+      }
+      last = last_zero(rom, discrepancy, prefix, 64);
+      if (last == 0) break;
+   }
+   return count;
+}
+
+//
+// Re-check a table of known ROMs.  Every device not in the table shares
+// its longest known prefix with some entry, so the verify pass of that
+// entry meets it as a discrepancy (or as the point where the pass
+// fails).  Only branches beginning at such a point which no entry
+// covers need to be searched.
+//
+uint8_t OneWire::reverify(uint8_t roms[][8], uint8_t count, uint8_t max_count, bool *present)
+{
+   uint8_t rom[8], discrepancy[8];
+   uint8_t known = count;
+#if ONEWIRE_LOCK
+   OneWireLock hold(*this);
+#endif
+
+   if (count == 0) return search_branch(roms, 0, max_count, present, rom, 0);
+
+   for (uint8_t i = 0; i < known; i++) {
+      for (uint8_t j = 0; j < 8; j++) rom[j] = roms[i][j];
+      present[i] = search_pass(rom, 0, 64, true, discrepancy, NULL, NULL);
+
+      for (uint8_t n = 1; n <= 64; n++) {
+         if (!ROM_BIT(discrepancy, n)) continue;
+         // the branch on the other side of this discrepancy
+         for (uint8_t j = 0; j < 8; j++) rom[j] = roms[i][j];
+         rom[(n - 1) >> 3] ^= 1 << ((n - 1) & 7);
+         if (rom_prefix_known(roms, count, rom, n)) continue;
+         count = search_branch(roms, count, max_count, present, rom, n);
+      }
+   }
+   return count;
+}
+
+#undef ROM_BIT
+#undef FAMILY_ALLOWED
 
 #endif
 
@@ -517,10 +1419,8 @@ static const uint8_t PROGMEM dscrc2x16_table[] = {
 
 // Compute a Dallas Semiconductor 8 bit CRC. These show up in the ROM
 // and the registers.  (Use tiny 2x16 entry CRC table)
-uint8_t OneWire::crc8(const uint8_t *addr, uint8_t len)
+uint8_t OneWire::crc8(const uint8_t *addr, uint8_t len, uint8_t crc)
 {
-	uint8_t crc = 0;
-
 	while (len--) {
 		crc = *addr++ ^ crc;  // just re-using crc as intermediate
 		crc = pgm_read_byte(dscrc2x16_table + (crc & 0x0f)) ^
@@ -534,10 +1434,8 @@ uint8_t OneWire::crc8(const uint8_t *addr, uint8_t len)
 // Compute a Dallas Semiconductor 8 bit CRC directly.
 // this is much slower, but a little smaller, than the lookup table.
 //
-uint8_t OneWire::crc8(const uint8_t *addr, uint8_t len)
+uint8_t OneWire::crc8(const uint8_t *addr, uint8_t len, uint8_t crc)
 {
-	uint8_t crc = 0;
-
 	while (len--) {
 #if defined(__AVR__)
 		crc = _crc_ibutton_update(crc, *addr++);
@@ -595,9 +1493,15 @@ uint16_t OneWire::crc16(const uint8_t* input, uint16_t len, uint16_t crc)
 #endif
 
 // undef defines for no particular reason
+#undef ROM_COMMAND
+#if ONEWIRE_AUTO_SELECT
+#  undef SELECT_AUTO
+#  undef SELECT_RESUME
+#  undef SELECT_SINGLE
+#  undef SELECT_FRESH
+#endif
 #ifdef ARDUINO_ARCH_ESP32
-#  undef noInterrupts() {portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;portENTER_CRITICAL(&mux)
-#  undef interrupts() portEXIT_CRITICAL(&mux);}
+#  undef onewire_mux
 #endif
 // for info on this, search "IRAM_ATTR" at https://docs.espressif.com/projects/esp-idf/en/latest/esp32/api-guides/general-notes.html 
 #undef CRIT_TIMING 
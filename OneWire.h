@@ -9,7 +9,19 @@
 #include <util/crc16.h>
 #endif
 
-#if ARDUINO >= 100
+// Building on a Linux host without an Arduino core (simulated bus,
+// bridge chips, offline tools).  There are no pins to bit-bang, so all
+// bus access must go through a OneWireBackend.
+#if !defined(ARDUINO) && defined(__linux__) && !defined(ONEWIRE_HOST)
+#define ONEWIRE_HOST 1
+#endif
+#ifndef ONEWIRE_HOST
+#define ONEWIRE_HOST 0
+#endif
+
+#if ONEWIRE_HOST
+#include "util/OneWire_host.h"  // for delayMicroseconds, micros, etc
+#elif ARDUINO >= 100
 #include <Arduino.h>       // for delayMicroseconds, digitalPinToBitMask, etc
 #else
 #include "WProgram.h"      // for delayMicroseconds
@@ -31,6 +43,20 @@
 #define ONEWIRE_SEARCH 1
 #endif
 
+// You can leave out the search state kept in each instance for
+// reset_search(), target_search() and search(addr) by defining this
+// to 0.  It saves 13 bytes of RAM per instance; searches are then done
+// with a OneWireSearchCursor.
+#ifndef ONEWIRE_SEARCH_STATE
+#define ONEWIRE_SEARCH_STATE 1
+#endif
+
+// How many times search() repeats a pass which found a ROM with a bad
+// CRC, or lost the devices part way, before giving up on it
+#ifndef ONEWIRE_SEARCH_RETRIES
+#define ONEWIRE_SEARCH_RETRIES 2
+#endif
+
 // You can exclude CRC checks altogether by defining this to 0
 #ifndef ONEWIRE_CRC
 #define ONEWIRE_CRC 1
@@ -51,27 +77,373 @@
 #define ONEWIRE_CRC16 1
 #endif
 
+// You can let a OneWire instance use some other bus master instead of
+// its own pin (simulated bus, bridge chip, etc) by defining this to 1.
+// It costs one pointer of RAM per instance and a pointer test at the
+// start of each bit, outside the timing critical sections, so it is off
+// by default on AVR.  OneWireDS2482 and OneWireReplay need it, and
+// OneWireFixed needs it to be used through a OneWire.
+#ifndef ONEWIRE_BACKEND
+#ifdef __AVR__
+#define ONEWIRE_BACKEND 0
+#else
+#define ONEWIRE_BACKEND 1
+#endif
+#endif
+
+// You can keep statistics of the bus traffic in each OneWire instance
+// (see OneWireTelemetry below) by defining this to 1.  It costs about
+// 100 bytes of RAM per instance, and a micros() call around each
+// interrupts-disabled section of the slots.
+#ifndef ONEWIRE_TELEMETRY
+#define ONEWIRE_TELEMETRY 0
+#endif
+
+// You can record the last resets, bits and bytes of each OneWire
+// instance (see OneWireTrace.h) by defining this to 1.  It costs
+// ONEWIRE_TRACE_SIZE entries of 6 to 8 bytes of RAM per instance, and a
+// micros() call for each entry.
+#ifndef ONEWIRE_TRACE
+#define ONEWIRE_TRACE 0
+#endif
+
+// You can let tasks share a bus (see lock() and OneWireLock below) by
+// defining this to 1.  It needs FreeRTOS, so is only available on ESP32,
+// where it is on by default.  It costs a mutex per instance.  Without
+// it lock() and OneWireLock do nothing, so code using them still builds.
+#ifndef ONEWIRE_LOCK
+#ifdef ARDUINO_ARCH_ESP32
+#define ONEWIRE_LOCK 1
+#else
+#define ONEWIRE_LOCK 0
+#endif
+#endif
+
+// You can let select() and transaction() address a device with Resume
+// ROM or Skip ROM instead of Match ROM where that is safe (see
+// set_auto_select() below) by defining this to 1.  It costs 9 bytes of
+// RAM per instance, and a flag test in reset() and the writes, so it is
+// off by default on AVR.  Without it set_auto_select() does nothing, so
+// code using it still builds.
+#ifndef ONEWIRE_AUTO_SELECT
+#ifdef __AVR__
+#define ONEWIRE_AUTO_SELECT 0
+#else
+#define ONEWIRE_AUTO_SELECT 1
+#endif
+#endif
+
+#if ONEWIRE_HOST && !ONEWIRE_BACKEND
+#error "ONEWIRE_HOST requires ONEWIRE_BACKEND"
+#endif
+#if ONEWIRE_LOCK && !defined(ARDUINO_ARCH_ESP32)
+#error "ONEWIRE_LOCK is only supported on ESP32"
+#endif
+
+// lock() timeout which never ends
+#define ONEWIRE_LOCK_FOREVER 0xFFFFFFFFUL
+
+// Bus speeds, for set_speed()
+#define ONEWIRE_STANDARD   0
+#define ONEWIRE_OVERDRIVE  1
+
+// Addressing for transaction()
+#define ONEWIRE_ADDR_NONE   0   // no reset, continue the last transaction
+#define ONEWIRE_ADDR_RESET  1   // reset only, the tx bytes begin with a ROM command
+#define ONEWIRE_ADDR_SKIP   2   // reset and Skip ROM
+#define ONEWIRE_ADDR_MATCH  3   // reset and Match ROM
+#define ONEWIRE_ADDR_RESUME 4   // reset and Resume ROM, the device last matched
+
+// CRC checks for transaction(), CRC8 or CRC16 may be combined with TX
+#define ONEWIRE_CHECK_NONE  0
+#define ONEWIRE_CHECK_CRC8  1   // the last rx byte is a CRC8
+#define ONEWIRE_CHECK_CRC16 2   // the last 2 rx bytes are an inverted CRC16
+#define ONEWIRE_CHECK_TX    4   // the CRC covers the tx bytes, then the rx bytes
+
+// transaction() results
+#define ONEWIRE_OK          0
+#define ONEWIRE_NO_PRESENCE 1
+#define ONEWIRE_CRC_ERROR   2
+
 // Board-specific macros for direct GPIO
 #include "util/OneWire_direct_regtype.h"
 
+#if ONEWIRE_TRACE
+#include "OneWireTrace.h"
+#endif
+
+#if ONEWIRE_LOCK
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#endif
+
+#if ONEWIRE_TELEMETRY
+#define ONEWIRE_TELEMETRY_BINS 8
+
+// Counters kept by a OneWire instance.  Bits are single bit operations
+// (write_bit(), read_bit() and search steps), bytes are byte operations
+// and the bytes of transaction(), so the slots of a byte are not counted
+// as bits as well.  The interrupt times are only measured on the direct
+// GPIO pin; OneWireAsync slots are not counted.
+struct OneWireTelemetry
+{
+    uint32_t resets;
+    uint32_t no_presence;       // resets without a presence pulse
+    uint32_t bits_written;
+    uint32_t bits_read;
+    uint32_t bytes_written;
+    uint32_t bytes_read;
+    uint32_t crc_errors;        // transaction() and read_bytes_crc8/16()
+    uint32_t searches;          // search() calls
+    uint32_t search_restarts;   // searches which lost their place in the devices
+    uint32_t transactions;
+
+    // transaction() durations: bin 0 counts those under 1ms, bin i those
+    // under 2^i ms, and the last bin all the longer ones
+    uint32_t transaction_ms[ONEWIRE_TELEMETRY_BINS];
+    uint32_t transaction_max_usec;
+
+    // total and longest time with interrupts disabled
+    uint32_t irq_usec;
+    uint16_t irq_max_usec;
+    unsigned long irq_start;    // micros() when the current one began
+
+    void clear(void);
+};
+#endif
+
+// Slot timing at standard speed, in microseconds, for set_timing().
+// Each slot drives the bus low for the _low time, and a reset or read
+// slot samples the bus _sample after releasing it, then waits the _high
+// time before the next one.  The presets are:
+//
+//    standard      the timings OneWire has always used
+//    minimum       the datasheet minimum slot lengths, for short lightly
+//                  loaded buses
+//    conservative  longer resets and recovery times, for long runs where
+//                  the pullup needs more time to raise the bus
+//
+// With fast_reset, reset() doesn't wait the whole reset_high time after
+// a presence pulse.  It waits until the devices release the bus, then
+// reset_recovery.  That is shorter than the 480us high time the
+// datasheets give for the master, but devices are ready for the next
+// slot once their presence pulse has ended.
+//
+// Overdrive timing is fixed, it is already at the datasheet limits.
+struct OneWireTiming
+{
+    uint16_t reset_low;
+    uint16_t reset_sample;
+    uint16_t reset_high;
+    uint8_t reset_recovery;     // after the presence pulse, with fast_reset
+    uint8_t write1_low;
+    uint8_t write1_high;
+    uint8_t write0_low;
+    uint8_t write0_high;
+    uint8_t read_low;
+    uint8_t read_sample;
+    uint8_t read_high;
+    bool fast_reset;
+
+    static const OneWireTiming standard;
+    static const OneWireTiming minimum;
+    static const OneWireTiming conservative;
+};
+
+#if ONEWIRE_SEARCH
+// A set of family codes (the first ROM byte), for a search which only
+// finds those devices:
+//
+//    OneWireFamilyFilter want;        // or want(true) for all of them
+//    want.include(0x28);              // DS18B20
+//    want.include(0x29);              // DS2408
+//    ds.reset_search();
+//    while (ds.search(addr, want)) ...
+//
+// The search never enters a branch of the search tree which holds none
+// of the families, so the other devices on the bus cost nothing but the
+// branch points they share with the ones wanted.
+struct OneWireFamilyFilter
+{
+    uint8_t bits[32];
+
+    OneWireFamilyFilter(bool all = false) { set_all(all); }
+    void set_all(bool all) {
+        for (uint8_t i = 0; i < 32; i++) bits[i] = all ? 0xFF : 0;
+    }
+    void include(uint8_t family) { bits[family >> 3] |= 1 << (family & 7); }
+    void exclude(uint8_t family) { bits[family >> 3] &= ~(1 << (family & 7)); }
+    bool contains(uint8_t family) const { return bits[family >> 3] & (1 << (family & 7)); }
+
+    // true if any family in the set begins with the low 'count' bits of
+    // 'prefix' (the bits a search sees first)
+    bool any(uint8_t prefix, uint8_t count) const;
+};
+
+// The place a search has reached.  Each cursor is a search of its own,
+// so a search for some families can run between the steps of a full
+// search without disturbing it, and a cursor can be copied to come back
+// to a place later:
+//
+//    OneWireSearchCursor all;
+//    while (ds.search(all, addr)) {
+//        OneWireSearchCursor saved = all;
+//        ...
+//    }
+//
+// rollback() undoes the last search(), so the next one takes the same
+// branch again: if reading a device found shows its ROM was wrong, that
+// one branch is repeated rather than the whole search.
+struct OneWireSearchCursor
+{
+    uint8_t rom[8];                   // the last ROM found
+    uint8_t last_discrepancy;
+    uint8_t last_family_discrepancy;
+    bool last_device;
+    uint8_t previous;                 // the discrepancies before the last
+    uint8_t previous_family;          // search(), for rollback()
+
+    OneWireSearchCursor() { reset(); }
+    void reset(void);
+    // Begin at the devices of 'family', the search goes on to the
+    // families after it when they have all been found
+    void target(uint8_t family);
+    void rollback(void);
+    bool done(void) const { return last_device; }
+};
+#endif
+
+#if ONEWIRE_BACKEND
+// A bus master other than the direct GPIO pin.  Only reset(), write_bit()
+// and read_bit() are required.  The byte and search functions default to
+// bit-by-bit loops, but bridge chips which can do more per command
+// should override them.
+class OneWireBackend
+{
+  public:
+    virtual uint8_t reset(void) = 0;
+    virtual void write_bit(uint8_t v) = 0;
+    virtual uint8_t read_bit(void) = 0;
+
+    virtual void write(uint8_t v, uint8_t power);
+    virtual uint8_t read(void);
+    virtual void write_bytes(const uint8_t *buf, uint16_t count, bool power);
+    virtual void read_bytes(uint8_t *buf, uint16_t count);
+    virtual uint8_t triplet(uint8_t direction);
+    virtual void depower(void) { }
+
+    // Do all 64 steps of a search pass (after the reset and search
+    // command) as one operation, for bridges with a search accelerator.
+    // Where the devices disagree on a bit, write that bit of direction[]
+    // and set it in discrepancy[].  rom[] gets the bits written.  Returns
+    // false, without touching the bus, if there is no such command.
+    virtual bool search_bits(const uint8_t *direction, uint8_t *rom,
+                             uint8_t *discrepancy) {
+        (void)direction; (void)rom; (void)discrepancy;
+        return false;
+    }
+
+    // Change the slot timing, returns false if 'speed' is not supported
+    virtual bool set_speed(uint8_t speed) { return speed == ONEWIRE_STANDARD; }
+
+    // Change the standard speed slot lengths, returns false if the bus
+    // master can't (bridge chips time the slots themselves)
+    virtual bool set_timing(const OneWireTiming *timing) {
+        return timing == &OneWireTiming::standard;
+    }
+};
+#endif
+
 class OneWire
 {
   private:
+    friend class OneWireAsync;
+
     IO_REG_TYPE bitmask;
     volatile IO_REG_TYPE *baseReg;
+    uint8_t speed;
+    const OneWireTiming *timing;
+#if ONEWIRE_BACKEND
+    OneWireBackend *backend;
+#endif
+#ifdef ARDUINO_ARCH_ESP32
+    // the spinlock of the slots' critical sections, so this bus can't be
+    // used from the other core in the middle of a slot
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+#if ONEWIRE_LOCK
+    SemaphoreHandle_t bus_lock = NULL;
+#endif
+
+#if ONEWIRE_TRACE && ONEWIRE_SEARCH && ONEWIRE_BACKEND
+    void trace_search(const uint8_t *direction, const uint8_t *bits,
+                      const uint8_t *conflict);
+#endif
+    uint8_t exchange(uint8_t address, const uint8_t *rom,
+                     const uint8_t *tx, uint16_t txcount,
+                     uint8_t *rx, uint16_t rxcount, uint8_t check, bool power);
+    uint16_t read_bytes_crc(uint8_t *buf, uint16_t count, uint16_t crc, uint16_t poly);
+
+#if ONEWIRE_AUTO_SELECT
+    // the device the last Match ROM or search left addressed, and what
+    // is known about it (the SELECT_ flags in OneWire.cpp)
+    uint8_t selected[8];
+    uint8_t select_flags;
+    void addressed(const uint8_t *rom);
+    uint8_t select_command(const uint8_t *rom);
+#endif
 
 #if ONEWIRE_SEARCH
-    // global search state
-    unsigned char ROM_NO[8];
-    uint8_t LastDiscrepancy;
-    uint8_t LastFamilyDiscrepancy;
-    bool LastDeviceFlag;
+#if ONEWIRE_SEARCH_STATE
+    // the search state of reset_search() and search(addr)
+    OneWireSearchCursor cursor;
+#endif
+
+    bool search_pass(uint8_t *rom, uint8_t last, uint8_t prefix,
+                     bool search_mode, uint8_t *discrepancy,
+                     const OneWireFamilyFilter *filter, bool *pruned);
+    bool search_next(OneWireSearchCursor &c, uint8_t *newAddr, bool search_mode,
+                     const OneWireFamilyFilter *filter);
+#if ONEWIRE_BACKEND
+    bool search_accelerated(uint8_t *rom, uint8_t last, uint8_t prefix,
+                            uint8_t *discrepancy, bool &found);
+#endif
+    uint8_t search_branch(uint8_t roms[][8], uint8_t count, uint8_t max_count,
+                          bool *present, uint8_t *rom, uint8_t prefix);
 #endif
 
   public:
+#if ONEWIRE_TELEMETRY
+    // Statistics of this bus, telemetry.clear() starts them again
+    OneWireTelemetry telemetry;
+#endif
+#if ONEWIRE_TRACE
+    // The last bus primitives, see OneWireTrace.h
+    OneWireTrace trace;
+#endif
+
     OneWire() { }
     OneWire(uint8_t pin) { begin(pin); }
     void begin(uint8_t pin);
+#if ONEWIRE_BACKEND
+    // Use another bus master instead of a pin.  The backend must remain
+    // valid for as long as this OneWire uses it.
+    OneWire(OneWireBackend &bus) { begin(bus); }
+    void begin(OneWireBackend &bus);
+#endif
+
+    // Hold the bus for a sequence of operations (a reset, select and
+    // read, a conversion and its wait), so other tasks using it wait
+    // until unlock().  Returns false if 'timeout' ms pass first.  Locks
+    // nest in one task.  transaction() and the searches lock the bus
+    // themselves.  OneWireLock below does this for a block of code.
+#if ONEWIRE_LOCK
+    bool lock(uint32_t timeout = ONEWIRE_LOCK_FOREVER);
+    void unlock(void);
+#else
+    bool lock(uint32_t timeout = ONEWIRE_LOCK_FOREVER) { (void)timeout; return true; }
+    void unlock(void) { }
+#endif
 
     // Perform a 1-Wire reset cycle. Returns 1 if a device responds
     // with a presence pulse.  Returns 0 if there is no device or the
@@ -84,6 +456,55 @@ class OneWire
     // Issue a 1-Wire rom skip command, to address all on bus.
     void skip(void);
 
+#if ONEWIRE_AUTO_SELECT
+    // Let select() and transaction() address a device in 8 slots rather
+    // than 72 where they can: with Skip ROM when a search found it alone
+    // on the bus, or with Resume ROM (0xA5) when it is the device last
+    // addressed and its family has Resume (DS2408, DS2413, DS2431,
+    // DS28EA00, DS28EC20, ...).  A ROM command written some other way
+    // after a reset() ends the Resume until the next Match ROM.  Off by
+    // default, because a device which lost power since does not answer
+    // a Resume, and one added to the bus since the search answers the
+    // Skip ROM too: call forget_selected(), or search again, after
+    // either.  transaction() does so itself when a CRC check fails.
+    void set_auto_select(bool on);
+    void forget_selected(void);
+#else
+    void set_auto_select(bool on) { (void)on; }
+    void forget_selected(void) { }
+#endif
+
+    // Select the slot timing used by reset(), reads and writes, either
+    // ONEWIRE_STANDARD or ONEWIRE_OVERDRIVE.  Devices only switch to
+    // overdrive after an Overdrive Skip or Match ROM, and all of them
+    // return to standard speed at the next reset() at standard speed.
+    // Returns false if the bus master can't do that speed.  Overdrive
+    // slots are 1us to 10us, which needs a fast CPU with accurate
+    // delayMicroseconds(); 16 MHz AVR is not enough.
+    bool set_speed(uint8_t speed);
+    uint8_t get_speed(void) { return speed; }
+
+    // Use other slot lengths at standard speed, one of the OneWireTiming
+    // presets or a copy of one with changes:
+    //    static OneWireTiming quick = OneWireTiming::minimum;
+    //    quick.fast_reset = true;
+    //    ds.set_timing(&quick);
+    // The timing must remain valid for as long as it is used.  Returns
+    // false if the bus master can't change its timing.
+    bool set_timing(const OneWireTiming *timing);
+    const OneWireTiming *get_timing(void) { return timing; }
+
+    // Issue Overdrive Skip ROM (0x3C), after a reset() at standard speed.
+    // Every overdrive capable device is addressed and switches to
+    // overdrive speed, as does this bus.
+    void overdrive_skip(void);
+
+    // Issue Overdrive Match ROM (0x69), after a reset() at standard speed.
+    // Only this device switches to overdrive, so the following resets
+    // at overdrive speed reach only it (and any others already switched)
+    // while the rest of the bus waits for a standard speed reset.
+    void overdrive_select(const uint8_t rom[8]);
+
     // Write a byte. If 'power' is one then the wire is held high at
     // the end for parasitically powered devices. You are responsible
     // for eventually depowering it by calling depower() or doing
@@ -97,6 +518,19 @@ class OneWire
 
     void read_bytes(uint8_t *buf, uint16_t count);
 
+#if ONEWIRE_CRC
+    // Read 'count' bytes which end with the CRC8 the device sends, and
+    // check it.  The CRC is updated as each bit arrives, so the result is
+    // ready right after the last slot.  'crc' is the CRC of anything sent
+    // before, if the device's CRC covers the command as well.
+    bool read_bytes_crc8(uint8_t *buf, uint16_t count, uint8_t crc = 0);
+#if ONEWIRE_CRC16
+    // The same, for bytes which end with an inverted CRC16, such as the
+    // DS2408 registers or a DS2431 page.
+    bool read_bytes_crc16(uint8_t *buf, uint16_t count, uint16_t crc = 0);
+#endif
+#endif
+
     // Write a bit. The bus is always left powered at the end, see
     // note in write() about that.
     void write_bit(uint8_t v);
@@ -104,6 +538,27 @@ class OneWire
     // Read a bit.
     uint8_t read_bit(void);
 
+    // Perform one step of the search algorithm: read a ROM bit and its
+    // complement, then write back the bit value all participating devices
+    // agree on, or 'direction' if they disagree.  Returns the id bit in
+    // bit 0, the complement in bit 1 and the written direction in bit 2.
+    uint8_t triplet(uint8_t direction);
+
+    // Do a complete exchange with a device: a reset and ROM command as
+    // selected by 'address' (with 'rom' for ONEWIRE_ADDR_MATCH), then
+    // write 'txcount' bytes from 'tx' and read 'rxcount' bytes into 'rx'.
+    // The bytes are sent as one stream of slots, without the pin being
+    // released between them.  'check' selects a CRC at the end of 'rx' to
+    // verify, and 'power' leaves the bus powered as with write().  Returns
+    // ONEWIRE_OK, ONEWIRE_NO_PRESENCE or ONEWIRE_CRC_ERROR.  For example,
+    // reading a DS18B20 scratchpad:
+    //    uint8_t cmd = 0xBE, data[9];
+    //    ds.transaction(ONEWIRE_ADDR_MATCH, addr, &cmd, 1, data, 9, ONEWIRE_CHECK_CRC8);
+    uint8_t transaction(uint8_t address, const uint8_t *rom,
+                        const uint8_t *tx, uint16_t txcount,
+                        uint8_t *rx, uint16_t rxcount,
+                        uint8_t check = ONEWIRE_CHECK_NONE, bool power = 0);
+
     // Stop forcing power onto the bus. You only need to do this if
     // you used the 'power' flag to write() or used a write_bit() call
     // and aren't about to do another read or write. You would rather
@@ -112,6 +567,7 @@ class OneWire
     void depower(void);
 
 #if ONEWIRE_SEARCH
+#if ONEWIRE_SEARCH_STATE
     // Clear the search state so that if will start from the beginning again.
     void reset_search();
 
@@ -124,14 +580,44 @@ class OneWire
     // no devices, or you have already retrieved all of them.  It
     // might be a good idea to check the CRC to make sure you didn't
     // get garbage.  The order is deterministic. You will always get
-    // the same devices in the same order.
+    // the same devices in the same order.  A pass which finds a ROM with
+    // a bad CRC, or loses the devices part way, is repeated up to
+    // ONEWIRE_SEARCH_RETRIES times first.
     bool search(uint8_t *newAddr, bool search_mode = true);
+
+    // The same, finding only devices of the families in 'filter'.  Use
+    // the same filter until the search ends or is reset.
+    bool search(uint8_t *newAddr, const OneWireFamilyFilter &filter,
+                bool search_mode = true);
+#endif
+
+    // The same searches, from the place in 'cursor' rather than the
+    // search state of this instance.
+    bool search(OneWireSearchCursor &cursor, uint8_t *newAddr,
+                bool search_mode = true);
+    bool search(OneWireSearchCursor &cursor, uint8_t *newAddr,
+                const OneWireFamilyFilter &filter, bool search_mode = true);
+
+    // Check whether the device with this ROM is on the bus.  This is a
+    // search which only follows the branch of that ROM (Maxim's "verify"),
+    // so it costs one reset and 64 search triplets, less if the device is
+    // missing.  The state used by search() is not disturbed.
+    bool verify(const uint8_t rom[8]);
+
+    // Re-check a table of 'count' known ROMs, setting present[i] for each.
+    // Branches of the search tree are only explored where a device which
+    // is not in the table shows up; those devices are appended to the
+    // table (up to 'max_count' entries, present[] must be that long too).
+    // With an empty table this enumerates the whole bus.  Returns the new
+    // number of entries.  On a stable bus this costs one verify() per
+    // device and never repeats a full search.
+    uint8_t reverify(uint8_t roms[][8], uint8_t count, uint8_t max_count, bool *present);
 #endif
 
 #if ONEWIRE_CRC
     // Compute a Dallas Semiconductor 8 bit CRC, these are used in the
-    // ROM and scratchpad registers.
-    static uint8_t crc8(const uint8_t *addr, uint8_t len);
+    // ROM and scratchpad registers.  'crc' continues an earlier result.
+    static uint8_t crc8(const uint8_t *addr, uint8_t len, uint8_t crc = 0);
 
 #if ONEWIRE_CRC16
     // Compute the 1-Wire CRC16 and compare it against the received CRC.
@@ -173,6 +659,104 @@ class OneWire
 #endif
 };
 
+// Holds a bus with OneWire::lock() from here to the end of the block:
+//
+//    {
+//        OneWireLock hold(ds);
+//        ds.reset();
+//        ds.select(addr);
+//        ds.write(0xBE);
+//        ds.read_bytes(data, 9);
+//    }
+class OneWireLock
+{
+  public:
+    OneWireLock(OneWire &bus, uint32_t timeout = ONEWIRE_LOCK_FOREVER) : ow(bus) {
+        held = ow.lock(timeout);
+    }
+    ~OneWireLock() { if (held) ow.unlock(); }
+
+    // false if the timeout passed without getting the bus
+    bool held;
+
+  private:
+    OneWire &ow;
+    OneWireLock(const OneWireLock &);
+    OneWireLock &operator=(const OneWireLock &);
+};
+
+// Several buses on pins of the same GPIO port, driven in lock-step.  Each
+// slot is done on every bus at once with a combined pin mask, and all the
+// lines are sampled with a single port read, so N buses move data N times
+// as fast as N OneWire instances serviced one after another.  Bus i is
+// bit i of the presence and bit maps.  Only for boards where a port has
+// one register bit per pin (AVR, Teensy LC & 4.x, Due, Zero, chipKIT);
+// elsewhere begin() returns false.  On the host the buses are
+// OneWireBackends, each done in turn, for testing.
+#define ONEWIRE_GROUP_MAX 8
+
+class OneWireGroup
+{
+  private:
+#if ONEWIRE_HOST
+    OneWireBackend *bus[ONEWIRE_GROUP_MAX];
+#else
+    IO_REG_TYPE bitmask;                    // every pin of the group
+    IO_REG_TYPE pinmask[ONEWIRE_GROUP_MAX];
+    volatile IO_REG_TYPE *baseReg;
+#endif
+    uint8_t count;
+    const OneWireTiming *timing;
+
+  public:
+    OneWireGroup() : count(0), timing(&OneWireTiming::standard) { }
+    OneWireGroup(const uint8_t *pins, uint8_t num) : timing(&OneWireTiming::standard) {
+        begin(pins, num);
+    }
+
+    // Returns false if the pins are not all on one port, or this board
+    // can't drive a port with a combined mask.
+    bool begin(const uint8_t *pins, uint8_t num);
+#if ONEWIRE_HOST
+    bool begin(OneWireBackend *const *buses, uint8_t num);
+#endif
+    uint8_t buses(void) { return count; }
+
+    // Slot timing for every bus, as OneWire::set_timing().  It has to
+    // suit the slowest of them.  The 1 buses are released part way
+    // through the 0s' low time, so returns false, and keeps the timing
+    // it had, if write0_low is shorter than write1_low.
+    bool set_timing(const OneWireTiming *t) {
+        if (t->write0_low < t->write1_low) return false;
+        timing = t;
+        return true;
+    }
+    const OneWireTiming *get_timing(void) { return timing; }
+
+    // Reset every bus.  Bit i of the result is set if bus i had a
+    // presence pulse.  A bus whose line stays low is left out, and has
+    // no presence.
+    uint8_t reset(void);
+
+    // Write one bit to every bus, bit i of 'v' to bus i.
+    void write_bits(uint8_t v);
+
+    // Read one bit from every bus, bus i into bit i.
+    uint8_t read_bits(void);
+
+    // Write the same byte to every bus (Skip ROM, Convert T, etc)
+    void write(uint8_t v, uint8_t power = 0);
+
+    // Write bufs[i][0] to bufs[i][len-1] to bus i, all buses together.
+    void write_bytes(const uint8_t *const *bufs, uint16_t len, bool power = 0);
+
+    // Read 'len' bytes from each bus into bufs[i].
+    void read_bytes(uint8_t *const *bufs, uint16_t len);
+
+    // Stop forcing power onto the buses.
+    void depower(void);
+};
+
 // Prevent this name from leaking into Arduino sketches
 #ifdef IO_REG_TYPE
 #undef IO_REG_TYPE
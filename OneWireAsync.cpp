@@ -0,0 +1,233 @@
+// Background 1-Wire transactions, see OneWireAsync.h
+//
+// The slot timing is the same as OneWire.cpp (the OneWireTiming set on
+// the bus, at standard speed), but every wait longer
+// than a few microseconds is returned to the caller instead of spent
+// in delayMicroseconds().  Waits which are too short for a timer (the
+// write 1 low time and the read sample point) are still done inline,
+// with interrupts disabled exactly as in OneWire.cpp.  The write 0 low
+// time is left to the timer when run() is called from one, but done
+// inline from poll(): a late call there would stretch the low, and past
+// 480us every device takes it for a reset.
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include "OneWireAsync.h"
+#include "util/OneWire_direct_gpio.h"
+
+#ifdef ARDUINO_ARCH_ESP32
+#  define CRIT_TIMING IRAM_ATTR
+// the critical sections lock the bus, as in OneWire.cpp
+#  define onewire_mux (&ow.mux)
+#else
+#  define CRIT_TIMING
+#endif
+
+
+OneWireAsync::OneWireAsync(OneWire &bus) : ow(bus)
+{
+	state = IDLE;
+	presence = 0;
+	done = NULL;
+	arg = NULL;
+	due = 0;
+	polled = false;
+}
+
+bool OneWireAsync::start(bool reset, const uint8_t *tx, uint16_t txcount,
+	uint8_t *rx, uint16_t rxcount, bool power, callback_t done, void *arg)
+{
+	if (state != IDLE) return false;
+	this->tx = tx;
+	this->txcount = tx ? txcount : 0;
+	this->rx = rx;
+	this->rxcount = rx ? rxcount : 0;
+	this->power = power;
+	this->done = done;
+	this->arg = arg;
+	bit = 1;
+	presence = 1;
+	retries = 125;
+	due = micros();
+	state = reset ? RESET_WAIT_HIGH : SLOT;
+#if ONEWIRE_AUTO_SELECT
+	// tx begins with a ROM command OneWire doesn't see
+	if (reset) ow.addressed(NULL);
+#endif
+	return true;
+}
+
+bool OneWireAsync::poll(void)
+{
+	if (state == IDLE) return false;
+#if ONEWIRE_BACKEND
+	if (ow.backend) {
+		// other bus masters keep their own time, no need to wait
+		run();
+		return state != IDLE;
+	}
+#endif
+	if ((long)(micros() - due) >= 0) {
+		polled = true;
+		uint16_t usec = run();
+		polled = false;
+		due = micros() + usec;
+	}
+	return state != IDLE;
+}
+
+uint16_t OneWireAsync::finish(uint8_t r)
+{
+	presence = r;
+	state = IDLE;
+	if (done) done(r, arg);
+	// the callback may have started another transaction
+	return (state != IDLE) ? 1 : 0;
+}
+
+uint16_t CRIT_TIMING OneWireAsync::run(void)
+{
+	IO_REG_TYPE mask IO_REG_MASK_ATTR = ow.bitmask;
+	__attribute__((unused)) volatile IO_REG_TYPE *reg IO_REG_BASE_ATTR = ow.baseReg;
+	const OneWireTiming *t = ow.timing;
+
+#if ONEWIRE_BACKEND
+	if (ow.backend) {
+		// other bus masters do their own slot timing, so just
+		// do one step of the transaction per call
+		if (state == IDLE) return 0;
+		if (state == RESET_WAIT_HIGH) {
+			state = SLOT;
+			if (!ow.backend->reset()) return finish(0);
+		} else if (txcount) {
+			ow.backend->write(*tx++, 1);
+			txcount--;
+		} else if (rxcount) {
+			*rx++ = ow.backend->read();
+			rxcount--;
+		} else {
+			if (!power) ow.backend->depower();
+			return finish(presence);
+		}
+		return 1;
+	}
+#endif
+	switch (state) {
+	case RESET_WAIT_HIGH:
+		// wait until the wire is high... just in case
+		noInterrupts();
+		DIRECT_MODE_INPUT(reg, mask);
+		interrupts();
+		if (!DIRECT_READ(reg, mask)) {
+			if (--retries == 0) return finish(0);
+			return 2;
+		}
+		noInterrupts();
+		DIRECT_WRITE_LOW(reg, mask);
+		DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+		interrupts();
+		state = RESET_RELEASE;
+		return t->reset_low;
+	case RESET_RELEASE:
+		noInterrupts();
+		DIRECT_MODE_INPUT(reg, mask);	// allow it to float
+		interrupts();
+		state = RESET_SAMPLE;
+		return t->reset_sample;
+	case RESET_SAMPLE:
+		presence = !DIRECT_READ(reg, mask);
+		if (presence && t->fast_reset) {
+			// poll for the end of the presence pulse
+			retries = (t->reset_high > 510) ? 255 : t->reset_high / 2;
+			state = RESET_PRESENCE;
+			return 2;
+		}
+		state = RESET_TAIL;
+		return t->reset_high;
+	case RESET_PRESENCE:
+		if (!DIRECT_READ(reg, mask) && --retries) return 2;
+		state = RESET_TAIL;
+		return t->reset_recovery;
+	case RESET_TAIL:
+		if (!presence) return finish(0);
+		state = SLOT;
+		return next_slot();
+	case SLOT:
+		return next_slot();
+	case WRITE0_RELEASE:
+		noInterrupts();
+		DIRECT_WRITE_HIGH(reg, mask);	// drive output high
+		interrupts();
+		state = SLOT;
+		return t->write0_high;
+	}
+	return 0;
+}
+
+uint16_t CRIT_TIMING OneWireAsync::next_slot(void)
+{
+	IO_REG_TYPE mask IO_REG_MASK_ATTR = ow.bitmask;
+	__attribute__((unused)) volatile IO_REG_TYPE *reg IO_REG_BASE_ATTR = ow.baseReg;
+	const OneWireTiming *t = ow.timing;
+	uint8_t r;
+
+	if (txcount) {
+		r = *tx & bit;
+		if ((bit <<= 1) == 0) {
+			bit = 1;
+			tx++;
+			txcount--;
+		}
+		if (r) {
+			noInterrupts();
+			DIRECT_WRITE_LOW(reg, mask);
+			DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+			delayMicroseconds(t->write1_low);
+			DIRECT_WRITE_HIGH(reg, mask);	// drive output high
+			interrupts();
+			return t->write1_high;
+		}
+		noInterrupts();
+		DIRECT_WRITE_LOW(reg, mask);
+		DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+		if (!polled) {
+			// the timer ends the low
+			interrupts();
+			state = WRITE0_RELEASE;
+			return t->write0_low;
+		}
+		delayMicroseconds(t->write0_low);
+		DIRECT_WRITE_HIGH(reg, mask);	// drive output high
+		interrupts();
+		return t->write0_high;
+	}
+	if (rxcount) {
+		if (bit == 1) *rx = 0;
+		noInterrupts();
+		DIRECT_MODE_OUTPUT(reg, mask);
+		DIRECT_WRITE_LOW(reg, mask);
+		delayMicroseconds(t->read_low);
+		DIRECT_MODE_INPUT(reg, mask);	// let pin float, pull up will raise
+		delayMicroseconds(t->read_sample);
+		r = DIRECT_READ(reg, mask);
+		interrupts();
+		if (r) *rx |= bit;
+		if ((bit <<= 1) == 0) {
+			bit = 1;
+			rx++;
+			rxcount--;
+		}
+		return t->read_high;
+	}
+	if (!power) {
+		noInterrupts();
+		DIRECT_MODE_INPUT(reg, mask);
+		DIRECT_WRITE_LOW(reg, mask);
+		interrupts();
+	}
+	return finish(presence);
+}
+
+#undef CRIT_TIMING
+#undef onewire_mux
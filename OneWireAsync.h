@@ -0,0 +1,98 @@
+#ifndef OneWireAsync_h
+#define OneWireAsync_h
+
+#include "OneWire.h"
+
+// Background (non-blocking) transactions.  Instead of busy-waiting
+// through each slot in delayMicroseconds(), OneWireAsync does one bus
+// edge per call to run() and returns how many microseconds until the
+// next edge is due.  The CPU is only busy for the short parts of each
+// slot, about 13us for a read and 10us for writing a 1.  A reset costs
+// a few microseconds instead of 960.
+//
+// For best timing, call run() from a one-shot hardware timer and
+// re-arm the timer with its return value:
+//
+//    void timer_isr() {
+//        uint16_t usec = async.run();
+//        if (usec) start_one_shot_timer(usec);
+//    }
+//
+// Or call poll() as often as possible from loop(), which uses micros()
+// to decide when run() is due.  Either way, the call for the presence
+// sample should not be more than about 5us late.  From the timer, the
+// call which ends a write 0 should not be more than about 50us late.
+// loop() can't promise that, so poll() spins through the write 0 low
+// (65us) instead, and then only the presence sample is time critical:
+// the bus is idle high between slots, and the end of the reset low may
+// run long.  The completion callback runs inside run(), so from the
+// timer interrupt if used.  Overdrive slots are too short to schedule
+// this way, so the pin is always driven with standard speed timing.
+
+class OneWireAsync
+{
+  public:
+    // 'result' is the presence result of the reset, or 1 if the
+    // transaction had no reset.
+    typedef void (*callback_t)(uint8_t result, void *arg);
+
+    OneWireAsync(OneWire &bus);
+
+    // Start a transaction: a reset (if 'reset' is true) then write 'txcount'
+    // bytes from 'tx', then read 'rxcount' bytes into 'rx'.  Nothing is
+    // written or read if the reset finds no presence pulse.  The buffers
+    // must remain valid until it completes.  If 'power' is true, the bus
+    // is left driven high at the end, as with write().  Returns false if
+    // a transaction is already running.  Call run() or poll() to begin.
+    bool start(bool reset, const uint8_t *tx, uint16_t txcount,
+               uint8_t *rx, uint16_t rxcount, bool power = false,
+               callback_t done = NULL, void *arg = NULL);
+
+    bool start_reset(callback_t done = NULL, void *arg = NULL) {
+        return start(true, NULL, 0, NULL, 0, false, done, arg);
+    }
+    bool start_write(const uint8_t *buf, uint16_t count, bool power = false,
+                     callback_t done = NULL, void *arg = NULL) {
+        return start(false, buf, count, NULL, 0, power, done, arg);
+    }
+    bool start_read(uint8_t *buf, uint16_t count,
+                    callback_t done = NULL, void *arg = NULL) {
+        return start(false, NULL, 0, buf, count, false, done, arg);
+    }
+
+    // Do the next step.  Returns the microseconds until the next call is
+    // due, or 0 when the transaction has completed.
+    uint16_t run(void);
+
+    // Call run() if it is due.  Returns true while a transaction is running.
+    bool poll(void);
+
+    bool busy(void) const { return state != IDLE; }
+
+    // The result passed to the callback of the last completed transaction
+    uint8_t result(void) const { return presence; }
+
+  private:
+    uint16_t next_slot(void);
+    uint16_t finish(uint8_t r);
+
+    enum { IDLE, RESET_WAIT_HIGH, RESET_RELEASE, RESET_SAMPLE, RESET_PRESENCE,
+           RESET_TAIL, SLOT, WRITE0_RELEASE };
+
+    OneWire &ow;
+    volatile uint8_t state;
+    uint8_t presence;
+    uint8_t retries;
+    bool power;
+    bool polled;          // run() called from poll(), not a timer
+    const uint8_t *tx;
+    uint16_t txcount;
+    uint8_t *rx;
+    uint16_t rxcount;
+    uint8_t bit;          // mask of the bit being sent or received
+    callback_t done;
+    void *arg;
+    unsigned long due;
+};
+
+#endif
@@ -0,0 +1,287 @@
+// Bulk CRC8 and CRC16 kernels for host builds, see OneWireCRC.h
+//
+// Both 1-Wire CRCs are reflected (LSB first) with no final inversion, so
+// one set of code does both: the CRC8 is x^8 + x^5 + x^4 + 1 (0x8C
+// reflected) and the CRC16 is x^16 + x^15 + x^2 + 1 (0xA001 reflected).
+// The CRC8 tables hold 16 bit entries with the high byte always 0, which
+// lets the CRC8 use the same byte step as the CRC16.
+//
+// The carry-less multiply kernel folds 128 bit blocks of the message
+// forward with constants x^k mod P, the method of Intel's "Fast CRC
+// Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+// The constants are worked out from the polynomial at startup, and the
+// last 16 bytes of folded state go through the table, so there is no
+// Barrett reduction step.
+
+#include "OneWireCRC.h"
+
+#if ONEWIRE_HOST
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC_PCLMUL 1
+#else
+#define CRC_PCLMUL 0
+#endif
+
+struct CrcKernel {
+	uint16_t table[8][256];
+	// fold constants, for blocks 512 bits and 128 bits apart
+	uint64_t k512_hi, k512_lo, k128_hi, k128_lo;
+};
+
+struct CrcTables {
+	CrcKernel crc8;
+	CrcKernel crc16;
+	CrcTables();
+};
+
+// x^k mod P, with P given normally (0x131 or 0x18005) of degree 'width'
+static uint32_t xpow_mod(unsigned int k, uint32_t poly, uint8_t width)
+{
+	uint32_t r = 1;
+
+	while (k--) {
+		r <<= 1;
+		if (r & (1UL << width)) r ^= poly;
+	}
+	return r;
+}
+
+// Bit reverse into a 64 bit operand, so that x^d is bit 63-d.  Multiplying
+// two such operands gives the product with x^d at bit 126-d, which read as
+// a 128 bit block (x^d at bit 127-d) is the product times x.
+static uint64_t reflect64(uint32_t r)
+{
+	uint64_t v = 0;
+
+	for (uint8_t d = 0; d < 32; d++) {
+		if (r & (1UL << d)) v |= (uint64_t)1 << (63 - d);
+	}
+	return v;
+}
+
+static void make_kernel(CrcKernel &k, uint16_t reflected, uint32_t poly, uint8_t width)
+{
+	for (unsigned int b = 0; b < 256; b++) {
+		uint16_t c = b;
+		for (uint8_t i = 8; i; i--) {
+			c = (c & 1) ? (c >> 1) ^ reflected : (c >> 1);
+		}
+		k.table[0][b] = c;
+	}
+	// table[n][b] is the CRC of byte b followed by n zero bytes
+	for (unsigned int n = 1; n < 8; n++) {
+		for (unsigned int b = 0; b < 256; b++) {
+			uint16_t c = k.table[n - 1][b];
+			k.table[n][b] = (c >> 8) ^ k.table[0][c & 0xFF];
+		}
+	}
+	// A block H*x^64 + L moved D bits forward is H*x^(D+64) + L*x^D.
+	// One x is supplied by the multiply, see reflect64().
+	k.k512_hi = reflect64(xpow_mod(512 + 63, poly, width));
+	k.k512_lo = reflect64(xpow_mod(512 - 1, poly, width));
+	k.k128_hi = reflect64(xpow_mod(128 + 63, poly, width));
+	k.k128_lo = reflect64(xpow_mod(128 - 1, poly, width));
+}
+
+CrcTables::CrcTables()
+{
+	make_kernel(crc8, 0x8C, 0x131, 8);
+	make_kernel(crc16, 0xA001, 0x18005, 16);
+}
+
+static const CrcTables & tables(void)
+{
+	static const CrcTables t;
+	return t;
+}
+
+
+static uint16_t crc_table(const CrcKernel &k, const uint8_t *p, size_t len, uint16_t crc)
+{
+	while (len--) {
+		crc = (crc >> 8) ^ k.table[0][(crc ^ *p++) & 0xFF];
+	}
+	return crc;
+}
+
+static uint16_t crc_slice8(const CrcKernel &k, const uint8_t *p, size_t len, uint16_t crc)
+{
+	while (len >= 8) {
+		uint32_t lo = (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24)) ^ crc;
+		uint32_t hi = p[4] | (p[5] << 8) | (p[6] << 16) | ((uint32_t)p[7] << 24);
+		crc = k.table[7][lo & 0xFF] ^ k.table[6][(lo >> 8) & 0xFF] ^
+		      k.table[5][(lo >> 16) & 0xFF] ^ k.table[4][lo >> 24] ^
+		      k.table[3][hi & 0xFF] ^ k.table[2][(hi >> 8) & 0xFF] ^
+		      k.table[1][(hi >> 16) & 0xFF] ^ k.table[0][hi >> 24];
+		p += 8;
+		len -= 8;
+	}
+	return crc_table(k, p, len, crc);
+}
+
+#if CRC_PCLMUL
+__attribute__((target("pclmul,sse2")))
+static inline __m128i fold(__m128i a, __m128i k)
+{
+	return _mm_xor_si128(_mm_clmulepi64_si128(a, k, 0x00),
+	                     _mm_clmulepi64_si128(a, k, 0x11));
+}
+
+__attribute__((target("pclmul,sse2")))
+static uint16_t crc_pclmul(const CrcKernel &k, const uint8_t *p, size_t len, uint16_t crc)
+{
+	if (len < 64) return crc_slice8(k, p, len, crc);
+
+	const __m128i k512 = _mm_set_epi64x(k.k512_lo, k.k512_hi);
+	const __m128i k128 = _mm_set_epi64x(k.k128_lo, k.k128_hi);
+	__m128i a0, a1, a2, a3;
+	uint8_t state[16];
+
+	// the starting CRC goes into the first bits of the message
+	a0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)p), _mm_cvtsi32_si128(crc));
+	a1 = _mm_loadu_si128((const __m128i *)(p + 16));
+	a2 = _mm_loadu_si128((const __m128i *)(p + 32));
+	a3 = _mm_loadu_si128((const __m128i *)(p + 48));
+	p += 64;
+	len -= 64;
+	while (len >= 64) {
+		a0 = _mm_xor_si128(fold(a0, k512), _mm_loadu_si128((const __m128i *)p));
+		a1 = _mm_xor_si128(fold(a1, k512), _mm_loadu_si128((const __m128i *)(p + 16)));
+		a2 = _mm_xor_si128(fold(a2, k512), _mm_loadu_si128((const __m128i *)(p + 32)));
+		a3 = _mm_xor_si128(fold(a3, k512), _mm_loadu_si128((const __m128i *)(p + 48)));
+		p += 64;
+		len -= 64;
+	}
+	a0 = _mm_xor_si128(fold(a0, k128), a1);
+	a0 = _mm_xor_si128(fold(a0, k128), a2);
+	a0 = _mm_xor_si128(fold(a0, k128), a3);
+	while (len >= 16) {
+		a0 = _mm_xor_si128(fold(a0, k128), _mm_loadu_si128((const __m128i *)p));
+		p += 16;
+		len -= 16;
+	}
+	// what's left is congruent to the message so far, finish by table
+	_mm_storeu_si128((__m128i *)state, a0);
+	crc = crc_slice8(k, state, 16, 0);
+	return crc_slice8(k, p, len, crc);
+}
+#endif
+
+static uint16_t crc_basic8(const CrcKernel &k, const uint8_t *p, size_t len, uint16_t crc)
+{
+	(void)k;
+#if ONEWIRE_CRC
+	while (len > 255) {
+		crc = OneWire::crc8(p, 255, crc);
+		p += 255;
+		len -= 255;
+	}
+	return OneWire::crc8(p, len, crc);
+#else
+	return crc_table(tables().crc8, p, len, crc);
+#endif
+}
+
+static uint16_t crc_basic16(const CrcKernel &k, const uint8_t *p, size_t len, uint16_t crc)
+{
+	(void)k;
+#if ONEWIRE_CRC && ONEWIRE_CRC16
+	while (len > 0xFFFF) {
+		crc = OneWire::crc16(p, 0xFFFF, crc);
+		p += 0xFFFF;
+		len -= 0xFFFF;
+	}
+	return OneWire::crc16(p, len, crc);
+#else
+	return crc_table(tables().crc16, p, len, crc);
+#endif
+}
+
+
+typedef uint16_t (*crc_func_t)(const CrcKernel &k, const uint8_t *p, size_t len, uint16_t crc);
+
+static uint8_t kernel = ONEWIRE_CRC_AUTO;
+static crc_func_t func8, func16;
+
+bool OneWireCRC::available(uint8_t k)
+{
+	switch (k) {
+	case ONEWIRE_CRC_AUTO:
+	case ONEWIRE_CRC_TABLE:
+	case ONEWIRE_CRC_SLICE8:
+		return true;
+	case ONEWIRE_CRC_BASIC:
+		return ONEWIRE_CRC && ONEWIRE_CRC16;
+#if CRC_PCLMUL
+	case ONEWIRE_CRC_PCLMUL:
+		return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse2");
+#endif
+	}
+	return false;
+}
+
+bool OneWireCRC::select(uint8_t k)
+{
+	if (!available(k)) return false;
+	if (k == ONEWIRE_CRC_AUTO) {
+		k = available(ONEWIRE_CRC_PCLMUL) ? ONEWIRE_CRC_PCLMUL : ONEWIRE_CRC_SLICE8;
+	}
+	switch (k) {
+	case ONEWIRE_CRC_BASIC:
+		func8 = crc_basic8;
+		func16 = crc_basic16;
+		break;
+	case ONEWIRE_CRC_TABLE:
+		func8 = func16 = crc_table;
+		break;
+#if CRC_PCLMUL
+	case ONEWIRE_CRC_PCLMUL:
+		func8 = func16 = crc_pclmul;
+		break;
+#endif
+	default:
+		func8 = func16 = crc_slice8;
+		break;
+	}
+	kernel = k;
+	return true;
+}
+
+uint8_t OneWireCRC::selected(void)
+{
+	if (kernel == ONEWIRE_CRC_AUTO) select(ONEWIRE_CRC_AUTO);
+	return kernel;
+}
+
+const char * OneWireCRC::name(uint8_t k)
+{
+	static const char *const names[ONEWIRE_CRC_KERNELS] = {
+		"auto", "basic", "table", "slice8", "pclmul"
+	};
+	return (k < ONEWIRE_CRC_KERNELS) ? names[k] : "unknown";
+}
+
+uint8_t OneWireCRC::crc8(const uint8_t *buf, size_t len, uint8_t crc)
+{
+	if (kernel == ONEWIRE_CRC_AUTO) select(ONEWIRE_CRC_AUTO);
+	return func8(tables().crc8, buf, len, crc);
+}
+
+uint16_t OneWireCRC::crc16(const uint8_t *buf, size_t len, uint16_t crc)
+{
+	if (kernel == ONEWIRE_CRC_AUTO) select(ONEWIRE_CRC_AUTO);
+	return func16(tables().crc16, buf, len, crc);
+}
+
+bool OneWireCRC::check_crc16(const uint8_t *buf, size_t len,
+	const uint8_t *inverted_crc, uint16_t crc)
+{
+	crc = ~crc16(buf, len, crc);
+	return (crc & 0xFF) == inverted_crc[0] && (crc >> 8) == inverted_crc[1];
+}
+
+#endif // ONEWIRE_HOST
@@ -0,0 +1,45 @@
+#ifndef OneWireCRC_h
+#define OneWireCRC_h
+
+#include "OneWire.h"
+
+#if ONEWIRE_HOST
+
+// Bulk 1-Wire CRC8 and CRC16, for host programs which check a lot of
+// captured data.  OneWire::crc8() and OneWire::crc16() are sized for
+// microcontrollers (a 32 byte table, a nibble parity loop); these use
+// larger tables, and carry-less multiply on x86 CPUs which have it.  The
+// results are the same as OneWire::crc8(), crc16() and check_crc16() for
+// every input and starting value.
+//
+//    if (OneWireCRC::check_crc16(record, len - 2, record + len - 2)) ...
+//
+// The fastest kernel the CPU supports is used unless select() picks one.
+
+#include <stddef.h>
+
+#define ONEWIRE_CRC_AUTO    0   // the fastest available
+#define ONEWIRE_CRC_BASIC   1   // OneWire::crc8() and crc16()
+#define ONEWIRE_CRC_TABLE   2   // 256 entry table, one byte per step
+#define ONEWIRE_CRC_SLICE8  3   // 8 tables, 8 bytes per step
+#define ONEWIRE_CRC_PCLMUL  4   // x86 PCLMULQDQ, 64 bytes per step
+#define ONEWIRE_CRC_KERNELS 5
+
+class OneWireCRC
+{
+  public:
+    static uint8_t crc8(const uint8_t *buf, size_t len, uint8_t crc = 0);
+    static uint16_t crc16(const uint8_t *buf, size_t len, uint16_t crc = 0);
+    static bool check_crc16(const uint8_t *buf, size_t len,
+                            const uint8_t *inverted_crc, uint16_t crc = 0);
+
+    // Use one kernel for all later calls.  Returns false if this CPU (or
+    // build) doesn't have it, leaving the kernel unchanged.
+    static bool select(uint8_t kernel);
+    static uint8_t selected(void);
+    static bool available(uint8_t kernel);
+    static const char *name(uint8_t kernel);
+};
+
+#endif // ONEWIRE_HOST
+#endif
@@ -0,0 +1,142 @@
+// Cache of device reads, see OneWireCache.h
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <string.h>
+#include "OneWireCache.h"
+
+const OneWireCacheRead OneWireCache::scratchpad = {
+	{ 0xBE, 0, 0 }, 1, 9, ONEWIRE_CHECK_CRC8
+};
+
+const OneWireCacheRead OneWireCache::ds2408_registers = {
+	{ 0xF0, 0x88, 0x00 }, 3, 10, ONEWIRE_CHECK_CRC16 | ONEWIRE_CHECK_TX
+};
+
+OneWireCache::OneWireCache(OneWire &bus, uint16_t ms) : ow(bus)
+{
+	ttl = ms;
+	hits = 0;
+	misses = 0;
+	coalesced = 0;
+	for (uint8_t i = 0; i < ONEWIRE_CACHE_ENTRIES; i++) {
+		memset(entries[i].rom, 0, 8);
+		entries[i].taken = false;
+		entries[i].valid = false;
+		entries[i].wanted = false;
+	}
+}
+
+// Whether two reads send the same command bytes and read the same block
+static bool same_read(const OneWireCacheRead &a, const OneWireCacheRead &b)
+{
+	return a.txcount == b.txcount && a.rxcount == b.rxcount &&
+		a.check == b.check && memcmp(a.tx, b.tx, a.txcount) == 0;
+}
+
+// The entry for 'rom' and 'what'.  If there is none and 'add' is set, the
+// least recently used entry is taken for it.
+OneWireCache::Entry * OneWireCache::find(const uint8_t *rom,
+	const OneWireCacheRead &what, bool add)
+{
+	Entry *victim = NULL;
+	uint32_t now = millis();
+
+	for (uint8_t i = 0; i < ONEWIRE_CACHE_ENTRIES; i++) {
+		Entry *e = &entries[i];
+		if (e->taken && same_read(e->what, what) && memcmp(e->rom, rom, 8) == 0) {
+			return e;
+		}
+		if (!add || e->wanted) continue;
+		if (!victim || (!e->taken && victim->taken) ||
+		    (e->taken && victim->taken && now - e->used > now - victim->used)) {
+			victim = e;
+		}
+	}
+	if (!victim) return NULL;
+	memcpy(victim->rom, rom, 8);
+	victim->what = what;
+	victim->taken = true;
+	victim->valid = false;
+	victim->wanted = false;
+	victim->used = now;
+	return victim;
+}
+
+bool OneWireCache::fresh(const Entry *e) const
+{
+	return e->valid && millis() - e->stamp < ttl;
+}
+
+bool OneWireCache::fetch(Entry *e)
+{
+	uint8_t data[ONEWIRE_CACHE_DATA];
+	const OneWireCacheRead *w = &e->what;
+
+	misses++;
+	e->wanted = false;
+	if (w->rxcount > ONEWIRE_CACHE_DATA) return false;
+	if (ow.transaction(ONEWIRE_ADDR_MATCH, e->rom, w->tx, w->txcount,
+	    data, w->rxcount, w->check) != ONEWIRE_OK) {
+		return false;
+	}
+	memcpy(e->data, data, w->rxcount);
+	e->stamp = millis();
+	e->valid = true;
+	return true;
+}
+
+bool OneWireCache::read(const uint8_t *rom, const OneWireCacheRead &what, uint8_t *data)
+{
+	OneWireLock hold(ow);
+	Entry *e = find(rom, what, true);
+
+	if (!e) {
+		// every entry is wanted, read around the cache
+		misses++;
+		return ow.transaction(ONEWIRE_ADDR_MATCH, rom, what.tx, what.txcount,
+			data, what.rxcount, what.check) == ONEWIRE_OK;
+	}
+	e->used = millis();
+	if (fresh(e)) {
+		hits++;
+	} else if (!fetch(e)) {
+		return false;
+	}
+	memcpy(data, e->data, what.rxcount);
+	return true;
+}
+
+void OneWireCache::want(const uint8_t *rom, const OneWireCacheRead &what)
+{
+	Entry *e = find(rom, what, true);
+
+	if (!e) return;
+	e->used = millis();
+	if (e->wanted || fresh(e)) {
+		coalesced++;
+	} else {
+		e->wanted = true;
+	}
+}
+
+uint8_t OneWireCache::refresh(void)
+{
+	OneWireLock hold(ow);
+	uint8_t failed = 0;
+
+	for (uint8_t i = 0; i < ONEWIRE_CACHE_ENTRIES; i++) {
+		Entry *e = &entries[i];
+		if (e->wanted && !fresh(e) && !fetch(e)) failed++;
+		e->wanted = false;
+	}
+	return failed;
+}
+
+void OneWireCache::invalidate(const uint8_t *rom)
+{
+	for (uint8_t i = 0; i < ONEWIRE_CACHE_ENTRIES; i++) {
+		if (!rom || memcmp(entries[i].rom, rom, 8) == 0) entries[i].valid = false;
+	}
+}
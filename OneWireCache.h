@@ -0,0 +1,98 @@
+#ifndef OneWireCache_h
+#define OneWireCache_h
+
+#include "OneWire.h"
+
+// A cache of device reads, keyed by ROM, for buses where several parts of
+// a program ask the same devices for their state.  Each entry holds the
+// last CRC checked block read from a device (a DS18x20 scratchpad, the
+// DS2408 registers, etc) and when it was read.  read() answers from the
+// cache while the entry is younger than the TTL, and only goes to the
+// bus when it is older or missing.
+//
+//    OneWireCache cache(ds, 500);     // data up to 500ms old is fine
+//    uint8_t scratchpad[9];
+//    if (cache.read(rom, OneWireCache::scratchpad, scratchpad)) ...
+//
+// Requests can also be collected with want() and served with one
+// refresh(), which reads each stale entry once however many parts of the
+// program wanted it, and then read() finds them all in the cache.
+//
+// The cache doesn't see other traffic on the bus.  After writing to a
+// device, or starting a temperature conversion, call invalidate().
+
+// Entries kept, the least recently used is replaced
+#ifndef ONEWIRE_CACHE_ENTRIES
+#define ONEWIRE_CACHE_ENTRIES 8
+#endif
+
+// Largest block, in bytes, including its CRC
+#define ONEWIRE_CACHE_DATA 10
+
+// What to read from a device: the function command bytes sent after Match
+// ROM, the number of bytes read back, and the ONEWIRE_CHECK_ flags for
+// transaction()
+struct OneWireCacheRead
+{
+    uint8_t tx[3];
+    uint8_t txcount;
+    uint8_t rxcount;
+    uint8_t check;
+};
+
+class OneWireCache
+{
+  public:
+    OneWireCache(OneWire &bus, uint16_t ttl = 1000);
+
+    // How old, in milliseconds, cached data may be
+    void set_ttl(uint16_t ms) { ttl = ms; }
+
+    // Get 'what' from the device 'rom' into data[], from the cache if
+    // it's fresh.  Returns false if it's not cached and the read fails
+    // (no presence, or a bad CRC).
+    bool read(const uint8_t *rom, const OneWireCacheRead &what, uint8_t *data);
+
+    // Note that 'what' from 'rom' will be needed soon, for refresh()
+    void want(const uint8_t *rom, const OneWireCacheRead &what);
+
+    // Read every wanted entry which isn't fresh, once.  Returns the
+    // number of reads which failed.
+    uint8_t refresh(void);
+
+    // Forget what is cached for 'rom', or for every device if NULL
+    void invalidate(const uint8_t *rom = NULL);
+
+    // Read Scratchpad (0xBE) of a DS18x20, 9 bytes with a CRC8
+    static const OneWireCacheRead scratchpad;
+    // DS2408 registers 0x88 to 0x8F, with the CRC16 (10 bytes)
+    static const OneWireCacheRead ds2408_registers;
+
+    // Reads answered from the cache, reads which went to the bus, and
+    // want() calls which joined a read already wanted
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t coalesced;
+
+  private:
+    struct Entry {
+        uint8_t rom[8];
+        OneWireCacheRead what;  // a copy, the caller's may be gone
+        uint8_t data[ONEWIRE_CACHE_DATA];
+        uint32_t stamp;         // millis() when read
+        uint32_t used;          // millis() when last asked for
+        bool taken;             // rom and what are set
+        bool valid;
+        bool wanted;
+    };
+
+    Entry * find(const uint8_t *rom, const OneWireCacheRead &what, bool add);
+    bool fresh(const Entry *e) const;
+    bool fetch(Entry *e);
+
+    OneWire &ow;
+    uint16_t ttl;
+    Entry entries[ONEWIRE_CACHE_ENTRIES];
+};
+
+#endif
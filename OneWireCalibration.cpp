@@ -0,0 +1,165 @@
+// Slot timing calibration, see OneWireCalibration.h
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <string.h>
+#include "OneWireCalibration.h"
+
+// The sample point sweep uses long slots, so only the sample point
+// decides whether a pass matches
+#define CAL_SLOT_LONG      90
+#define CAL_SAMPLE_MAX     60
+#define CAL_RECOVERY_MAX   30
+
+// Shortest slot, the datasheet 60us plus 1us recovery
+#define CAL_SLOT_MIN       61
+
+// Latest sample after the falling edge, tMSR in the datasheets
+#define CAL_SAMPLE_LATEST  15
+
+// Passes the final timing must match in a row
+#define CAL_REPEAT         4
+
+OneWireCalibration::OneWireCalibration(OneWire &bus) : ow(bus)
+{
+	timing = OneWireTiming::standard;
+	rise_usec = 0;
+	hold_usec = 0;
+	recovery_usec = 0;
+	passes = 0;
+	base = &OneWireTiming::standard;
+	memset(rom, 0, 8);
+	memset(reference, 0, sizeof(reference));
+	valid = false;
+	checked = 0;
+}
+
+// A search pass for rom[] with timing 't': reset, Search ROM, then the
+// 64 triplets with rom[] as the direction.  The id and complement bits
+// read are kept as the reference if 'record' is set, otherwise compared
+// with it.
+bool OneWireCalibration::pass(const OneWireTiming *t, bool record)
+{
+	const OneWireTiming *was = ow.get_timing();
+	uint8_t bits[16];
+	bool ok = false;
+
+	passes++;
+	memset(bits, 0, sizeof(bits));
+	if (!ow.set_timing(t)) return false;
+	if (ow.reset()) {
+		ow.write(0xF0);
+		for (uint8_t i = 0; i < 64; i++) {
+			uint8_t r = ow.triplet((rom[i >> 3] >> (i & 7)) & 1);
+			bits[i >> 2] |= (r & 3) << ((i & 3) * 2);
+		}
+		if (record) {
+			memcpy(reference, bits, sizeof(bits));
+			ok = true;
+		} else {
+			ok = memcmp(bits, reference, sizeof(bits)) == 0;
+		}
+	}
+	ow.set_timing(was);
+	return ok;
+}
+
+bool OneWireCalibration::run(const uint8_t *r, const OneWireTiming *b)
+{
+	OneWireTiming t;
+	uint8_t s, lo = 0, hi = 0, margin;
+	uint16_t slot;
+
+	base = b;
+	valid = false;
+	timing = *base;
+	if (r) {
+		if (r != rom) memcpy(rom, r, 8);
+	} else {
+#if ONEWIRE_SEARCH
+		const OneWireTiming *was = ow.get_timing();
+		OneWireSearchCursor cursor;
+		bool found;
+		if (!ow.set_timing(base)) return false;
+		found = ow.search(cursor, rom);
+		ow.set_timing(was);
+		if (!found) return false;
+#else
+		return false;
+#endif
+	}
+	if (!pass(base, true) || !pass(base)) return false;
+
+	// the sample point, with long slots and recovery times
+	t = *base;
+	t.write0_high = CAL_RECOVERY_MAX;
+	for (s = 1; s <= CAL_SAMPLE_MAX; s++) {
+		t.read_sample = s;
+		t.read_high = CAL_SLOT_LONG - t.read_low - s;
+		if (pass(&t)) {
+			if (!lo) lo = s;
+			hi = s;
+		} else if (lo) {
+			break;
+		}
+	}
+	if (!lo) return false;
+	rise_usec = lo;
+	hold_usec = t.read_low + hi;
+	margin = (hi - lo) / 4;
+	if (margin < 1) margin = 1;
+	t.read_sample = lo + margin;
+	if (t.read_sample > hi) t.read_sample = hi;
+	// never past tMSR, where a device may already have let go of its 0
+	if (t.read_low + lo > CAL_SAMPLE_LATEST) return false;
+	if (t.read_low + t.read_sample > CAL_SAMPLE_LATEST) {
+		t.read_sample = CAL_SAMPLE_LATEST - t.read_low;
+	}
+
+	// a 1 must have risen by the time the devices sample, 15us in
+	if (t.write1_low + rise_usec > 14) {
+		t.write1_low = (rise_usec < 13) ? 14 - rise_usec : 1;
+	}
+
+	// the shortest recovery after a 0, from the write 0 low time or the
+	// end of a device's 0 in a read slot
+	for (s = 1; s <= CAL_RECOVERY_MAX; s++) {
+		t.write0_high = s;
+		slot = hold_usec + 1 + s;
+		if (slot < CAL_SLOT_MIN) slot = CAL_SLOT_MIN;
+		t.read_high = slot - t.read_low - t.read_sample;
+		if (pass(&t)) break;
+	}
+	if (s > CAL_RECOVERY_MAX) return false;
+	margin = s / 4;
+	if (margin < 1) margin = 1;
+	recovery_usec = s + margin;
+
+	t.write0_high = recovery_usec;
+	slot = hold_usec + 1 + recovery_usec;
+	if (slot < CAL_SLOT_MIN) slot = CAL_SLOT_MIN;
+	t.read_high = slot - t.read_low - t.read_sample;
+	slot = t.write1_low + recovery_usec;
+	if (slot < CAL_SLOT_MIN) slot = CAL_SLOT_MIN;
+	t.write1_high = slot - t.write1_low;
+	for (s = 0; s < CAL_REPEAT; s++) {
+		if (!pass(&t)) return false;
+	}
+	timing = t;
+	valid = true;
+	return true;
+}
+
+bool OneWireCalibration::check(void)
+{
+	if (valid && pass(&timing)) return true;
+	return run(valid ? rom : NULL, base);
+}
+
+bool OneWireCalibration::poll(uint32_t interval)
+{
+	if (millis() - checked < interval) return valid;
+	checked = millis();
+	return check();
+}
@@ -0,0 +1,83 @@
+#ifndef OneWireCalibration_h
+#define OneWireCalibration_h
+
+#include "OneWire.h"
+
+// Tune the standard speed slot timing of a bus to the bus itself.  The
+// fixed timings sample a read 13us after the falling edge and allow 5us
+// for the bus to rise after a 0, which has to suit every bus.  run()
+// measures this one instead: it repeats a search pass for one device at
+// each sample point and recovery time, comparing the id and complement
+// bits with a pass at the starting timing, and keeps the window where
+// they match.
+//
+//    OneWireCalibration cal(ds);
+//    if (cal.run()) ds.set_timing(&cal.timing);
+//
+// rise_usec is the earliest sample after the bus is released at which a
+// 1 reads as 1, and hold_usec the latest after the falling edge at which
+// a device's 0 still reads as 0.  The sample point is put a quarter of
+// the way into that window, but never later than 15us after the falling
+// edge (tMSR); a bus which only reads a 1 after that fails.  The
+// recovery time after a 0 is a quarter above the shortest which worked.
+// Slots stay at least 61us long, and the resets are left as they were.
+//
+// The result is only valid for the device it was measured on.  Another
+// with a weaker pulldown or a shorter hold time may not fit the window,
+// so on a bus of several, run() with each and keep the timing with the
+// earliest sample point and the longest recovery.
+//
+// check() repeats the pass with the tuned timing, and runs the
+// calibration again if it fails, so a bus whose wiring or load changes
+// keeps working.  poll() does that every so often, from loop().
+//
+// timing is a plain struct, so a known bus can keep it in EEPROM and
+// start with it rather than calibrating again:
+//    EEPROM.put(0, cal.timing);
+//    ...
+//    static OneWireTiming saved;
+//    EEPROM.get(0, saved);
+//    ds.set_timing(&saved);
+
+class OneWireCalibration
+{
+  public:
+    OneWireCalibration(OneWire &bus);
+
+    // Calibrate with the device 'rom', or the first one search() finds
+    // if NULL, starting from 'base', which must work on this bus and
+    // remain valid for check().  The bus keeps the timing it was using.
+    // Returns false if the device doesn't answer, or no sample point
+    // by 15us works.
+    bool run(const uint8_t *rom = NULL,
+             const OneWireTiming *base = &OneWireTiming::standard);
+
+    // Check the tuned timing, calibrate again if it fails.  Returns
+    // false if that fails too, and timing goes back to the base timing.
+    bool check(void);
+
+    // check() if 'interval' ms have passed since the last one.  Returns
+    // false while the bus has no working timing.
+    bool poll(uint32_t interval);
+
+    // The result, valid after run() returns true
+    OneWireTiming timing;
+    uint8_t rise_usec;
+    uint8_t hold_usec;
+    uint8_t recovery_usec;
+
+    // Search passes done, including the ones by check()
+    uint16_t passes;
+
+  private:
+    bool pass(const OneWireTiming *t, bool record = false);
+
+    OneWire &ow;
+    const OneWireTiming *base;
+    uint8_t rom[8];
+    uint8_t reference[16];     // id and complement bits at 'base'
+    bool valid;
+    uint32_t checked;
+};
+
+#endif
@@ -0,0 +1,335 @@
+// DS2480B serial 1-Wire line driver backend, see OneWireDS2480B.h
+//
+// The DS2480B has a command mode, where each byte is a reset, a single
+// bit slot, or a setting, and a data mode, where each byte is sent on the
+// 1-Wire bus and the byte read back is returned.  0xE1 enters data mode;
+// 0xE3 in data mode returns to command mode, so a data byte of 0xE3 is
+// sent twice.  The speed bits (SS) of the last reset, bit or accelerator
+// command set the 1-Wire speed: 00 standard, 10 overdrive.
+
+#include "OneWireDS2480B.h"
+
+#if ONEWIRE_HOST
+
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define DS2480_DATA_MODE      0xE1
+#define DS2480_COMMAND_MODE   0xE3
+#define DS2480_RESET          0xC1   // 110SS01
+#define DS2480_BIT            0x81   // 100DSS01
+#define DS2480_ACCEL_ON       0xB1   // 1011SS01
+#define DS2480_ACCEL_OFF      0xA1   // 1010SS01
+#define DS2480_PULSE          0xED   // 5V strong pullup
+#define DS2480_PULSE_END      0xF1
+#define DS2480_SPUD_INFINITE  0x3F   // 0PPPVVV1: strong pullup duration (3), until ended (7)
+
+// milliseconds to wait for the chip, longer than any command takes
+#define DS2480_TIMEOUT        250
+// data bytes per exchange, each may need escaping
+#define DS2480_CHUNK          64
+
+OneWireDS2480B::OneWireDS2480B()
+{
+	fd = -1;
+	own_fd = false;
+	in_data_mode = false;
+	pulse = false;
+	speed_bits = 0;
+	txcount = 0;
+	error = false;
+	exchanges = 0;
+	bytes_sent = 0;
+}
+
+OneWireDS2480B::~OneWireDS2480B()
+{
+	end();
+}
+
+bool OneWireDS2480B::begin(const char *device)
+{
+	int f = open(device, O_RDWR | O_NOCTTY);
+	if (f < 0) return false;
+	if (!begin(f)) {
+		close(f);
+		return false;
+	}
+	own_fd = true;
+	return true;
+}
+
+bool OneWireDS2480B::begin(int f)
+{
+	struct termios tio;
+	uint8_t r;
+
+	end();
+	if (tcgetattr(f, &tio) == 0) {
+		cfmakeraw(&tio);
+		cfsetispeed(&tio, B9600);
+		cfsetospeed(&tio, B9600);
+		tio.c_cflag |= CLOCAL | CREAD;
+		tio.c_cc[VMIN] = 0;
+		tio.c_cc[VTIME] = 0;
+		tcsetattr(f, TCSANOW, &tio);
+	}
+	fd = f;
+	own_fd = false;
+	in_data_mode = false;
+	pulse = false;
+	speed_bits = 0;
+	error = false;
+
+	// a break resets the chip, then it measures the first byte (a
+	// reset command) to learn the baud rate, and doesn't answer it
+	tcsendbreak(fd, 0);
+	usleep(2000);
+	txcount = 0;
+	put(DS2480_RESET);
+	exchange(NULL, 0);
+	usleep(5000);
+	tcflush(fd, TCIFLUSH);
+
+	// keep the strong pullup on until it is ended
+	put(DS2480_SPUD_INFINITE);
+	if (!exchange(&r, 1) || r != (DS2480_SPUD_INFINITE & 0xFE)) {
+		fd = -1;
+		return false;
+	}
+	return true;
+}
+
+void OneWireDS2480B::end(void)
+{
+	if (fd >= 0 && own_fd) close(fd);
+	fd = -1;
+	own_fd = false;
+}
+
+// Queue bytes for the next exchange()
+void OneWireDS2480B::put(uint8_t c)
+{
+	if (txcount < sizeof(tx)) tx[txcount++] = c;
+}
+
+void OneWireDS2480B::put_data(uint8_t v)
+{
+	put(v);
+	if (v == DS2480_COMMAND_MODE) put(v);
+}
+
+void OneWireDS2480B::command_mode(void)
+{
+	if (in_data_mode) put(DS2480_COMMAND_MODE);
+	in_data_mode = false;
+}
+
+void OneWireDS2480B::data_mode(void)
+{
+	if (!in_data_mode) put(DS2480_DATA_MODE);
+	in_data_mode = true;
+}
+
+// Send the queued bytes in one write and read 'rxcount' response bytes
+bool OneWireDS2480B::exchange(uint8_t *rx, uint16_t rxcount)
+{
+	uint16_t sent = 0, got = 0;
+
+	if (fd < 0) {
+		txcount = 0;
+		error = true;
+		if (rx) memset(rx, 0xFF, rxcount);
+		return false;
+	}
+	exchanges++;
+	bytes_sent += txcount;
+	while (sent < txcount) {
+		ssize_t n = ::write(fd, tx + sent, txcount - sent);
+		if (n <= 0) break;
+		sent += n;
+	}
+	txcount = 0;
+	while (got < rxcount) {
+		struct pollfd p = { fd, POLLIN, 0 };
+		if (poll(&p, 1, DS2480_TIMEOUT) <= 0) break;
+		ssize_t n = ::read(fd, rx + got, rxcount - got);
+		if (n <= 0) break;
+		got += n;
+	}
+	if (got < rxcount) {
+		memset(rx + got, 0xFF, rxcount - got);
+		error = true;
+		return false;
+	}
+	return true;
+}
+
+// A powered write leaves the strong pullup on, end it before anything else
+void OneWireDS2480B::end_pulse(void)
+{
+	uint8_t r;
+
+	if (!pulse) return;
+	pulse = false;
+	command_mode();
+	put(DS2480_PULSE_END);
+	exchange(&r, 1);
+}
+
+uint8_t OneWireDS2480B::reset(void)
+{
+	uint8_t r;
+
+	end_pulse();
+	command_mode();
+	put(DS2480_RESET | speed_bits);
+	if (!exchange(&r, 1)) return 0;
+	// low 2 bits: 00 shorted, 01 presence, 10 alarming presence,
+	// 11 no presence
+	r &= 3;
+	return r == 1 || r == 2;
+}
+
+void OneWireDS2480B::write_bit(uint8_t v)
+{
+	uint8_t r;
+
+	end_pulse();
+	command_mode();
+	put(DS2480_BIT | ((v & 1) << 4) | speed_bits);
+	exchange(&r, 1);
+}
+
+uint8_t OneWireDS2480B::read_bit(void)
+{
+	uint8_t r;
+
+	end_pulse();
+	command_mode();
+	put(DS2480_BIT | 0x10 | speed_bits);
+	exchange(&r, 1);
+	return r & 1;
+}
+
+void OneWireDS2480B::write(uint8_t v, uint8_t power)
+{
+	write_bytes(&v, 1, power);
+}
+
+uint8_t OneWireDS2480B::read(void)
+{
+	uint8_t r;
+
+	read_bytes(&r, 1);
+	return r;
+}
+
+void OneWireDS2480B::write_bytes(const uint8_t *buf, uint16_t count, bool power)
+{
+	uint8_t echo[DS2480_CHUNK];
+
+	end_pulse();
+	while (count) {
+		uint16_t n = count < DS2480_CHUNK ? count : DS2480_CHUNK;
+		data_mode();
+		for (uint16_t i = 0; i < n; i++) put_data(buf[i]);
+		if (power && n == count) {
+			// the strong pullup goes on right after the last byte
+			command_mode();
+			put(DS2480_PULSE);
+			pulse = true;
+		}
+		exchange(echo, n);
+		if (memcmp(echo, buf, n) != 0) error = true;
+		buf += n;
+		count -= n;
+	}
+}
+
+void OneWireDS2480B::read_bytes(uint8_t *buf, uint16_t count)
+{
+	end_pulse();
+	while (count) {
+		uint16_t n = count < DS2480_CHUNK ? count : DS2480_CHUNK;
+		data_mode();
+		for (uint16_t i = 0; i < n; i++) put(0xFF);
+		exchange(buf, n);
+		buf += n;
+		count -= n;
+	}
+}
+
+uint8_t OneWireDS2480B::triplet(uint8_t direction)
+{
+	uint8_t r[2];
+
+	end_pulse();
+	command_mode();
+	put(DS2480_BIT | 0x10 | speed_bits);
+	put(DS2480_BIT | 0x10 | speed_bits);
+	exchange(r, 2);
+	uint8_t id_bit = r[0] & 1;
+	uint8_t cmp_id_bit = r[1] & 1;
+	if (id_bit != cmp_id_bit) direction = id_bit;
+	write_bit(direction);
+	return id_bit | (cmp_id_bit << 1) | (direction << 2);
+}
+
+void OneWireDS2480B::depower(void)
+{
+	end_pulse();
+}
+
+bool OneWireDS2480B::set_speed(uint8_t speed)
+{
+	if (speed != ONEWIRE_STANDARD && speed != ONEWIRE_OVERDRIVE) return false;
+	speed_bits = (speed == ONEWIRE_OVERDRIVE) ? 0x08 : 0x00;
+	// the accelerator command changes the data mode speed without
+	// any activity on the bus
+	end_pulse();
+	command_mode();
+	put(DS2480_ACCEL_OFF | speed_bits);
+	exchange(NULL, 0);
+	return true;
+}
+
+//
+// The search accelerator takes 16 bytes, two bits per ROM bit: the
+// discrepancy flag, then the direction.  The chip returns the same layout
+// with the discrepancies it saw and the bits it wrote.
+//
+bool OneWireDS2480B::search_bits(const uint8_t *direction, uint8_t *rom,
+	uint8_t *discrepancy)
+{
+	uint8_t buf[16];
+
+	end_pulse();
+	memset(buf, 0, sizeof(buf));
+	for (uint8_t bit = 0; bit < 64; bit++) {
+		if (direction[bit >> 3] & (1 << (bit & 7))) {
+			buf[bit >> 2] |= 2 << ((bit & 3) * 2);
+		}
+	}
+	command_mode();
+	put(DS2480_ACCEL_ON | speed_bits);
+	data_mode();
+	for (uint8_t i = 0; i < 16; i++) put_data(buf[i]);
+	command_mode();
+	put(DS2480_ACCEL_OFF | speed_bits);
+	exchange(buf, 16);
+
+	memset(rom, 0, 8);
+	memset(discrepancy, 0, 8);
+	for (uint8_t bit = 0; bit < 64; bit++) {
+		uint8_t pair = buf[bit >> 2] >> ((bit & 3) * 2);
+		if (pair & 1) discrepancy[bit >> 3] |= 1 << (bit & 7);
+		if (pair & 2) rom[bit >> 3] |= 1 << (bit & 7);
+	}
+	return true;
+}
+
+#endif // ONEWIRE_HOST
@@ -0,0 +1,77 @@
+#ifndef OneWireDS2480B_h
+#define OneWireDS2480B_h
+
+#include "OneWire.h"
+
+#if ONEWIRE_HOST
+
+// A 1-Wire bus through a DS2480B serial line driver (DS9097U and similar
+// adapters) on a Linux serial port.
+//
+//    OneWireDS2480B adapter;
+//    if (!adapter.begin("/dev/ttyUSB0")) ...
+//    OneWire ds(adapter);
+//
+// Byte sequences are sent in data mode as one serial write each, with a
+// single read for all the echoed bytes, and search() uses the chip's
+// search accelerator, so a whole search pass is one round trip instead
+// of 192 single bit commands.  With write(v, 1) the strong pullup is
+// turned on after the byte, and stays on until depower() or the next
+// operation.
+//
+// Serial timing is real, but like every host backend the 1-Wire time is
+// not added to the host clock.
+
+class OneWireDS2480B : public OneWireBackend
+{
+  public:
+    OneWireDS2480B();
+    ~OneWireDS2480B();
+
+    // Open a serial port at 9600 baud, reset the chip and check it
+    // answers.  Returns false if it doesn't.
+    bool begin(const char *device);
+
+    // The same on a descriptor which is already open (a pty, etc).  It
+    // is not closed by end().
+    bool begin(int fd);
+    void end(void);
+
+    uint8_t reset(void);
+    void write_bit(uint8_t v);
+    uint8_t read_bit(void);
+    void write(uint8_t v, uint8_t power);
+    uint8_t read(void);
+    void write_bytes(const uint8_t *buf, uint16_t count, bool power);
+    void read_bytes(uint8_t *buf, uint16_t count);
+    uint8_t triplet(uint8_t direction);
+    void depower(void);
+    bool set_speed(uint8_t speed);
+    bool search_bits(const uint8_t *direction, uint8_t *rom, uint8_t *discrepancy);
+
+    // Set when a response was missing or wrong, cleared by begin()
+    bool error;
+
+    // Serial round trips and bytes sent, for profiling
+    uint32_t exchanges;
+    uint32_t bytes_sent;
+
+  private:
+    void command_mode(void);
+    void data_mode(void);
+    void put(uint8_t c);
+    void put_data(uint8_t v);
+    bool exchange(uint8_t *rx, uint16_t rxcount);
+    void end_pulse(void);
+
+    int fd;
+    bool own_fd;
+    bool in_data_mode;
+    bool pulse;
+    uint8_t speed_bits;
+    uint8_t tx[160];
+    uint16_t txcount;
+};
+
+#endif // ONEWIRE_HOST
+#endif
@@ -0,0 +1,270 @@
+// DS2482-100 and DS2482-800 I2C 1-Wire bridge backend, see OneWireDS2482.h
+//
+// Every command leaves the read pointer at the status register, except
+// Set Read Pointer, Write Configuration and Channel Select, which leave
+// it at the register they set.  So after a 1-Wire command, reading one
+// byte is a status poll.  Commands sent while the 1-Wire busy bit is set
+// are ignored, so each command first waits for the one before it.
+
+#include "OneWireDS2482.h"
+
+#if ONEWIRE_BACKEND
+
+#define DS2482_DEVICE_RESET    0xF0
+#define DS2482_SET_POINTER     0xE1
+#define DS2482_WRITE_CONFIG    0xD2
+#define DS2482_CHANNEL_SELECT  0xC3
+#define DS2482_1W_RESET        0xB4
+#define DS2482_1W_BIT          0x87
+#define DS2482_1W_WRITE        0xA5
+#define DS2482_1W_READ         0x96
+#define DS2482_1W_TRIPLET      0x78
+
+// read pointer codes
+#define DS2482_PTR_DATA        0xE1
+
+// status register
+#define DS2482_STATUS_1WB      0x01   // 1-Wire busy
+#define DS2482_STATUS_PPD      0x02   // presence pulse detected
+#define DS2482_STATUS_SD       0x04   // short detected
+#define DS2482_STATUS_RST      0x10   // device reset since last config write
+#define DS2482_STATUS_SBR      0x20   // single bit result
+#define DS2482_STATUS_TSB      0x40   // triplet second bit
+#define DS2482_STATUS_DIR      0x80   // triplet direction taken
+
+// Status reads before giving up on a busy chip.  The longest command is a
+// byte at standard speed, under 700us, and each poll takes at least 45us
+// at 400kHz.
+#define DS2482_POLL_LIMIT      200
+
+OneWireDS2482::OneWireDS2482(OneWireI2C &bus, uint8_t addr) : i2c(bus)
+{
+	address = addr;
+	config = DS2482_CONFIG_APU;
+	busy = false;
+	pullup = false;
+	error = false;
+	transfers = 0;
+	polls = 0;
+}
+
+bool OneWireDS2482::begin(void)
+{
+	uint8_t status;
+
+	busy = false;
+	pullup = false;
+	error = false;
+	if (!command(DS2482_DEVICE_RESET)) return false;
+	transfers++;
+	if (!i2c.read(address, &status, 1) || !(status & DS2482_STATUS_RST)) {
+		error = true;
+		return false;
+	}
+	config = DS2482_CONFIG_APU;
+	return write_config(config);
+}
+
+// Send a command, once the previous one has finished
+bool OneWireDS2482::command(uint8_t c)
+{
+	if (busy) wait();
+	pullup = false;
+	transfers++;
+	if (!i2c.write(address, &c, 1)) {
+		error = true;
+		return false;
+	}
+	return true;
+}
+
+bool OneWireDS2482::command(uint8_t c, uint8_t p)
+{
+	uint8_t buf[2] = { c, p };
+
+	if (busy) wait();
+	pullup = false;
+	transfers++;
+	if (!i2c.write(address, buf, 2)) {
+		error = true;
+		return false;
+	}
+	return true;
+}
+
+// Poll the status register until the 1-Wire command finishes
+uint8_t OneWireDS2482::wait(void)
+{
+	uint8_t status = DS2482_STATUS_1WB;
+
+	busy = false;
+	for (uint16_t n = 0; n < DS2482_POLL_LIMIT; n++) {
+		transfers++;
+		polls++;
+		if (!i2c.read(address, &status, 1)) break;
+		if (!(status & DS2482_STATUS_1WB)) return status;
+	}
+	error = true;
+	return status | DS2482_STATUS_1WB;
+}
+
+// The configuration byte is sent with its complement in the upper 4 bits,
+// and reads back as the lower 4 bits
+bool OneWireDS2482::write_config(uint8_t c)
+{
+	uint8_t r;
+
+	if (!command(DS2482_WRITE_CONFIG, (c & 0x0F) | (~c << 4))) return false;
+	transfers++;
+	if (!i2c.read(address, &r, 1) || r != (c & 0x0F)) {
+		error = true;
+		return false;
+	}
+	return true;
+}
+
+bool OneWireDS2482::select_channel(uint8_t channel)
+{
+	uint8_t r;
+
+	if (channel > 7) return false;
+	// the codes are F0, E1, D2 ... 87 and the read back values B8, B1,
+	// AA ... 87.  A DS2482-100 doesn't know the command.
+	if (!command(DS2482_CHANNEL_SELECT, 0xF0 - channel * 0x0F)) return false;
+	transfers++;
+	return i2c.read(address, &r, 1) && r == 0xB8 - channel * 7;
+}
+
+uint8_t OneWireDS2482::reset(void)
+{
+	if (!command(DS2482_1W_RESET)) return 0;
+	busy = true;
+	uint8_t status = wait();
+	return (status & (DS2482_STATUS_1WB | DS2482_STATUS_PPD | DS2482_STATUS_SD))
+		== DS2482_STATUS_PPD;
+}
+
+void OneWireDS2482::write_bit(uint8_t v)
+{
+	busy = command(DS2482_1W_BIT, v ? 0x80 : 0x00);
+}
+
+uint8_t OneWireDS2482::read_bit(void)
+{
+	if (!command(DS2482_1W_BIT, 0x80)) return 1;
+	busy = true;
+	return (wait() & DS2482_STATUS_SBR) ? 1 : 0;
+}
+
+void OneWireDS2482::write(uint8_t v, uint8_t power)
+{
+	// the strong pullup is armed first, and turns on after the byte
+	if (power) write_config(config | DS2482_CONFIG_SPU);
+	busy = command(DS2482_1W_WRITE, v);
+	pullup = power && busy;
+}
+
+uint8_t OneWireDS2482::read(void)
+{
+	static const uint8_t pointer[2] = { DS2482_SET_POINTER, DS2482_PTR_DATA };
+	uint8_t v;
+
+	if (!command(DS2482_1W_READ)) return 0xFF;
+	busy = true;
+	wait();
+	transfers++;
+	if (!i2c.write_read(address, pointer, 2, &v, 1)) {
+		error = true;
+		return 0xFF;
+	}
+	return v;
+}
+
+void OneWireDS2482::write_bytes(const uint8_t *buf, uint16_t count, bool power)
+{
+	for (uint16_t i = 0; i < count; i++) {
+		write(buf[i], power && i == count - 1);
+	}
+}
+
+void OneWireDS2482::read_bytes(uint8_t *buf, uint16_t count)
+{
+	for (uint16_t i = 0; i < count; i++) buf[i] = read();
+}
+
+uint8_t OneWireDS2482::triplet(uint8_t direction)
+{
+	if (!command(DS2482_1W_TRIPLET, direction ? 0x80 : 0x00)) return 3;
+	busy = true;
+	uint8_t status = wait();
+	return ((status & DS2482_STATUS_SBR) ? 1 : 0) |
+	       ((status & DS2482_STATUS_TSB) ? 2 : 0) |
+	       ((status & DS2482_STATUS_DIR) ? 4 : 0);
+}
+
+void OneWireDS2482::depower(void)
+{
+	if (pullup) write_config(config);
+}
+
+bool OneWireDS2482::set_speed(uint8_t speed)
+{
+	if (speed != ONEWIRE_STANDARD && speed != ONEWIRE_OVERDRIVE) return false;
+	if (speed == ONEWIRE_OVERDRIVE) config |= DS2482_CONFIG_1WS;
+	else config &= ~DS2482_CONFIG_1WS;
+	return write_config(config);
+}
+
+
+#if ONEWIRE_HOST
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+bool OneWireI2CLinux::begin(const char *device)
+{
+	end();
+	fd = open(device, O_RDWR);
+	return fd >= 0;
+}
+
+void OneWireI2CLinux::end(void)
+{
+	if (fd >= 0) close(fd);
+	fd = -1;
+}
+
+bool OneWireI2CLinux::write(uint8_t addr, const uint8_t *buf, uint8_t len)
+{
+	struct i2c_msg msg = { addr, 0, len, (uint8_t *)buf };
+	struct i2c_rdwr_ioctl_data data = { &msg, 1 };
+
+	return fd >= 0 && ioctl(fd, I2C_RDWR, &data) == 1;
+}
+
+bool OneWireI2CLinux::read(uint8_t addr, uint8_t *buf, uint8_t len)
+{
+	struct i2c_msg msg = { addr, I2C_M_RD, len, buf };
+	struct i2c_rdwr_ioctl_data data = { &msg, 1 };
+
+	return fd >= 0 && ioctl(fd, I2C_RDWR, &data) == 1;
+}
+
+// both messages in one ioctl, with a repeated start between them
+bool OneWireI2CLinux::write_read(uint8_t addr, const uint8_t *wbuf, uint8_t wlen,
+	uint8_t *rbuf, uint8_t rlen)
+{
+	struct i2c_msg msg[2] = {
+		{ addr, 0, wlen, (uint8_t *)wbuf },
+		{ addr, I2C_M_RD, rlen, rbuf }
+	};
+	struct i2c_rdwr_ioctl_data data = { msg, 2 };
+
+	return fd >= 0 && ioctl(fd, I2C_RDWR, &data) == 2;
+}
+
+#endif // ONEWIRE_HOST
+#endif // ONEWIRE_BACKEND
@@ -0,0 +1,146 @@
+#ifndef OneWireDS2482_h
+#define OneWireDS2482_h
+
+#include "OneWire.h"
+
+#if ONEWIRE_BACKEND
+
+// A 1-Wire bus through a DS2482-100 or DS2482-800 I2C bridge.  The chip
+// does the slot timing itself: reset, byte write, byte read, single bits
+// and the search triplet (the id bit, its complement and the direction,
+// three slots) are one I2C command each, and the strong pullup is done
+// in hardware.
+//
+//    OneWireWire<TwoWire> i2c(Wire);
+//    OneWireDS2482 bridge(i2c);
+//    OneWire ds(bridge);
+//    Wire.begin();
+//    if (!bridge.begin()) ...
+//
+// Writes return as soon as the command is sent, and the chip's busy flag
+// is only polled before the next command, so the CPU is free while the
+// slots run.  Reads wait for the result.
+//
+// On the DS2482-800, select_channel() switches between its 8 buses.  Use
+// one OneWireDS2482 per chip, and one OneWire per channel if each needs
+// its own search state.
+
+// The I2C bus, as the DS2482 backend needs it.  Addresses are 7 bit.
+class OneWireI2C
+{
+  public:
+    virtual bool write(uint8_t addr, const uint8_t *buf, uint8_t len) = 0;
+    virtual bool read(uint8_t addr, uint8_t *buf, uint8_t len) = 0;
+
+    // A write then a read with a repeated start, where the bus can
+    virtual bool write_read(uint8_t addr, const uint8_t *wbuf, uint8_t wlen,
+                            uint8_t *rbuf, uint8_t rlen) {
+        return write(addr, wbuf, wlen) && read(addr, rbuf, rlen);
+    }
+};
+
+// OneWireI2C on an Arduino Wire object (TwoWire, or any class with the
+// same functions)
+template <class W>
+class OneWireWire : public OneWireI2C
+{
+  public:
+    OneWireWire(W &w) : wire(w) { }
+
+    bool write(uint8_t addr, const uint8_t *buf, uint8_t len) {
+        wire.beginTransmission(addr);
+        wire.write(buf, len);
+        return wire.endTransmission() == 0;
+    }
+
+    bool read(uint8_t addr, uint8_t *buf, uint8_t len) {
+        if (wire.requestFrom(addr, len) != len) return false;
+        for (uint8_t i = 0; i < len; i++) buf[i] = wire.read();
+        return true;
+    }
+
+    bool write_read(uint8_t addr, const uint8_t *wbuf, uint8_t wlen,
+                    uint8_t *rbuf, uint8_t rlen) {
+        wire.beginTransmission(addr);
+        wire.write(wbuf, wlen);
+        if (wire.endTransmission(false) != 0) return false;
+        return read(addr, rbuf, rlen);
+    }
+
+  private:
+    W &wire;
+};
+
+#if ONEWIRE_HOST
+// OneWireI2C on a Linux i2c-dev adapter, /dev/i2c-1 etc
+class OneWireI2CLinux : public OneWireI2C
+{
+  public:
+    OneWireI2CLinux() : fd(-1) { }
+    ~OneWireI2CLinux() { end(); }
+
+    bool begin(const char *device);
+    void end(void);
+
+    bool write(uint8_t addr, const uint8_t *buf, uint8_t len);
+    bool read(uint8_t addr, uint8_t *buf, uint8_t len);
+    bool write_read(uint8_t addr, const uint8_t *wbuf, uint8_t wlen,
+                    uint8_t *rbuf, uint8_t rlen);
+
+  private:
+    int fd;
+};
+#endif
+
+// Configuration bits
+#define DS2482_CONFIG_APU   0x01   // active pullup
+#define DS2482_CONFIG_SPU   0x04   // strong pullup after the next write
+#define DS2482_CONFIG_1WS   0x08   // overdrive speed
+
+class OneWireDS2482 : public OneWireBackend
+{
+  public:
+    // 'address' is 0x18 to 0x1B (DS2482-100) or 0x18 to 0x1F (-800)
+    OneWireDS2482(OneWireI2C &i2c, uint8_t address = 0x18);
+
+    // Reset the chip and turn on the active pullup.  Returns false if
+    // it doesn't answer.
+    bool begin(void);
+
+    // DS2482-800 only: make 'channel' (0 to 7) the 1-Wire bus used by
+    // the following commands.  Returns false on a DS2482-100.
+    bool select_channel(uint8_t channel);
+
+    uint8_t reset(void);
+    void write_bit(uint8_t v);
+    uint8_t read_bit(void);
+    void write(uint8_t v, uint8_t power);
+    uint8_t read(void);
+    void write_bytes(const uint8_t *buf, uint16_t count, bool power);
+    void read_bytes(uint8_t *buf, uint16_t count);
+    uint8_t triplet(uint8_t direction);
+    void depower(void);
+    bool set_speed(uint8_t speed);
+
+    // Set when the chip didn't answer or stayed busy, cleared by begin()
+    bool error;
+
+    // I2C transactions and status polls, for profiling
+    uint32_t transfers;
+    uint32_t polls;
+
+  private:
+    bool command(uint8_t c);
+    bool command(uint8_t c, uint8_t p);
+    uint8_t wait(void);
+    bool write_config(uint8_t c);
+
+    OneWireI2C &i2c;
+    uint8_t address;
+    uint8_t config;
+    bool busy;        // a 1-Wire command may still be running
+    bool pullup;      // strong pullup armed or on
+};
+
+#endif // ONEWIRE_BACKEND
+#endif
@@ -0,0 +1,193 @@
+// DS2431, DS2433 and DS28EC20 EEPROM, see OneWireEEPROM.h
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include <string.h>
+#include "OneWireEEPROM.h"
+
+#if ONEWIRE_CRC && ONEWIRE_CRC16
+
+// features
+#define EEPROM_WRITE_CRC  0x01    // Write and Read Scratchpad end with a CRC16
+#define EEPROM_PAGE_CRC   0x02    // Extended Read Memory, a CRC16 per page
+#define EEPROM_ROWS       0x04    // only a whole scratchpad can be copied
+#define EEPROM_RESUME     0x08    // has Resume ROM
+
+#define EEPROM_PAGE       32      // page size, and the largest scratchpad
+
+OneWireEEPROM::OneWireEEPROM(OneWire &bus) : ow(bus)
+{
+	size = 0;
+	prog_ms = 0;
+	scratchpad = 0;
+	features = 0;
+	address = ONEWIRE_ADDR_MATCH;
+}
+
+uint16_t OneWireEEPROM::memory_size(uint8_t family)
+{
+	switch (family) {
+	case 0x2D: return 128;    // DS2431
+	case 0x23: return 512;    // DS2433
+	case 0x43: return 2560;   // DS28EC20
+	}
+	return 0;
+}
+
+// The layout of this device, and the next transaction addresses it with
+// Match ROM.  False if the range doesn't fit in it.
+bool OneWireEEPROM::setup(const uint8_t *rom, uint16_t addr, uint16_t len)
+{
+	size = memory_size(rom[0]);
+	switch (rom[0]) {
+	case 0x2D:
+		scratchpad = 8;
+		features = EEPROM_WRITE_CRC | EEPROM_ROWS | EEPROM_RESUME;
+		prog_ms = 10;
+		break;
+	case 0x43:
+		scratchpad = EEPROM_PAGE;
+		features = EEPROM_WRITE_CRC | EEPROM_PAGE_CRC | EEPROM_RESUME;
+		prog_ms = 10;
+		break;
+	default:
+		scratchpad = EEPROM_PAGE;
+		features = 0;
+		prog_ms = 5;
+		break;
+	}
+	address = ONEWIRE_ADDR_MATCH;
+	return size && (uint32_t)addr + len <= size;
+}
+
+// Match ROM the first time, then Resume ROM if the device has it
+uint8_t OneWireEEPROM::addressing(void)
+{
+	uint8_t a = address;
+
+	if (features & EEPROM_RESUME) address = ONEWIRE_ADDR_RESUME;
+	return a;
+}
+
+bool OneWireEEPROM::read(const uint8_t *rom, uint16_t addr, uint8_t *buf, uint16_t len)
+{
+	uint8_t cmd[3], tail[EEPROM_PAGE + 2];
+	OneWireLock hold(ow);
+
+	if (!setup(rom, addr, len)) return false;
+	if (!len) return true;
+	cmd[1] = addr & 0xFF;
+	cmd[2] = addr >> 8;
+	if (!(features & EEPROM_PAGE_CRC)) {
+		cmd[0] = 0xF0;          // Read Memory
+		return ow.transaction(addressing(), rom, cmd, 3, buf, len) == ONEWIRE_OK;
+	}
+
+	cmd[0] = 0xA5;                  // Extended Read Memory
+	if (ow.transaction(addressing(), rom, cmd, 3, NULL, 0) != ONEWIRE_OK) return false;
+	// the first page's CRC covers the command and address too
+	uint16_t crc = OneWire::crc16(cmd, 3);
+	while (len) {
+		// every page is read to its end for its CRC, the bytes past
+		// the last one wanted into tail[]
+		uint8_t rest = EEPROM_PAGE - (addr & (EEPROM_PAGE - 1));
+		uint8_t n = (len < rest) ? len : rest;
+		ow.read_bytes(buf, n);
+		ow.read_bytes(tail, rest - n + 2);
+		crc = OneWire::crc16(buf, n, crc);
+		if (!OneWire::check_crc16(tail, rest - n, tail + rest - n, crc)) return false;
+		crc = 0;
+		buf += n;
+		addr += n;
+		len -= n;
+	}
+	return true;
+}
+
+bool OneWireEEPROM::write(const uint8_t *rom, uint16_t addr, const uint8_t *buf, uint16_t len)
+{
+	uint8_t row[EEPROM_PAGE];
+	OneWireLock hold(ow);
+
+	if (!setup(rom, addr, len)) return false;
+	while (len) {
+		uint8_t offset = addr & (scratchpad - 1);
+		uint8_t n = scratchpad - offset;
+		if (len < n) n = len;
+		if ((features & EEPROM_ROWS) && n != scratchpad) {
+			// the rest of the row as it is now
+			if (!read(rom, addr - offset, row, scratchpad)) return false;
+			memcpy(row + offset, buf, n);
+			if (!program(rom, addr - offset, row, scratchpad)) return false;
+		} else {
+			if (!program(rom, addr, buf, n)) return false;
+		}
+		buf += n;
+		addr += n;
+		len -= n;
+	}
+	return true;
+}
+
+//
+// Write 'count' bytes to one scratchpad, check them, and copy them to
+// 'addr'.  The copy is authorized with the target address and the
+// ending offset, as the device would report them in Read Scratchpad.
+//
+bool OneWireEEPROM::program(const uint8_t *rom, uint16_t addr, const uint8_t *data,
+	uint8_t count)
+{
+	uint8_t tx[3 + EEPROM_PAGE], rx[3 + EEPROM_PAGE];
+	uint8_t es = (addr + count - 1) & (scratchpad - 1);
+	// written to the end of the scratchpad, the device sends the CRC16
+	// of everything it received
+	bool crc = (features & EEPROM_WRITE_CRC) && es == scratchpad - 1;
+
+	tx[0] = 0x0F;                   // Write Scratchpad
+	tx[1] = addr & 0xFF;
+	tx[2] = addr >> 8;
+	memcpy(tx + 3, data, count);
+	if (ow.transaction(addressing(), rom, tx, 3 + count, rx, crc ? 2 : 0,
+	    crc ? ONEWIRE_CHECK_CRC16 | ONEWIRE_CHECK_TX : ONEWIRE_CHECK_NONE) != ONEWIRE_OK) {
+		return false;
+	}
+	if (!crc) {
+		// nothing to show what arrived, so read it back
+		tx[0] = 0xAA;           // Read Scratchpad
+		if (ow.transaction(addressing(), rom, tx, 1, rx, 3 + count) != ONEWIRE_OK ||
+		    rx[0] != tx[1] || rx[1] != tx[2] || rx[2] != es ||
+		    memcmp(rx + 3, data, count) != 0) {
+			return false;
+		}
+	}
+	tx[0] = 0x55;                   // Copy Scratchpad
+	tx[3] = es;
+	if (ow.transaction(addressing(), rom, tx, 4, NULL, 0, ONEWIRE_CHECK_NONE, 1) != ONEWIRE_OK) {
+		return false;
+	}
+	return copied();
+}
+
+//
+// The copy draws its programming current from the bus, so the strong
+// pullup stays on for all of tPROG with no slots on the bus.  After that
+// the device sends alternating 1s and 0s if the copy finished.
+//
+bool OneWireEEPROM::copied(void)
+{
+	uint8_t v;
+
+	delay(prog_ms);
+	ow.depower();
+	v = ow.read();
+	return v == 0xAA || v == 0x55;
+}
+
+#undef EEPROM_WRITE_CRC
+#undef EEPROM_PAGE_CRC
+#undef EEPROM_ROWS
+#undef EEPROM_RESUME
+#undef EEPROM_PAGE
+
+#endif
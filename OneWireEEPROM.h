@@ -0,0 +1,66 @@
+#ifndef OneWireEEPROM_h
+#define OneWireEEPROM_h
+
+#include "OneWire.h"
+
+#if ONEWIRE_CRC && ONEWIRE_CRC16
+
+// Reading and writing the EEPROM of a DS2431 (128 bytes, family 0x2D),
+// DS2433 (512 bytes, 0x23) or DS28EC20 (2560 bytes, 0x43) in blocks of
+// any length.
+//
+// A read is one Read Memory command, streamed straight into the caller's
+// buffer.  The DS28EC20 is read with Extended Read Memory, which adds a
+// CRC16 at the end of each 32 byte page, and each one is checked.  The
+// other two send no CRC, so a device which stops answering part way
+// reads as 0xFF.
+//
+// A write goes through the scratchpad a page (DS2431: an 8 byte row) at
+// a time: Write Scratchpad, then Copy Scratchpad with the bus powered
+// for the part's whole tPROG (10ms, the DS2433 5ms), then one read of
+// the completion byte.
+// Where the device returns a CRC16 of the bytes it received (a DS2431
+// row, a whole DS28EC20 page) that verifies the scratchpad, otherwise it
+// is read back before the copy.  After the first Match ROM the device
+// is addressed with Resume ROM where it has one (not the DS2433).
+//
+//    OneWireEEPROM eeprom(ds);
+//    eeprom.write(rom, 0x100, data, 600);
+//    eeprom.read(rom, 0, buf, sizeof(buf));
+
+class OneWireEEPROM
+{
+  public:
+    OneWireEEPROM(OneWire &bus);
+
+    // Read 'len' bytes from 'addr' into 'buf'.  Returns false if the
+    // device is missing or not one of the above, the range is past the
+    // end of its memory, or a page CRC is wrong.
+    bool read(const uint8_t *rom, uint16_t addr, uint8_t *buf, uint16_t len);
+
+    // Write 'len' bytes from 'buf' to 'addr'.  Part of a DS2431 row is
+    // read first and written back whole.  Returns false as read() does,
+    // or if a page did not reach the scratchpad intact or its copy did
+    // not finish; the pages before it are written.
+    bool write(const uint8_t *rom, uint16_t addr, const uint8_t *buf, uint16_t len);
+
+    // Memory size in bytes of the device with this family code, 0 if it
+    // is not one of the above.
+    static uint16_t memory_size(uint8_t family);
+
+  private:
+    OneWire &ow;
+    uint16_t size;
+    uint8_t scratchpad;
+    uint8_t features;
+    uint8_t prog_ms;      // tPROG of a Copy Scratchpad
+    uint8_t address;      // the ROM command for the next transaction
+
+    bool setup(const uint8_t *rom, uint16_t addr, uint16_t len);
+    uint8_t addressing(void);
+    bool program(const uint8_t *rom, uint16_t addr, const uint8_t *data, uint8_t count);
+    bool copied(void);
+};
+
+#endif
+#endif
@@ -0,0 +1,246 @@
+#ifndef OneWireFixed_h
+#define OneWireFixed_h
+
+#include "OneWire.h"
+
+// A 1-Wire bus on a pin fixed at compile time.  OneWire keeps the pin
+// register and mask in RAM and loads them for every slot; OneWireFixed
+// takes them from a "pin" class given as a template parameter, so when
+// they are constants each pin access compiles to a single instruction
+// (sbi/cbi/sbis on AVR) and the slot timing doesn't depend on where the
+// compiler happened to keep the register pointer.
+//
+// The pin class has two static functions, base() returning the pin's
+// base register as PIN_TO_BASEREG() would (the PINx register on AVR,
+// the PDOR bit-band alias on Teensy 3, etc), and mask() returning its
+// bit mask.  On AVR, OneWirePort gives both from the port letter and
+// bit, so Arduino Uno pin 2, bit 2 of port D, is:
+//
+//    OneWireFixed< OneWirePort<'D', 2> > bus;
+//
+// OneWirePin<N> works out the register and mask from an Arduino pin
+// number.  On ESP32 and ESP8266 those are constants too.  On other
+// boards, AVR included, it costs a table lookup per call, outside the
+// timing critical parts, and the pin accesses are loads and stores
+// through a pointer as in OneWire.
+//
+//    OneWireFixed< OneWirePin<10> > bus;
+//
+// The bus can be used on its own, with reset(), select(), write(),
+// read() and the rest called directly, which needs no ONEWIRE_BACKEND:
+//
+//    bus.begin();
+//    if (bus.reset()) {
+//        bus.skip();
+//        bus.write(0x44);
+//    }
+//
+// With ONEWIRE_BACKEND it is also a OneWireBackend, so a OneWire built
+// on it has search(), transaction() and the rest, through a virtual call
+// per bit or byte:
+//
+//    OneWire ds(bus);
+
+// Undo the ESP32 critical section macros and the other definitions made
+// here, so they do not leak into the sketch
+#pragma push_macro("noInterrupts")
+#pragma push_macro("interrupts")
+
+#include "util/OneWire_direct_gpio.h"
+#ifdef ARDUINO_ARCH_ESP32
+#  define CRIT_TIMING IRAM_ATTR
+#else
+#  define CRIT_TIMING
+#endif
+#include "util/OneWire_direct_slots.h"
+#ifdef ARDUINO_ARCH_ESP32
+// the critical sections lock this bus, as in OneWire.cpp
+#  define onewire_mux (&mux)
+#endif
+
+template <uint8_t PIN>
+struct OneWirePin
+{
+    static volatile IO_REG_TYPE *base() { return PIN_TO_BASEREG(PIN); }
+    static IO_REG_TYPE mask() { return PIN_TO_BITMASK(PIN); }
+};
+
+#if defined(__AVR__)
+// Port 'P' ('A' to 'L') bit 'BIT'.  The switch folds away, leaving the
+// register address as a constant.
+template <char P, uint8_t BIT>
+struct OneWirePort
+{
+    static inline __attribute__((always_inline)) volatile uint8_t *base() {
+        switch (P) {
+#if defined(__AVR_ATmega4809__)
+        case 'A': return &PORTA.IN;
+        case 'B': return &PORTB.IN;
+        case 'C': return &PORTC.IN;
+        case 'D': return &PORTD.IN;
+        case 'E': return &PORTE.IN;
+        case 'F': return &PORTF.IN;
+#else
+#ifdef PINA
+        case 'A': return &PINA;
+#endif
+#ifdef PINB
+        case 'B': return &PINB;
+#endif
+#ifdef PINC
+        case 'C': return &PINC;
+#endif
+#ifdef PIND
+        case 'D': return &PIND;
+#endif
+#ifdef PINE
+        case 'E': return &PINE;
+#endif
+#ifdef PINF
+        case 'F': return &PINF;
+#endif
+#ifdef PING
+        case 'G': return &PING;
+#endif
+#ifdef PINH
+        case 'H': return &PINH;
+#endif
+#ifdef PINJ
+        case 'J': return &PINJ;
+#endif
+#ifdef PINK
+        case 'K': return &PINK;
+#endif
+#ifdef PINL
+        case 'L': return &PINL;
+#endif
+#endif
+        }
+        return 0;
+    }
+    static inline __attribute__((always_inline)) uint8_t mask() { return 1 << BIT; }
+};
+#endif
+
+template <class Pin>
+class OneWireFixed
+#if ONEWIRE_BACKEND
+    : public OneWireBackend
+#endif
+{
+  private:
+    uint8_t speed;
+    const OneWireTiming *timing;
+#ifdef ARDUINO_ARCH_ESP32
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+    static volatile IO_REG_TYPE *reg() { return (volatile IO_REG_TYPE *)Pin::base(); }
+
+  public:
+    OneWireFixed() : speed(ONEWIRE_STANDARD), timing(&OneWireTiming::standard) { }
+
+    // Make the pin an input, ready for the first reset()
+    void begin(void) { depower(); }
+
+    uint8_t CRIT_TIMING reset(void) {
+        return slot_reset(reg(), Pin::mask(), speed, timing ONEWIRE_MUX_ARG(onewire_mux));
+    }
+
+    void CRIT_TIMING write_bit(uint8_t v) {
+        slot_write(reg(), Pin::mask(), speed, timing, v ONEWIRE_MUX_ARG(onewire_mux));
+    }
+
+    uint8_t CRIT_TIMING read_bit(void) {
+        return slot_read(reg(), Pin::mask(), speed, timing ONEWIRE_MUX_ARG(onewire_mux));
+    }
+
+    void CRIT_TIMING write(uint8_t v, uint8_t power = 0) {
+        volatile IO_REG_TYPE *r = reg();
+        IO_REG_TYPE m = Pin::mask();
+        for (uint8_t bitMask = 0x01; bitMask; bitMask <<= 1) {
+            slot_write(r, m, speed, timing, v & bitMask ONEWIRE_MUX_ARG(onewire_mux));
+        }
+        if (!power) depower();
+    }
+
+    uint8_t CRIT_TIMING read(void) {
+        volatile IO_REG_TYPE *r = reg();
+        IO_REG_TYPE m = Pin::mask();
+        uint8_t v = 0;
+        for (uint8_t bitMask = 0x01; bitMask; bitMask <<= 1) {
+            if (slot_read(r, m, speed, timing ONEWIRE_MUX_ARG(onewire_mux))) v |= bitMask;
+        }
+        return v;
+    }
+
+    void CRIT_TIMING write_bytes(const uint8_t *buf, uint16_t count, bool power = false) {
+        volatile IO_REG_TYPE *r = reg();
+        IO_REG_TYPE m = Pin::mask();
+        for (uint16_t i = 0; i < count; i++) {
+            for (uint8_t bitMask = 0x01; bitMask; bitMask <<= 1) {
+                slot_write(r, m, speed, timing, buf[i] & bitMask ONEWIRE_MUX_ARG(onewire_mux));
+            }
+        }
+        if (!power) depower();
+    }
+
+    void CRIT_TIMING read_bytes(uint8_t *buf, uint16_t count) {
+        volatile IO_REG_TYPE *r = reg();
+        IO_REG_TYPE m = Pin::mask();
+        for (uint16_t i = 0; i < count; i++) {
+            uint8_t v = 0;
+            for (uint8_t bitMask = 0x01; bitMask; bitMask <<= 1) {
+                if (slot_read(r, m, speed, timing ONEWIRE_MUX_ARG(onewire_mux))) v |= bitMask;
+            }
+            buf[i] = v;
+        }
+    }
+
+    // Match ROM, and Skip ROM
+    void select(const uint8_t rom[8]) {
+        write(0x55);
+        write_bytes(rom, 8);
+    }
+    void skip(void) { write(0xCC); }
+
+    void depower(void) {
+        __attribute__((unused)) volatile IO_REG_TYPE *r = reg();
+        __attribute__((unused)) IO_REG_TYPE m = Pin::mask();
+        noInterrupts();
+        DIRECT_MODE_INPUT(r, m);
+        DIRECT_WRITE_LOW(r, m);
+        interrupts();
+    }
+
+    bool set_speed(uint8_t s) {
+        speed = s;
+        return true;
+    }
+
+    bool set_timing(const OneWireTiming *t) {
+        timing = t;
+        return true;
+    }
+};
+
+#undef CRIT_TIMING
+#undef onewire_mux
+#undef ONEWIRE_MUX_PARAM
+#undef ONEWIRE_MUX_ARG
+#undef OneWire_Direct_GPIO_h
+#undef PIN_TO_BASEREG
+#undef PIN_TO_BITMASK
+#undef IO_REG_TYPE
+#undef IO_REG_BASE_ATTR
+#undef IO_REG_MASK_ATTR
+#undef DIRECT_READ
+#undef DIRECT_READ_PORT
+#undef DIRECT_MODE_INPUT
+#undef DIRECT_MODE_OUTPUT
+#undef DIRECT_WRITE_LOW
+#undef DIRECT_WRITE_HIGH
+#pragma pop_macro("interrupts")
+#pragma pop_macro("noInterrupts")
+
+#endif
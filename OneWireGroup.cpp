@@ -0,0 +1,248 @@
+// Lock-step I/O on several 1-Wire buses, see OneWireGroup in OneWire.h
+//
+// The slot timing is the same as OneWire.cpp, from the OneWireTiming set
+// on the group.  Every bus gets the same falling edge, and for writes,
+// buses sending a 1 are released after write1_low while buses sending a
+// 0 are held low for write0_low.
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include "OneWire.h"
+#include "util/OneWire_direct_gpio.h"
+
+#ifdef DIRECT_READ_PORT
+
+bool OneWireGroup::begin(const uint8_t *pins, uint8_t num)
+{
+	count = 0;
+	bitmask = 0;
+	if (num == 0 || num > ONEWIRE_GROUP_MAX) return false;
+	baseReg = PIN_TO_BASEREG(pins[0]);
+	for (uint8_t i = 0; i < num; i++) {
+		if (PIN_TO_BASEREG(pins[i]) != baseReg) return false;
+		pinMode(pins[i], INPUT);
+		pinmask[i] = PIN_TO_BITMASK(pins[i]);
+		bitmask |= pinmask[i];
+	}
+	count = num;
+	return true;
+}
+
+// Split one read of the port into a bit per bus
+static inline uint8_t split(IO_REG_TYPE port, const IO_REG_TYPE *pinmask, uint8_t count)
+{
+	uint8_t r = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		if (port & pinmask[i]) r |= 1 << i;
+	}
+	return r;
+}
+
+uint8_t OneWireGroup::reset(void)
+{
+	IO_REG_TYPE mask = bitmask;
+	volatile IO_REG_TYPE *reg IO_REG_BASE_ATTR = baseReg;
+	const OneWireTiming *t = timing;
+	IO_REG_TYPE port;
+	uint8_t retries = 125;
+
+	if (!count) return 0;
+	noInterrupts();
+	DIRECT_MODE_INPUT(reg, mask);
+	interrupts();
+	// wait until every wire is high... just in case.  A wire still low
+	// after that is shorted or stuck, and the reset goes on without it.
+	while ((port = DIRECT_READ_PORT(reg) & mask) != mask && --retries) {
+		delayMicroseconds(2);
+	}
+	mask = port;
+	if (!mask) return 0;
+
+	noInterrupts();
+	DIRECT_WRITE_LOW(reg, mask);
+	DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+	interrupts();
+	delayMicroseconds(t->reset_low);
+	noInterrupts();
+	DIRECT_MODE_INPUT(reg, mask);	// allow it to float
+	delayMicroseconds(t->reset_sample);
+	port = ~DIRECT_READ_PORT(reg) & mask;
+	interrupts();
+	if (port && t->fast_reset) {
+		// wait for the end of the last presence pulse
+		uint16_t left = t->reset_high;
+		while ((DIRECT_READ_PORT(reg) & mask) != mask && left > 2) {
+			delayMicroseconds(2);
+			left -= 2;
+		}
+		delayMicroseconds(t->reset_recovery);
+	} else {
+		delayMicroseconds(t->reset_high);
+	}
+	return split(port, pinmask, count);
+}
+
+void OneWireGroup::write_bits(uint8_t v)
+{
+	IO_REG_TYPE mask = bitmask;
+	volatile IO_REG_TYPE *reg IO_REG_BASE_ATTR = baseReg;
+	const OneWireTiming *t = timing;
+	IO_REG_TYPE ones = 0;
+	uint8_t tail = t->write0_high;
+
+	for (uint8_t i = 0; i < count; i++) {
+		if (v & (1 << i)) ones |= pinmask[i];
+	}
+	// the slot ends when both a 1 and a 0 have had their whole length
+	if (t->write1_low + t->write1_high > t->write0_low + tail) {
+		tail = t->write1_low + t->write1_high - t->write0_low;
+	}
+	noInterrupts();
+	DIRECT_WRITE_LOW(reg, mask);
+	DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+	delayMicroseconds(t->write1_low);
+	if (ones) DIRECT_WRITE_HIGH(reg, ones);	// release the 1 buses
+	delayMicroseconds(t->write0_low - t->write1_low);
+	DIRECT_WRITE_HIGH(reg, mask);	// and then the 0 buses
+	interrupts();
+	delayMicroseconds(tail);
+}
+
+uint8_t OneWireGroup::read_bits(void)
+{
+	IO_REG_TYPE mask = bitmask;
+	volatile IO_REG_TYPE *reg IO_REG_BASE_ATTR = baseReg;
+	const OneWireTiming *t = timing;
+	IO_REG_TYPE port;
+
+	noInterrupts();
+	DIRECT_MODE_OUTPUT(reg, mask);
+	DIRECT_WRITE_LOW(reg, mask);
+	delayMicroseconds(t->read_low);
+	DIRECT_MODE_INPUT(reg, mask);	// let pins float, pull up will raise
+	delayMicroseconds(t->read_sample);
+	port = DIRECT_READ_PORT(reg);
+	interrupts();
+	delayMicroseconds(t->read_high);
+	return split(port, pinmask, count);
+}
+
+void OneWireGroup::depower(void)
+{
+	noInterrupts();
+	DIRECT_MODE_INPUT(baseReg, bitmask);
+	interrupts();
+}
+
+#elif ONEWIRE_HOST
+
+// No pins, so begin() takes the buses as OneWireBackends, and each slot
+// is done on one after another.  The slots, and the bits and bytes built
+// on them, are the same as on a port.
+
+bool OneWireGroup::begin(const uint8_t *pins, uint8_t num)
+{
+	(void)pins;
+	(void)num;
+	count = 0;
+	return false;
+}
+
+bool OneWireGroup::begin(OneWireBackend *const *buses, uint8_t num)
+{
+	count = 0;
+	if (num == 0 || num > ONEWIRE_GROUP_MAX) return false;
+	for (uint8_t i = 0; i < num; i++) bus[i] = buses[i];
+	count = num;
+	return true;
+}
+
+uint8_t OneWireGroup::reset(void)
+{
+	uint8_t r = 0;
+
+	for (uint8_t i = 0; i < count; i++) {
+		if (bus[i]->reset()) r |= 1 << i;
+	}
+	return r;
+}
+
+void OneWireGroup::write_bits(uint8_t v)
+{
+	for (uint8_t i = 0; i < count; i++) bus[i]->write_bit((v >> i) & 1);
+}
+
+uint8_t OneWireGroup::read_bits(void)
+{
+	uint8_t r = 0;
+
+	for (uint8_t i = 0; i < count; i++) {
+		if (bus[i]->read_bit()) r |= 1 << i;
+	}
+	return r;
+}
+
+void OneWireGroup::depower(void)
+{
+	for (uint8_t i = 0; i < count; i++) bus[i]->depower();
+}
+
+#else
+
+// This board has no register which reads a whole port, so each bus needs
+// its own OneWire instance.
+
+bool OneWireGroup::begin(const uint8_t *pins, uint8_t num)
+{
+	(void)pins;
+	(void)num;
+	count = 0;
+	return false;
+}
+
+uint8_t OneWireGroup::reset(void) { return 0; }
+void OneWireGroup::write_bits(uint8_t v) { (void)v; }
+uint8_t OneWireGroup::read_bits(void) { return 0; }
+void OneWireGroup::depower(void) { }
+
+#endif
+
+// The bytes, on any of the above
+
+void OneWireGroup::write(uint8_t v, uint8_t power)
+{
+	uint8_t all = (1 << count) - 1;
+
+	for (uint8_t bit = 0x01; bit; bit <<= 1) {
+		write_bits((v & bit) ? all : 0);
+	}
+	if (!power) depower();
+}
+
+void OneWireGroup::write_bytes(const uint8_t *const *bufs, uint16_t len, bool power)
+{
+	for (uint16_t n = 0; n < len; n++) {
+		for (uint8_t bit = 0x01; bit; bit <<= 1) {
+			uint8_t v = 0;
+			for (uint8_t i = 0; i < count; i++) {
+				if (bufs[i][n] & bit) v |= 1 << i;
+			}
+			write_bits(v);
+		}
+	}
+	if (!power) depower();
+}
+
+void OneWireGroup::read_bytes(uint8_t *const *bufs, uint16_t len)
+{
+	for (uint16_t n = 0; n < len; n++) {
+		for (uint8_t i = 0; i < count; i++) bufs[i][n] = 0;
+		for (uint8_t bit = 0x01; bit; bit <<= 1) {
+			uint8_t v = read_bits();
+			for (uint8_t i = 0; i < count; i++) {
+				if (v & (1 << i)) bufs[i][n] |= bit;
+			}
+		}
+	}
+}
@@ -0,0 +1,379 @@
+// OWFS owserver client, see OneWireOwserver.h
+//
+// Each message starts with six big endian 32 bit words.  A request has
+// version, payload length, type, control flags, size and offset, then the
+// payload: a 0 terminated path, followed by the data for a write.  The
+// reply has version, payload length, return value (negative errno on
+// failure), control flags, size and offset, then the data.  While a slow
+// request runs, owserver may send "ping" replies with a payload length of
+// -1, which only mean it is still working.
+
+#include "OneWireOwserver.h"
+
+#if ONEWIRE_HOST
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+// milliseconds to wait for owserver, pings restart the wait
+#define OWSERVER_TIMEOUT   5000
+
+// largest DIRALL answer search() accepts
+#define OWSERVER_DIR_MAX   65535
+
+static void put32(uint8_t *p, int32_t v)
+{
+	p[0] = (uint32_t)v >> 24;
+	p[1] = (uint32_t)v >> 16;
+	p[2] = (uint32_t)v >> 8;
+	p[3] = (uint32_t)v;
+}
+
+static int32_t get32(const uint8_t *p)
+{
+	return (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+		((uint32_t)p[2] << 8) | p[3]);
+}
+
+OneWireOwserver::OneWireOwserver()
+{
+	fd = -1;
+	host[0] = 0;
+	port = OWSERVER_PORT;
+	queued = 0;
+	requests = 0;
+	round_trips = 0;
+	connects = 0;
+}
+
+OneWireOwserver::~OneWireOwserver()
+{
+	end();
+}
+
+bool OneWireOwserver::begin(const char *name, uint16_t p)
+{
+	end();
+	strncpy(host, name, sizeof(host) - 1);
+	host[sizeof(host) - 1] = 0;
+	port = p;
+	return connect_server();
+}
+
+void OneWireOwserver::end(void)
+{
+	disconnect();
+	queued = 0;
+}
+
+void OneWireOwserver::disconnect(void)
+{
+	if (fd >= 0) close(fd);
+	fd = -1;
+}
+
+bool OneWireOwserver::connect_server(void)
+{
+	struct addrinfo hints, *res, *ai;
+	char service[8];
+	int one = 1;
+
+	disconnect();
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(service, sizeof(service), "%u", port);
+	if (getaddrinfo(host, service, &hints, &res) != 0) return false;
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0) continue;
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0) return false;
+	// the requests of a batch go out in one write, don't hold the last
+	// part back waiting for an ack
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	connects++;
+	return true;
+}
+
+bool OneWireOwserver::read_all(uint8_t *buf, size_t len)
+{
+	while (len) {
+		struct pollfd p = { fd, POLLIN, 0 };
+		if (poll(&p, 1, OWSERVER_TIMEOUT) <= 0) return false;
+		ssize_t n = ::read(fd, buf, len);
+		if (n <= 0) return false;
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+// Send queue[first] onwards in a single write
+bool OneWireOwserver::send_queue(uint8_t first)
+{
+	size_t total = 0, pos = 0;
+	uint8_t i;
+
+	for (i = first; i < queued; i++) {
+		total += OWSERVER_HEADER + strlen(queue[i].path) + 1;
+		if (queue[i].type == OWSERVER_WRITE) total += queue[i].size;
+	}
+	uint8_t *out = (uint8_t *)malloc(total);
+	if (!out) return false;
+	for (i = first; i < queued; i++) {
+		const Request &r = queue[i];
+		size_t pathlen = strlen(r.path) + 1;
+		size_t payload = pathlen + (r.type == OWSERVER_WRITE ? r.size : 0);
+		put32(out + pos, 0);
+		put32(out + pos + 4, payload);
+		put32(out + pos + 8, r.type);
+		put32(out + pos + 12, OWSERVER_PERSISTENCE | OWSERVER_FORMAT_FDI);
+		put32(out + pos + 16, r.size);
+		put32(out + pos + 20, r.offset);
+		pos += OWSERVER_HEADER;
+		memcpy(out + pos, r.path, pathlen);
+		pos += pathlen;
+		if (r.type == OWSERVER_WRITE) {
+			memcpy(out + pos, r.tx, r.size);
+			pos += r.size;
+		}
+	}
+	for (pos = 0; pos < total; ) {
+		ssize_t n = ::write(fd, out + pos, total - pos);
+		if (n <= 0) break;
+		pos += n;
+	}
+	free(out);
+	requests += queued - first;
+	return pos == total;
+}
+
+// Read the answer to 'r'.  Returns false if the connection failed.
+bool OneWireOwserver::receive(const Request &r, int *result, bool *persistent)
+{
+	uint8_t header[OWSERVER_HEADER], discard[64];
+	int32_t payload, ret, size;
+
+	do {
+		if (!read_all(header, OWSERVER_HEADER)) return false;
+		payload = get32(header + 4);
+	} while (payload < 0);
+	ret = get32(header + 8);
+	*persistent = (get32(header + 12) & OWSERVER_PERSISTENCE) != 0;
+	size = get32(header + 16);
+
+	// data beyond the buffer is read and dropped
+	int32_t keep = (r.rx && payload > 0) ? payload : 0;
+	if (keep > r.size) keep = r.size;
+	if (keep && !read_all(r.rx, keep)) return false;
+	for (int32_t left = payload - keep; left > 0; ) {
+		int32_t n = left < (int32_t)sizeof(discard) ? left : (int32_t)sizeof(discard);
+		if (!read_all(discard, n)) return false;
+		left -= n;
+	}
+	if (ret < 0) {
+		*result = -1;
+	} else if (r.type == OWSERVER_WRITE) {
+		*result = r.size;
+	} else if (r.type == OWSERVER_DIRALL) {
+		*result = keep;
+	} else {
+		*result = (size < keep) ? size : keep;
+	}
+	return true;
+}
+
+uint8_t OneWireOwserver::run(void)
+{
+	uint8_t done = 0, ok = 0;
+	int result;
+	bool persistent = true;
+
+	while (done < queued) {
+		uint8_t before = done;
+		if (fd < 0 && !connect_server()) break;
+		if (!send_queue(done)) {
+			disconnect();
+			if (!connect_server() || !send_queue(done)) break;
+		}
+		round_trips++;
+		while (done < queued) {
+			if (!receive(queue[done], &result, &persistent)) {
+				disconnect();
+				break;
+			}
+			if (queue[done].result) *queue[done].result = result;
+			if (result >= 0) ok++;
+			done++;
+			if (!persistent) {
+				// the server closes after each answer, send the rest
+				// again on a new connection
+				disconnect();
+				break;
+			}
+		}
+		if (done == before) break;
+	}
+	for (; done < queued; done++) {
+		if (queue[done].result) *queue[done].result = -1;
+	}
+	queued = 0;
+	return ok;
+}
+
+bool OneWireOwserver::queue_read(const char *path, uint8_t *buf, uint16_t size,
+	int *result, uint32_t offset)
+{
+	if (queued >= OWSERVER_QUEUE) return false;
+	Request &r = queue[queued++];
+	r.type = OWSERVER_READ;
+	r.path = path;
+	r.rx = buf;
+	r.tx = NULL;
+	r.size = size;
+	r.offset = offset;
+	r.result = result;
+	return true;
+}
+
+bool OneWireOwserver::queue_write(const char *path, const uint8_t *data, uint16_t size,
+	int *result, uint32_t offset)
+{
+	if (queued >= OWSERVER_QUEUE) return false;
+	Request &r = queue[queued++];
+	r.type = OWSERVER_WRITE;
+	r.path = path;
+	r.rx = NULL;
+	r.tx = data;
+	r.size = size;
+	r.offset = offset;
+	r.result = result;
+	return true;
+}
+
+int OneWireOwserver::read(const char *path, uint8_t *buf, uint16_t size, uint32_t offset)
+{
+	int result = -1;
+
+	run();
+	queue_read(path, buf, size, &result, offset);
+	run();
+	return result;
+}
+
+bool OneWireOwserver::write(const char *path, const uint8_t *data, uint16_t size, uint32_t offset)
+{
+	int result = -1;
+
+	run();
+	queue_write(path, data, size, &result, offset);
+	run();
+	return result >= 0;
+}
+
+int OneWireOwserver::read_property(const uint8_t *rom, const char *property,
+	char *buf, uint16_t size)
+{
+	char path[96];
+
+	if (size == 0) return -1;
+	device_path(path, sizeof(path), rom, property);
+	int n = read(path, (uint8_t *)buf, size - 1);
+	buf[n > 0 ? n : 0] = 0;
+	return n;
+}
+
+void OneWireOwserver::device_path(char *path, size_t len, const uint8_t *rom,
+	const char *property)
+{
+	snprintf(path, len, "/%02X.%02X%02X%02X%02X%02X%02X%s%s", rom[0],
+		rom[1], rom[2], rom[3], rom[4], rom[5], rom[6],
+		property ? "/" : "", property ? property : "");
+}
+
+static int hexdigit(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+// "FF.IIIIIIIIIIII", optionally followed by a CRC (".CC") which is checked
+bool OneWireOwserver::parse_device(const char *name, uint8_t *rom)
+{
+	static const uint8_t pos[14] = { 0, 1, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14 };
+	uint8_t i;
+
+	if (strlen(name) < 15 || name[2] != '.') return false;
+	for (i = 0; i < 14; i++) {
+		int d = hexdigit(name[pos[i]]);
+		if (d < 0) return false;
+		if (i & 1) rom[i >> 1] |= d;
+		else rom[i >> 1] = d << 4;
+	}
+#if ONEWIRE_CRC
+	rom[7] = OneWire::crc8(rom, 7);
+#else
+	// taken from the name if it has one, the server only needs 0 to 6
+	rom[7] = 0;
+#endif
+	if (name[15] == '.') {
+		int hi = hexdigit(name[16]), lo = hexdigit(name[17]);
+		if (hi < 0 || lo < 0) return false;
+#if ONEWIRE_CRC
+		if (((hi << 4) | lo) != rom[7]) return false;
+#else
+		rom[7] = (hi << 4) | lo;
+#endif
+	} else if (name[15] != 0) {
+		return false;
+	}
+	return true;
+}
+
+uint8_t OneWireOwserver::search(uint8_t roms[][8], uint8_t max, const char *path)
+{
+	uint8_t count = 0;
+	int len = -1;
+	char *list = (char *)malloc(OWSERVER_DIR_MAX + 1);
+
+	if (!list) return 0;
+	run();
+	Request &r = queue[queued++];
+	r.type = OWSERVER_DIRALL;
+	r.path = path;
+	r.rx = (uint8_t *)list;
+	r.tx = NULL;
+	r.size = OWSERVER_DIR_MAX;
+	r.offset = 0;
+	r.result = &len;
+	run();
+
+	// a comma separated list of paths, the devices among the buses,
+	// "settings", "uncached" and the like
+	if (len > 0) {
+		list[len] = 0;
+		for (char *entry = strtok(list, ","); entry && count < max; entry = strtok(NULL, ",")) {
+			char *name = strrchr(entry, '/');
+			name = name ? name + 1 : entry;
+			if (parse_device(name, roms[count])) count++;
+		}
+	}
+	free(list);
+	return count;
+}
+
+#endif // ONEWIRE_HOST
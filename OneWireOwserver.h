@@ -0,0 +1,122 @@
+#ifndef OneWireOwserver_h
+#define OneWireOwserver_h
+
+#include "OneWire.h"
+
+#if ONEWIRE_HOST
+
+// Client for OWFS owserver, for buses which an owserver already owns.
+//
+//    OneWireOwserver ow;
+//    if (!ow.begin("127.0.0.1")) ...
+//    count = ow.search(roms, 16);
+//    ow.read_property(roms[0], "temperature", text, sizeof(text));
+//
+// owserver does the 1-Wire transactions itself and only offers devices
+// and their properties (files in the OWFS tree), not resets, slots or
+// bytes, so this is not a OneWireBackend.  search() lists the devices
+// with a DIRALL request, and reads and writes go to property paths such
+// as "/28.0A0B0C000000/temperature" or the raw "memory" of a device.
+//
+// Requests may be queued and sent together.  run() writes every queued
+// request in one go on a persistent connection, then collects the
+// answers, so N reads cost one round trip rather than N.  If the server
+// won't keep the connection open, the rest are sent again on a new one.
+
+#include <stddef.h>
+
+#define OWSERVER_PORT         4304
+
+// message types
+#define OWSERVER_ERROR        0
+#define OWSERVER_NOP          1
+#define OWSERVER_READ         2
+#define OWSERVER_WRITE        3
+#define OWSERVER_DIR          4
+#define OWSERVER_SIZE         5
+#define OWSERVER_PRESENCE     6
+#define OWSERVER_DIRALL       7
+#define OWSERVER_GET          8
+
+// control flags
+#define OWSERVER_PERSISTENCE  0x00000004
+#define OWSERVER_ALIAS        0x00000008
+#define OWSERVER_FORMAT_FDI   0x00000000   // device names as 28.0A0B0C000000
+
+#define OWSERVER_HEADER       24
+#define OWSERVER_QUEUE        32           // requests run() can send at once
+
+class OneWireOwserver
+{
+  public:
+    OneWireOwserver();
+    ~OneWireOwserver();
+
+    // Connect to owserver at 'host' (a name or address).  Returns false
+    // if the connection fails.
+    bool begin(const char *host, uint16_t port = OWSERVER_PORT);
+    void end(void);
+
+    // The ROMs of the devices in 'path' ("/" or a bus such as "/bus.0"),
+    // up to 'max'.  Returns the number found.
+    uint8_t search(uint8_t roms[][8], uint8_t max, const char *path = "/");
+
+    // Read or write one path now, one round trip.  read() returns the
+    // number of bytes read, or -1.
+    int read(const char *path, uint8_t *buf, uint16_t size, uint32_t offset = 0);
+    bool write(const char *path, const uint8_t *data, uint16_t size, uint32_t offset = 0);
+
+    // read() of "/<rom>/<property>", text properties are 0 terminated
+    int read_property(const uint8_t *rom, const char *property, char *buf, uint16_t size);
+
+    // Queue a request for run().  'result' gets the bytes read or written,
+    // or -1, and 'path' and the buffers must stay valid until run().
+    // Returns false if the queue is full.
+    bool queue_read(const char *path, uint8_t *buf, uint16_t size, int *result,
+                    uint32_t offset = 0);
+    bool queue_write(const char *path, const uint8_t *data, uint16_t size,
+                     int *result, uint32_t offset = 0);
+
+    // Send the queued requests and wait for all the answers.  Returns the
+    // number which succeeded.
+    uint8_t run(void);
+
+    // "/28.0A0B0C000000" followed by "/property" if not NULL
+    static void device_path(char *path, size_t len, const uint8_t *rom,
+                            const char *property = NULL);
+
+    // Parse a device name such as "28.0A0B0C000000", filling in the CRC
+    // (without ONEWIRE_CRC, from a ".CC" suffix, or 0)
+    static bool parse_device(const char *name, uint8_t *rom);
+
+    // Requests sent, round trips and connections made, for profiling
+    uint32_t requests;
+    uint32_t round_trips;
+    uint32_t connects;
+
+  private:
+    struct Request {
+        uint8_t type;
+        const char *path;
+        uint8_t *rx;
+        const uint8_t *tx;
+        uint16_t size;
+        uint32_t offset;
+        int *result;
+    };
+
+    bool connect_server(void);
+    bool send_queue(uint8_t first);
+    bool receive(const Request &r, int *result, bool *persistent);
+    bool read_all(uint8_t *buf, size_t len);
+    void disconnect(void);
+
+    int fd;
+    char host[64];
+    uint16_t port;
+    Request queue[OWSERVER_QUEUE];
+    uint8_t queued;
+};
+
+#endif // ONEWIRE_HOST
+#endif
@@ -0,0 +1,121 @@
+// Playback of a OneWireTrace recording, see OneWireReplay.h
+
+#include "OneWireReplay.h"
+
+#if ONEWIRE_BACKEND
+
+OneWireReplay::OneWireReplay(const OneWireTraceEntry *e, uint32_t n)
+{
+	entries = e;
+	count = n;
+	rewind();
+}
+
+void OneWireReplay::rewind(void)
+{
+	pos = 0;
+	bit = 0;
+	mismatches = 0;
+	skipped = 0;
+	overruns = 0;
+}
+
+const OneWireTraceEntry * OneWireReplay::peek(void) const
+{
+	return (pos < count) ? &entries[pos] : NULL;
+}
+
+void OneWireReplay::seek(uint32_t p)
+{
+	pos = (p < count) ? p : count;
+	bit = 0;
+}
+
+uint8_t OneWireReplay::reset(void)
+{
+	if (bit) {
+		bit = 0;
+		pos++;
+		skipped++;
+	}
+	while (pos < count && entries[pos].op != ONEWIRE_TRACE_RESET) {
+		pos++;
+		skipped++;
+	}
+	if (pos >= count) {
+		overruns++;
+		return 0;
+	}
+	return entries[pos++].value;
+}
+
+// The next recorded bit, from a bit entry of type 'bitop' or a byte of
+// type 'byteop'.  Anything else is a mismatch, and is used up unless it
+// is a reset, which is left for reset() to find.
+bool OneWireReplay::take_bit(uint8_t bitop, uint8_t byteop, uint8_t *v)
+{
+	if (pos >= count) {
+		overruns++;
+		return false;
+	}
+	const OneWireTraceEntry &e = entries[pos];
+	if (e.op == bitop) {
+		*v = e.value & 1;
+		pos++;
+		return true;
+	}
+	if (e.op == byteop) {
+		*v = (e.value >> bit) & 1;
+		if (++bit == 8) {
+			bit = 0;
+			pos++;
+		}
+		return true;
+	}
+	mismatches++;
+	if (e.op != ONEWIRE_TRACE_RESET) {
+		bit = 0;
+		pos++;
+	}
+	return false;
+}
+
+void OneWireReplay::write_bit(uint8_t v)
+{
+	uint8_t recorded;
+
+	if (take_bit(ONEWIRE_TRACE_WRITE_BIT, ONEWIRE_TRACE_WRITE_BYTE, &recorded) &&
+	    recorded != (v & 1)) {
+		mismatches++;
+	}
+}
+
+uint8_t OneWireReplay::read_bit(void)
+{
+	uint8_t v;
+
+	// an idle bus reads 1
+	if (!take_bit(ONEWIRE_TRACE_READ_BIT, ONEWIRE_TRACE_READ_BYTE, &v)) return 1;
+	return v;
+}
+
+void OneWireReplay::write(uint8_t v, uint8_t power)
+{
+	(void)power;
+	if (!bit && pos < count && entries[pos].op == ONEWIRE_TRACE_WRITE_BYTE) {
+		if (entries[pos].value != v) mismatches++;
+		pos++;
+		return;
+	}
+	OneWireBackend::write(v, 1);
+}
+
+uint8_t OneWireReplay::read(void)
+{
+	if (!bit && pos < count && entries[pos].op == ONEWIRE_TRACE_READ_BYTE) {
+		return entries[pos++].value;
+	}
+	return OneWireBackend::read();
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef OneWireReplay_h
+#define OneWireReplay_h
+
+#include "OneWire.h"
+#include "OneWireTrace.h"
+
+#if ONEWIRE_BACKEND
+
+// A bus master which plays back a recording made by OneWireTrace, so the
+// driver code can be run again on what a bus in the field did:
+//
+//    OneWireReplay replay(entries, count);
+//    OneWire ds(replay);
+//    while (ds.search(rom)) ...
+//
+// Reads return the recorded values.  Writes are compared with the
+// recording, and mismatches counts those which differ, so a change in
+// the driver which would have behaved differently on that bus shows up.
+// Bits and bytes may be mixed: a recorded byte can be read back as 8
+// bits, or 8 recorded bits as a byte.  reset() skips ahead to the next
+// recorded reset, counting what it passed over in skipped.
+
+class OneWireReplay : public OneWireBackend
+{
+  public:
+    OneWireReplay(const OneWireTraceEntry *entries, uint32_t count);
+
+    // Start again from the first entry, and clear the counters
+    void rewind(void);
+
+    // The next entry, NULL at the end.  tell() and seek() get and set
+    // the position, for reading a part of the recording twice.
+    const OneWireTraceEntry *peek(void) const;
+    uint32_t tell(void) const { return pos; }
+    void seek(uint32_t p);
+    bool done(void) const { return pos >= count; }
+
+    uint8_t reset(void);
+    void write_bit(uint8_t v);
+    uint8_t read_bit(void);
+    void write(uint8_t v, uint8_t power);
+    uint8_t read(void);
+    bool set_speed(uint8_t speed) { (void)speed; return true; }
+    bool set_timing(const OneWireTiming *t) { (void)t; return true; }
+
+    // Writes which differ from the recording, or found a read recorded;
+    // entries skipped by reset(); reads and writes past the end
+    uint32_t mismatches;
+    uint32_t skipped;
+    uint32_t overruns;
+
+  private:
+    bool take_bit(uint8_t bitop, uint8_t byteop, uint8_t *v);
+
+    const OneWireTraceEntry *entries;
+    uint32_t count;
+    uint32_t pos;
+    uint8_t bit;          // bits of entries[pos] already used, if a byte
+};
+
+#endif
+#endif
@@ -0,0 +1,1434 @@
+// Simulated 1-Wire bus and devices, for host builds.  See OneWireSim.h
+
+#include "OneWireSim.h"
+#include "OneWireTemperature.h"
+
+#if ONEWIRE_HOST
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Bus time of each primitive at overdrive, the same delays OneWire.cpp
+// uses.  Standard speed slots take the lengths in the OneWireTiming.
+#define SIM_OD_RESET_USEC   118
+#define SIM_OD_WRITE1_USEC  9
+#define SIM_OD_WRITE0_USEC  10
+#define SIM_OD_READ_USEC    10
+
+// The devices end their presence pulse this long after the master
+// releases the bus (15 to 60us high, then 60 to 240us low)
+#define SIM_PRESENCE_END_USEC  135
+
+// The devices sample a write slot this long after the falling edge (15
+// to 60us, the earliest is used)
+#define SIM_WRITE_SAMPLE_USEC  15
+
+static uint8_t crc8_update(uint8_t crc, uint8_t inbyte)
+{
+	for (uint8_t i = 8; i; i--) {
+		uint8_t mix = (crc ^ inbyte) & 0x01;
+		crc >>= 1;
+		if (mix) crc ^= 0x8C;
+		inbyte >>= 1;
+	}
+	return crc;
+}
+
+// The devices' own CRCs, whatever ONEWIRE_CRC and ONEWIRE_CRC16 are
+static uint8_t sim_crc8(const uint8_t *buf, uint8_t len)
+{
+	uint8_t crc = 0;
+
+	while (len--) crc = crc8_update(crc, *buf++);
+	return crc;
+}
+
+static uint16_t crc16_update(uint16_t crc, uint8_t inbyte)
+{
+	crc ^= inbyte;
+	for (uint8_t i = 8; i; i--) {
+		if (crc & 1) crc = (crc >> 1) ^ 0xA001;
+		else crc >>= 1;
+	}
+	return crc;
+}
+
+
+OneWireSimDevice::OneWireSimDevice(uint8_t family, uint64_t serial)
+{
+	rom[0] = family;
+	for (uint8_t i = 1; i < 7; i++) {
+		rom[i] = serial & 0xFF;
+		serial >>= 8;
+	}
+	rom[7] = sim_crc8(rom, 7);
+	overdrive_capable = false;
+	resume_capable = false;
+	bus = NULL;
+	state = IDLE;
+	overdrive = false;
+	resume = false;
+	rx = rx_bits = 0;
+	tx = tx_bits = 0;
+	rom_bit = 0;
+	search_step = 0;
+	next = NULL;
+}
+
+uint8_t OneWireSimDevice::rom_bit_value(void) const
+{
+	return (rom[rom_bit >> 3] >> (rom_bit & 7)) & 1;
+}
+
+void OneWireSimDevice::reset_pulse(void)
+{
+	state = ROM_COMMAND;
+	rx = rx_bits = 0;
+	tx_bits = 0;
+	reset();
+}
+
+void OneWireSimDevice::slot_write(uint8_t v)
+{
+	v &= 1;
+	switch (state) {
+	case ROM_COMMAND:
+		rx |= v << rx_bits;
+		if (++rx_bits < 8) break;
+		rom_bit = 0;
+		search_step = 0;
+		// every ROM command but Resume clears the RC flag, Match and
+		// Search ROM set it again in the device they end on
+		if (rx != 0xA5) resume = false;
+		switch (rx) {
+		case 0xA5: state = resume ? FUNCTION : IDLE; break;
+		case 0x33: state = READ_ROM; break;
+		case 0x55: state = MATCH_ROM; break;
+		case 0xCC: state = FUNCTION; break;
+		case 0xF0: state = SEARCH_ROM; break;
+		case 0xEC: state = alarm() ? SEARCH_ROM : IDLE; break;
+		case 0x3C: // Overdrive Skip ROM
+			overdrive = overdrive_capable;
+			state = overdrive ? FUNCTION : IDLE;
+			break;
+		case 0x69: // Overdrive Match ROM, the ROM follows at overdrive
+			overdrive = overdrive_capable;
+			state = overdrive ? MATCH_ROM : IDLE;
+			break;
+		default:   state = IDLE; break;
+		}
+		rx = rx_bits = 0;
+		break;
+	case MATCH_ROM:
+		if (v != rom_bit_value()) {
+			state = IDLE;
+		} else if (++rom_bit == 64) {
+			state = FUNCTION;
+			resume = resume_capable;
+		}
+		break;
+	case SEARCH_ROM:
+		if (search_step != 2 || v != rom_bit_value()) {
+			state = IDLE;
+		} else {
+			search_step = 0;
+			if (++rom_bit == 64) {
+				state = FUNCTION;
+				resume = resume_capable;
+			}
+		}
+		break;
+	case FUNCTION:
+		tx_bits = 0;
+		rx |= v << rx_bits;
+		if (++rx_bits == 8) {
+			uint8_t b = rx;
+			rx = rx_bits = 0;
+			write_byte(b);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+uint8_t OneWireSimDevice::slot_read(void)
+{
+	uint8_t r;
+
+	switch (state) {
+	case READ_ROM:
+		r = rom_bit_value();
+		if (++rom_bit == 64) state = FUNCTION;
+		return r;
+	case SEARCH_ROM:
+		if (search_step == 0) {
+			search_step = 1;
+			return rom_bit_value();
+		} else if (search_step == 1) {
+			search_step = 2;
+			return !rom_bit_value();
+		}
+		state = IDLE;
+		return 1;
+	case FUNCTION:
+		return read_function_bit();
+	default:
+		return 1;
+	}
+}
+
+// A 1 from a byte-level adapter: a read slot if this device is sending,
+// otherwise a written 1
+uint8_t OneWireSimDevice::slot_one(void)
+{
+	switch (state) {
+	case READ_ROM:
+		return slot_read();
+	case SEARCH_ROM:
+		if (search_step < 2) return slot_read();
+		break;
+	case FUNCTION:
+		if (tx_bits || (rx_bits == 0 && !receiving())) return slot_read();
+		break;
+	default:
+		break;
+	}
+	slot_write(1);
+	return 1;
+}
+
+uint8_t OneWireSimDevice::read_function_bit(void)
+{
+	uint8_t r;
+
+	if (tx_bits == 0) {
+		tx = read_byte();
+		tx_bits = 8;
+	}
+	r = tx & 1;
+	tx >>= 1;
+	tx_bits--;
+	return r;
+}
+
+
+OneWireSim::OneWireSim()
+{
+	devices = NULL;
+	speed = ONEWIRE_STANDARD;
+	timing = &OneWireTiming::standard;
+	rise_usec = 0;
+	hold_usec = 30;
+	misread_slot = 0;
+	ready_at = 0;
+	clear_stats();
+}
+
+void OneWireSim::attach(OneWireSimDevice &dev)
+{
+	OneWireSimDevice **p = &devices;
+
+	while (*p) {
+		if (*p == &dev) return;
+		p = &(*p)->next;
+	}
+	dev.next = NULL;
+	dev.bus = this;
+	dev.state = OneWireSimDevice::IDLE;
+	dev.overdrive = false;
+	*p = &dev;
+}
+
+void OneWireSim::detach(OneWireSimDevice &dev)
+{
+	for (OneWireSimDevice **p = &devices; *p; p = &(*p)->next) {
+		if (*p == &dev) {
+			*p = dev.next;
+			dev.next = NULL;
+			dev.bus = NULL;
+			return;
+		}
+	}
+}
+
+void OneWireSim::clear_stats(void)
+{
+	resets = 0;
+	write_slots = 0;
+	read_slots = 0;
+	lost_slots = 0;
+	bus_usec = 0;
+}
+
+void OneWireSim::elapse(unsigned int usec)
+{
+	bus_usec += usec;
+	delayMicroseconds(usec);
+}
+
+bool OneWireSim::set_speed(uint8_t s)
+{
+	if (s != ONEWIRE_STANDARD && s != ONEWIRE_OVERDRIVE) return false;
+	speed = s;
+	return true;
+}
+
+bool OneWireSim::set_timing(const OneWireTiming *t)
+{
+	timing = t;
+	return true;
+}
+
+uint8_t OneWireSim::reset(void)
+{
+	bool od = (speed == ONEWIRE_OVERDRIVE);
+	uint8_t presence = 0;
+
+	// the reset pulse and the wait for the sample point
+	if (od) elapse(SIM_OD_RESET_USEC);
+	else elapse(timing->reset_low + timing->reset_sample);
+	resets++;
+	for (OneWireSimDevice *d = devices; d; d = d->next) {
+		// a standard reset is long enough to reset every device, an
+		// overdrive reset is only seen by devices at overdrive
+		if (!od) d->overdrive = false;
+		if (d->overdrive != od) continue;
+		d->reset_pulse();
+		presence = 1;
+	}
+	if (od) return presence;
+	if (presence && timing->fast_reset) {
+		// wait for the bus to go high, then the recovery time
+		uint16_t wait = SIM_PRESENCE_END_USEC - timing->reset_sample;
+		if (wait > timing->reset_high) wait = timing->reset_high;
+		elapse(wait + timing->reset_recovery);
+	} else {
+		elapse(timing->reset_high);
+	}
+	return presence;
+}
+
+// At standard speed, whether a slot starting now finds the bus high
+// again after the last one.  Devices don't see the falling edge of a
+// slot which starts while the bus is still rising, and the master reads
+// it as 0.
+bool OneWireSim::recovered(void)
+{
+	if (now() >= ready_at) return true;
+	lost_slots++;
+	return false;
+}
+
+void OneWireSim::write_bit(uint8_t v)
+{
+	bool od = (speed == ONEWIRE_OVERDRIVE);
+
+	if (od) {
+		elapse((v & 1) ? SIM_OD_WRITE1_USEC : SIM_OD_WRITE0_USEC);
+	} else {
+		uint64_t start = now();
+		bool seen = recovered();
+		uint8_t low = (v & 1) ? timing->write1_low : timing->write0_low;
+		ready_at = start + low + rise_usec + 1;
+		// a 1 which hasn't risen by the time the devices sample is a 0
+		if (low + rise_usec > SIM_WRITE_SAMPLE_USEC) v = 0;
+		if (v & 1) elapse(timing->write1_low + timing->write1_high);
+		else elapse(timing->write0_low + timing->write0_high);
+		if (!seen) {
+			write_slots++;
+			return;
+		}
+	}
+	write_slots++;
+	for (OneWireSimDevice *d = devices; d; d = d->next) {
+		if (d->overdrive == od) d->slot_write(v);
+	}
+}
+
+uint8_t OneWireSim::read_bit(void)
+{
+	bool od = (speed == ONEWIRE_OVERDRIVE);
+	uint8_t r = 1;
+	uint64_t start = now();
+	bool seen = od || recovered();
+	bool misread = misread_slot && --misread_slot == 0;
+
+	elapse(od ? SIM_OD_READ_USEC : read_usec());
+	read_slots++;
+	if (!seen) {
+		ready_at = start + timing->read_low + rise_usec + 1;
+		return misread;
+	}
+	// open drain: any device sending 0 pulls the whole bus low
+	for (OneWireSimDevice *d = devices; d; d = d->next) {
+		if (d->overdrive == od) r &= d->slot_read();
+	}
+	if (od) return r ^ misread;
+
+	// the bus is released by the master after read_low, or by the
+	// devices after hold_usec if they send a 0, then takes rise_usec
+	// to reach high
+	unsigned int release = timing->read_low;
+	if (!r && hold_usec > release) release = hold_usec;
+	ready_at = start + release + rise_usec + 1;
+	return (timing->read_low + timing->read_sample >= release + rise_usec) ^ misread;
+}
+
+uint8_t OneWireSim::touch_bit(uint8_t v)
+{
+	bool od = (speed == ONEWIRE_OVERDRIVE);
+	uint8_t r = 1;
+
+	if (!(v & 1)) {
+		write_bit(0);
+		return 0;
+	}
+	elapse(od ? SIM_OD_READ_USEC : read_usec());
+	read_slots++;
+	for (OneWireSimDevice *d = devices; d; d = d->next) {
+		if (d->overdrive == od) r &= d->slot_one();
+	}
+	return r;
+}
+
+
+OneWireSimDS18B20::OneWireSimDS18B20(uint64_t serial, uint8_t family)
+  : OneWireSimDevice(family, serial)
+{
+	parasite = false;
+	resume_capable = (family == 0x42);   // DS28EA00
+	eeprom[0] = 0x4B;
+	eeprom[1] = 0x46;
+	eeprom[2] = 0x7F;
+	temperature = 85 * 16;   // power-on value
+	scratchpad[0] = temperature & 0xFF;
+	scratchpad[1] = temperature >> 8;
+	memcpy(scratchpad + 2, eeprom, 3);
+	scratchpad[5] = 0xFF;
+	scratchpad[6] = 0x0C;
+	scratchpad[7] = 0x10;
+	scratchpad[8] = sim_crc8(scratchpad, 8);
+	alarm_flag = false;
+	converting = false;
+	command = 0;
+	index = 0;
+	busy_until = 0;
+}
+
+void OneWireSimDS18B20::set_temperature(float celsius)
+{
+	temperature = (int16_t)(celsius * 16.0f + (celsius < 0 ? -0.5f : 0.5f));
+}
+
+uint32_t OneWireSimDS18B20::conversion_usec(void) const
+{
+	return 93750UL << ((scratchpad[4] >> 5) & 3);
+}
+
+// finish a conversion once its time has passed
+void OneWireSimDS18B20::update(void)
+{
+	if (!converting || (bus && bus->now() < busy_until)) return;
+	converting = false;
+
+	static const uint16_t resolution_mask[4] = { 0xFFF8, 0xFFFC, 0xFFFE, 0xFFFF };
+	int16_t raw = temperature & resolution_mask[(scratchpad[4] >> 5) & 3];
+	scratchpad[0] = raw & 0xFF;
+	scratchpad[1] = (uint16_t)raw >> 8;
+	scratchpad[8] = sim_crc8(scratchpad, 8);
+
+	// the alarm compares the integer part against TH and TL
+	int8_t t = raw >> 4;
+	alarm_flag = (t >= (int8_t)scratchpad[2]) || (t <= (int8_t)scratchpad[3]);
+}
+
+void OneWireSimDS18B20::reset(void)
+{
+	update();
+	command = 0;
+	index = 0;
+}
+
+void OneWireSimDS18B20::write_byte(uint8_t v)
+{
+	uint64_t now = bus ? bus->now() : 0;
+
+	if (command == 0) {
+		command = v;
+		index = 0;
+		switch (v) {
+		case 0x44: // Convert T
+			converting = true;
+			busy_until = now + conversion_usec();
+			break;
+		case 0x48: // Copy Scratchpad
+			memcpy(eeprom, scratchpad + 2, 3);
+			busy_until = now + 10000;
+			break;
+		case 0xB8: // Recall E2
+			memcpy(scratchpad + 2, eeprom, 3);
+			scratchpad[8] = sim_crc8(scratchpad, 8);
+			break;
+		}
+		return;
+	}
+	if (command == 0x4E && index < 3) { // Write Scratchpad: TH, TL, config
+		if (index == 2) v = (v & 0x60) | 0x1F;
+		scratchpad[2 + index++] = v;
+		scratchpad[8] = sim_crc8(scratchpad, 8);
+	}
+}
+
+uint8_t OneWireSimDS18B20::read_byte(void)
+{
+	if (command == 0xBE && index < 9) {
+		update();
+		return scratchpad[index++];
+	}
+	return 0xFF;
+}
+
+uint8_t OneWireSimDS18B20::read_function_bit(void)
+{
+	switch (command) {
+	case 0x44:
+	case 0x48:
+		update();
+		return !bus || bus->now() >= busy_until;
+	case 0xB4: // Read Power Supply
+		return parasite ? 0 : 1;
+	case 0xB8:
+		return 1;
+	default:
+		return OneWireSimDevice::read_function_bit();
+	}
+}
+
+bool OneWireSimDS18B20::alarm(void)
+{
+	update();
+	return alarm_flag;
+}
+
+bool OneWireSimDS18B20::receiving(void)
+{
+	return command == 0 || (command == 0x4E && index < 3);
+}
+
+
+OneWireSimDS2408::OneWireSimDS2408(uint64_t serial)
+  : OneWireSimDevice(0x29, serial)
+{
+	overdrive_capable = true;
+	resume_capable = true;
+	memset(reg, 0, sizeof(reg));
+	reg[1] = 0xFF;    // output latches off (pins float high)
+	reg[5] = 0x88;    // VCC powered, power-on reset flag
+	reg[6] = 0xFF;
+	reg[7] = 0xFF;
+	inputs = 0xFF;
+	reset();
+}
+
+void OneWireSimDS2408::set_inputs(uint8_t levels)
+{
+	reg[2] |= (inputs ^ levels);   // activity latches
+	inputs = levels;
+}
+
+void OneWireSimDS2408::reset(void)
+{
+	command = 0;
+	count = 0;
+	address = 0;
+	out_len = out_pos = 0;
+}
+
+void OneWireSimDS2408::write_byte(uint8_t v)
+{
+	if (command == 0) {
+		command = v;
+		count = 0;
+		crc = crc16_update(0, v);
+		if (v == 0xC3) reg[2] = 0;  // Reset Activity Latches
+		return;
+	}
+	switch (command) {
+	case 0xF0: // Read PIO Registers: TA1, TA2
+	case 0xCC: // Write Conditional Search Register: TA1, TA2, data
+		if (count == 0) {
+			address = v;
+			count++;
+			crc = crc16_update(crc, v);
+		} else if (count == 1) {
+			address |= (uint16_t)v << 8;
+			count++;
+			crc = crc16_update(crc, v);
+		} else if (command == 0xCC && address >= 0x8B && address <= 0x8D) {
+			reg[address++ - 0x88] = v;
+		}
+		break;
+	case 0x5A: // Channel Access Write: data, inverted data
+		if ((count++ & 1) == 0) {
+			data = v;
+		} else {
+			out_len = out_pos = 0;
+			if (v == (uint8_t)~data) {
+				reg[1] = data;
+				out[out_len++] = 0xAA;
+				out[out_len++] = pio_state();
+			}
+		}
+		break;
+	}
+}
+
+uint8_t OneWireSimDS2408::read_byte(void)
+{
+	uint8_t b;
+
+	if (out_pos < out_len) return out[out_pos++];
+	out_len = out_pos = 0;
+
+	switch (command) {
+	case 0xF0:
+		if (count < 2) return 0xFF;
+		if (count == 2 && address <= 0x8F) {
+			if (address < 0x88) b = 0xFF;
+			else if (address == 0x88) b = pio_state();
+			else b = reg[address - 0x88];
+			address++;
+			crc = crc16_update(crc, b);
+			return b;
+		}
+		if (count == 2) {
+			// past the last register, send the inverted CRC16
+			count = 3;
+			out[out_len++] = (uint8_t)(~crc >> 8);
+			return (uint8_t)~crc;
+		}
+		return 0xFF;
+	case 0xF5: // Channel Access Read, a CRC16 after every 32 samples
+		if (count == 32) {
+			count = 0;
+			out[out_len++] = (uint8_t)(~crc >> 8);
+			b = (uint8_t)~crc;
+			crc = 0;
+			return b;
+		}
+		b = pio_state();
+		count++;
+		crc = crc16_update(crc, b);
+		return b;
+	case 0xC3:
+		return 0xAA;
+	default:
+		return 0xFF;
+	}
+}
+
+bool OneWireSimDS2408::receiving(void)
+{
+	switch (command) {
+	case 0:
+	case 0xCC:
+		return true;
+	case 0xF0:
+		return count < 2;
+	case 0x5A: // data and its inverse, then the confirmation to read
+		return out_pos >= out_len;
+	default:
+		return false;
+	}
+}
+
+
+OneWireSimDS250x::OneWireSimDS250x(uint64_t serial, uint8_t family, uint16_t size)
+  : OneWireSimDevice(family, serial)
+{
+	this->size = size;
+	memory = new uint8_t[size];
+	memset(memory, 0xFF, size);   // unprogrammed EPROM reads as ones
+	reset();
+}
+
+OneWireSimDS250x::~OneWireSimDS250x()
+{
+	delete [] memory;
+}
+
+void OneWireSimDS250x::program(uint16_t addr, const uint8_t *data, uint16_t len)
+{
+	while (len-- && addr < size) {
+		memory[addr++] &= *data++;   // EPROM bits can only go from 1 to 0
+	}
+}
+
+void OneWireSimDS250x::reset(void)
+{
+	command = 0;
+	count = 0;
+	address = 0;
+	crc = 0;
+	data_crc_sent = false;
+}
+
+void OneWireSimDS250x::write_byte(uint8_t v)
+{
+	if (command == 0) {
+		command = v;
+		header[0] = v;
+		count = 0;
+	} else if (command == 0xF0 && count < 2) {
+		header[1 + count++] = v;
+		if (count == 2) address = header[1] | ((uint16_t)header[2] << 8);
+	}
+}
+
+uint8_t OneWireSimDS250x::read_byte(void)
+{
+	uint8_t b;
+
+	if (command != 0xF0 || count < 2) return 0xFF;
+	if (count == 2) {
+		// first the CRC of the command and address
+		count = 3;
+		crc = 0;
+		return sim_crc8(header, 3);
+	}
+	if (address < size) {
+		b = memory[address++];
+		crc = crc8_update(crc, b);
+		return b;
+	}
+	if (!data_crc_sent) {
+		// then, at the end of memory, the CRC of the data bytes
+		data_crc_sent = true;
+		return crc;
+	}
+	return 0xFF;
+}
+
+bool OneWireSimDS250x::receiving(void)
+{
+	return command == 0 || (command == 0xF0 && count < 2);
+}
+
+
+
+OneWireSimEEPROM::OneWireSimEEPROM(uint64_t serial, uint8_t family)
+  : OneWireSimDevice(family, serial)
+{
+	size = (family == 0x43) ? 2560 : (family == 0x23) ? 512 : 128;
+	spsize = (family == 0x2D) ? 8 : 32;
+	crcs = (family != 0x23);
+	overdrive_capable = true;
+	resume_capable = (family != 0x23);
+	memory = new uint8_t[size];
+	memset(memory, 0xFF, size);
+	memset(scratchpad, 0xFF, sizeof(scratchpad));
+	prog_usec = 5000;
+	copies = 0;
+	busy_reads = 0;
+	target = 0;
+	es = 0;
+	busy_until = 0;
+	reset();
+}
+
+OneWireSimEEPROM::~OneWireSimEEPROM()
+{
+	delete [] memory;
+}
+
+void OneWireSimEEPROM::reset(void)
+{
+	command = 0;
+	count = 0;
+	address = 0;
+	out_len = out_pos = 0;
+}
+
+void OneWireSimEEPROM::write_byte(uint8_t v)
+{
+	if (command == 0) {
+		command = v;
+		count = 0;
+		crc = crc16_update(0, v);
+		return;
+	}
+	switch (command) {
+	case 0x0F: // Write Scratchpad: TA1, TA2, data up to the end of it
+		crc = crc16_update(crc, v);
+		if (count == 0) {
+			target = v;
+			count++;
+		} else if (count == 1) {
+			target |= (uint16_t)v << 8;
+			count++;
+			address = target & (spsize - 1);
+			es = 0x20;      // PF, until a whole byte arrives
+		} else if (address < spsize) {
+			scratchpad[address] = v;
+			es = address++;
+		}
+		break;
+	case 0x55: // Copy Scratchpad: TA1, TA2, E/S to authorize it
+		if (count == 0) {
+			address = v;
+			count++;
+		} else if (count == 1) {
+			address |= (uint16_t)v << 8;
+			count++;
+		} else if (count == 2) {
+			uint8_t first = target & (spsize - 1), last = es & (spsize - 1);
+			uint16_t base = target & ~(uint16_t)(spsize - 1);
+			count = 4;      // refused, nothing more is answered
+			if (address != target || v != es || (es & 0x20) || target >= size) break;
+			// the DS2431 only copies whole rows
+			if (spsize == 8 && (first != 0 || last != 7)) break;
+			for (uint8_t i = first; i <= last; i++) memory[base + i] = scratchpad[i];
+			es |= 0x80;     // AA
+			copies++;
+			busy_until = (bus ? bus->now() : 0) + prog_usec;
+			count = 3;
+		}
+		break;
+	case 0xF0: // Read Memory: TA1, TA2
+	case 0xA5: // Extended Read Memory: TA1, TA2
+		crc = crc16_update(crc, v);
+		if (count == 0) {
+			address = v;
+			count++;
+		} else if (count == 1) {
+			address |= (uint16_t)v << 8;
+			count++;
+		}
+		break;
+	}
+}
+
+uint8_t OneWireSimEEPROM::read_byte(void)
+{
+	uint8_t b, offset;
+
+	if (out_pos < out_len) return out[out_pos++];
+	out_len = out_pos = 0;
+
+	switch (command) {
+	case 0x0F:
+		// the inverted CRC16 of the command, address and data, once
+		// the scratchpad is filled to the end
+		if (!crcs || count != 2 || address < spsize) return 0xFF;
+		count = 3;
+		out[out_len++] = (uint8_t)(~crc >> 8);
+		return (uint8_t)~crc;
+	case 0xAA: // Read Scratchpad: TA1, TA2, E/S, data to the end, CRC16
+		offset = (target & (spsize - 1)) + count - 3;
+		if (count == 0) b = target & 0xFF;
+		else if (count == 1) b = target >> 8;
+		else if (count == 2) b = es;
+		else if (offset < spsize) b = scratchpad[offset];
+		else if (crcs && offset == spsize) {
+			count++;
+			out[out_len++] = (uint8_t)(~crc >> 8);
+			return (uint8_t)~crc;
+		} else return 0xFF;
+		count++;
+		crc = crc16_update(crc, b);
+		return b;
+	case 0x55:
+		if (count != 3) return 0xFF;
+		if (bus && bus->now() < busy_until) {
+			busy_reads++;
+			return 0xFF;
+		}
+		return 0xAA;
+	case 0xF0:
+		if (count < 2 || address >= size) return 0xFF;
+		return memory[address++];
+	case 0xA5: // a CRC16 after the last byte of each page
+		if (rom[0] != 0x43 || count < 2 || address >= size) return 0xFF;
+		b = memory[address++];
+		crc = crc16_update(crc, b);
+		if ((address & 31) == 0) {
+			out[out_len++] = (uint8_t)~crc;
+			out[out_len++] = (uint8_t)(~crc >> 8);
+			crc = 0;
+		}
+		return b;
+	default:
+		return 0xFF;
+	}
+}
+
+bool OneWireSimEEPROM::receiving(void)
+{
+	switch (command) {
+	case 0:
+		return true;
+	case 0x0F:
+		return count < 2 || (count == 2 && (!crcs || address < spsize));
+	case 0xF0:
+	case 0xA5:
+		return count < 2;
+	case 0x55:
+		return count < 3;
+	default:
+		return false;
+	}
+}
+
+
+OneWireSimDS2480B::OneWireSimDS2480B(OneWireSim &b) : bus(b)
+{
+	memset(config, 0, sizeof(config));
+	serial_break();
+}
+
+void OneWireSimDS2480B::serial_break(void)
+{
+	calibrated = false;
+	data_mode = false;
+	escape = false;
+	accelerator = false;
+	pulse = 0;
+	search_len = 0;
+	set_speed(0);
+}
+
+// speed bits of a command: 0 standard, 1 flexible, 2 overdrive
+void OneWireSimDS2480B::set_speed(uint8_t code)
+{
+	bus.set_speed(code == 2 ? ONEWIRE_OVERDRIVE : ONEWIRE_STANDARD);
+}
+
+uint16_t OneWireSimDS2480B::receive(const uint8_t *in, uint16_t count, uint8_t *out)
+{
+	uint16_t n = 0;
+
+	while (count--) {
+		uint8_t c = *in++;
+		if (!data_mode) {
+			command(c, out, n);
+		} else if (escape) {
+			escape = false;
+			if (c == 0xE3) {
+				data(c, out, n);
+			} else {
+				// 0xE3 then anything else: back to command mode
+				data_mode = false;
+				command(c, out, n);
+			}
+		} else if (c == 0xE3) {
+			escape = true;
+		} else {
+			data(c, out, n);
+		}
+	}
+	return n;
+}
+
+void OneWireSimDS2480B::command(uint8_t c, uint8_t *out, uint16_t &n)
+{
+	if (!calibrated) {
+		// the timing byte, no response
+		calibrated = true;
+		if (c == 0xC1) return;
+	}
+	if (pulse && c == 0xF1) {
+		// pulse terminated, now the pulse command is answered
+		out[n++] = pulse & 0xFC;
+		pulse = 0;
+		return;
+	}
+	if (c == 0xE1) {
+		data_mode = true;
+		search_len = 0;
+	} else if ((c & 0xE3) == 0xC1) {
+		// reset: 110011 and the presence result, 01 = presence,
+		// 11 = no presence
+		set_speed((c >> 2) & 3);
+		out[n++] = bus.reset() ? 0xCD : 0xCF;
+	} else if ((c & 0xE3) == 0x81) {
+		// single bit, the response has the bit read in the low 2 bits
+		set_speed((c >> 2) & 3);
+		uint8_t b = bus.touch_bit(c & 0x10 ? 1 : 0);
+		out[n++] = (c & 0xFC) | (b ? 3 : 0);
+	} else if ((c & 0xE3) == 0xA1) {
+		// search accelerator on or off, no response
+		accelerator = c & 0x10;
+		set_speed((c >> 2) & 3);
+	} else if ((c & 0xED) == 0xED) {
+		// pulse (strong pullup), answered when it ends: at the 0xF1
+		// if the strong pullup duration is "until ended", otherwise
+		// after that time, which is taken as at once
+		if (config[3] == 7) pulse = c;
+		else out[n++] = c & 0xFC;
+	} else if ((c & 0x81) == 0x01) {
+		// configuration, 0PPPVVV1, parameter 0 reads
+		uint8_t param = (c >> 4) & 7;
+		if (param == 0) {
+			uint8_t which = (c >> 1) & 7;
+			out[n++] = (which << 4) | (config[which] << 1);
+		} else {
+			config[param] = (c >> 1) & 7;
+			out[n++] = c & 0xFE;
+		}
+	}
+}
+
+void OneWireSimDS2480B::data(uint8_t c, uint8_t *out, uint16_t &n)
+{
+	if (!accelerator) {
+		// one byte on the 1-Wire bus, reading back each bit
+		uint8_t r = 0;
+		for (uint8_t mask = 1; mask; mask <<= 1) {
+			if (bus.touch_bit(c & mask ? 1 : 0)) r |= mask;
+		}
+		out[n++] = r;
+		return;
+	}
+	// search accelerator: 16 bytes hold 2 bits per ROM bit, the
+	// discrepancy flag (d) then the direction (r)
+	search[search_len++] = c;
+	if (search_len < 16) return;
+	search_len = 0;
+	for (uint8_t bit = 0; bit < 64; bit++) {
+		uint8_t *p = &search[bit >> 2];
+		uint8_t d_mask = 1 << ((bit & 3) * 2);
+		uint8_t r_mask = d_mask << 1;
+		uint8_t id = bus.read_bit();
+		uint8_t cmp = bus.read_bit();
+		uint8_t dir = (*p & r_mask) ? 1 : 0;
+		*p &= ~(d_mask | r_mask);
+		if (id == cmp) {
+			*p |= d_mask;
+			if (id) dir = 1;
+		} else {
+			dir = id;
+		}
+		if (dir) *p |= r_mask;
+		bus.write_bit(dir);
+	}
+	memcpy(out + n, search, 16);
+	n += 16;
+}
+
+void OneWireSimDS2480B::serve(int fd)
+{
+	uint8_t in[256], out[256];
+
+	while (1) {
+		ssize_t len = read(fd, in, sizeof(in));
+		if (len <= 0) return;
+		uint16_t n = receive(in, len, out);
+		if (n && write(fd, out, n) != n) return;
+	}
+}
+
+
+// I2C time of one transfer at 400kHz: the address and each byte are 9
+// bits, about 23us
+#define SIM_I2C_BYTE_USEC   23
+
+OneWireSimDS2482::OneWireSimDS2482(OneWireSim &bus, uint8_t addr)
+{
+	memset(channels, 0, sizeof(channels));
+	channels[0] = &bus;
+	eight_channel = false;
+	address = addr;
+	busy_polls = 0;
+	refused = 0;
+	device_reset();
+}
+
+void OneWireSimDS2482::attach(uint8_t channel, OneWireSim &bus)
+{
+	if (channel > 7) return;
+	channels[channel] = &bus;
+	eight_channel = true;
+}
+
+void OneWireSimDS2482::device_reset(void)
+{
+	selected = 0;
+	pointer = 0xF0;
+	status = 0x18;    // RST, and the bus is idle high (LL)
+	data = 0;
+	config = 0;
+	strong = false;
+	busy_until = 0;
+}
+
+bool OneWireSimDS2482::busy(void) const
+{
+	return onewire_host_clock() < busy_until;
+}
+
+// Run a 1-Wire command on the selected channel, then put the clock back
+// to the start and leave the chip busy until then
+void OneWireSimDS2482::one_wire(uint8_t c, uint8_t p)
+{
+	OneWireSim *bus = channels[selected];
+	uint64_t start = onewire_host_clock();
+	uint8_t r, id, cmp, dir;
+
+	status &= ~(0xE0 | 0x07);
+	if (!bus) {
+		// nothing attached: no presence, and every slot reads 1
+		if (c == 0x78) status |= (p & 0x80) ? 0xE0 : 0x60;
+		else if (c == 0x87) status |= 0x20;
+		else if (c == 0x96) data = 0xFF;
+		return;
+	}
+	bus->set_speed((config & 0x08) ? ONEWIRE_OVERDRIVE : ONEWIRE_STANDARD);
+	switch (c) {
+	case 0xB4: // 1-Wire Reset
+		if (bus->reset()) status |= 0x02;
+		break;
+	case 0x87: // 1-Wire Single Bit
+		if (bus->touch_bit(p >> 7)) status |= 0x20;
+		strong = config & 0x04;
+		break;
+	case 0xA5: // 1-Wire Write Byte
+		for (uint8_t mask = 1; mask; mask <<= 1) bus->touch_bit(p & mask ? 1 : 0);
+		strong = config & 0x04;
+		break;
+	case 0x96: // 1-Wire Read Byte
+		r = 0;
+		for (uint8_t mask = 1; mask; mask <<= 1) {
+			if (bus->touch_bit(1)) r |= mask;
+		}
+		data = r;
+		break;
+	case 0x78: // 1-Wire Triplet
+		id = bus->touch_bit(1);
+		cmp = bus->touch_bit(1);
+		dir = (id != cmp) ? id : (p >> 7);
+		bus->touch_bit(dir);
+		status |= (id ? 0x20 : 0) | (cmp ? 0x40 : 0) | (dir ? 0x80 : 0);
+		break;
+	}
+	// the SPU bit is used up by the write it powers
+	if (strong) config &= ~0x04;
+	busy_until = onewire_host_clock();
+	onewire_host_clock() = start;
+}
+
+bool OneWireSimDS2482::write(uint8_t addr, const uint8_t *buf, uint8_t len)
+{
+	if (addr != address) return false;
+	delayMicroseconds((len + 1) * SIM_I2C_BYTE_USEC);
+	if (len == 0) return true;
+
+	uint8_t c = buf[0];
+	uint8_t p = (len > 1) ? buf[1] : 0;
+	bool wants_param = (c != 0xF0 && c != 0xB4 && c != 0x96);
+
+	if (wants_param && len < 2) return false;
+	if (busy() && c != 0xF0 && c != 0xE1) {
+		refused++;
+		return false;
+	}
+	switch (c) {
+	case 0xF0: // Device Reset
+		device_reset();
+		return true;
+	case 0xE1: // Set Read Pointer
+		if (p != 0xF0 && p != 0xE1 && p != 0xC3 && !(p == 0xD2 && eight_channel)) {
+			return false;
+		}
+		pointer = p;
+		return true;
+	case 0xD2: // Write Configuration, the upper 4 bits inverted
+		if ((p >> 4) != (~p & 0x0F)) return false;
+		config = p & 0x0F;
+		status &= ~0x10;
+		strong = false;
+		pointer = 0xC3;
+		return true;
+	case 0xC3: // Channel Select, DS2482-800 only
+		if (!eight_channel) return false;
+		for (uint8_t ch = 0; ch < 8; ch++) {
+			if (p == 0xF0 - ch * 0x0F) {
+				selected = ch;
+				strong = false;
+				pointer = 0xD2;
+				return true;
+			}
+		}
+		return false;
+	case 0xB4:
+	case 0x87:
+	case 0xA5:
+	case 0x96:
+	case 0x78:
+		strong = false;
+		pointer = 0xF0;
+		one_wire(c, p);
+		return true;
+	}
+	return false;
+}
+
+bool OneWireSimDS2482::read(uint8_t addr, uint8_t *buf, uint8_t len)
+{
+	if (addr != address) return false;
+	delayMicroseconds((len + 1) * SIM_I2C_BYTE_USEC);
+	for (uint8_t i = 0; i < len; i++) {
+		switch (pointer) {
+		case 0xF0:
+			if (busy()) {
+				busy_polls++;
+				buf[i] = (status & 0x18) | 0x01;
+			} else {
+				buf[i] = status;
+			}
+			break;
+		case 0xE1:
+			buf[i] = data;
+			break;
+		case 0xC3:
+			buf[i] = config;
+			break;
+		default:
+			// channel select read back: B8, B1, AA ... 87
+			buf[i] = 0xB8 - selected * 7;
+			break;
+		}
+	}
+	return true;
+}
+
+
+OneWireSimOwserver::OneWireSimOwserver(OneWire &bus) : ds(bus)
+{
+	persistent = true;
+	requests = 0;
+	simultaneous = false;
+}
+
+static bool sim_read_fd(int fd, uint8_t *buf, size_t len)
+{
+	while (len) {
+		ssize_t n = read(fd, buf, len);
+		if (n <= 0) return false;
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+static void sim_put32(uint8_t *p, int32_t v)
+{
+	p[0] = (uint32_t)v >> 24;
+	p[1] = (uint32_t)v >> 16;
+	p[2] = (uint32_t)v >> 8;
+	p[3] = (uint32_t)v;
+}
+
+static int32_t sim_get32(const uint8_t *p)
+{
+	return (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+		((uint32_t)p[2] << 8) | p[3]);
+}
+
+// Wait for the Convert T just sent, the sensors read 0 until it's done
+bool OneWireSimOwserver::wait_conversion(void)
+{
+	for (uint16_t ms = 0; ms < 1000; ms++) {
+		if (ds.read_bit()) return true;
+		delay(1);
+	}
+	return false;
+}
+
+int32_t OneWireSimOwserver::dirall(char *out, uint32_t max)
+{
+#if ONEWIRE_SEARCH
+	OneWireSearchCursor cursor;
+	uint8_t rom[8];
+	uint32_t len = 0;
+	char name[32];
+
+	while (ds.search(cursor, rom)) {
+		OneWireOwserver::device_path(name, sizeof(name), rom);
+		uint32_t n = strlen(name);
+		if (len + n + 2 > max) break;
+		if (len) out[len++] = ',';
+		memcpy(out + len, name, n);
+		len += n;
+	}
+	out[len] = 0;
+	return len;
+#else
+	// without the search there is no way to list the bus
+	(void)max;
+	out[0] = 0;
+	return 0;
+#endif
+}
+
+int32_t OneWireSimOwserver::read_path(const char *path, uint8_t *out, uint32_t size,
+	uint32_t offset)
+{
+	char text[32];
+	uint8_t rom[8], tx[3], rx[10];
+	int32_t len;
+
+	if (strncmp(path, "/uncached", 9) == 0) path += 9;
+	if (path[0] != '/' || strlen(path) < 17 || path[16] != '/') return -ENOENT;
+	memcpy(text, path + 1, 15);
+	text[15] = 0;
+	if (!OneWireOwserver::parse_device(text, rom)) return -ENOENT;
+	const char *prop = path + 17;
+
+	if (strcmp(prop, "family") == 0) {
+		snprintf(text, sizeof(text), "%02X", rom[0]);
+	} else if (strcmp(prop, "id") == 0) {
+		snprintf(text, sizeof(text), "%02X%02X%02X%02X%02X%02X",
+			rom[1], rom[2], rom[3], rom[4], rom[5], rom[6]);
+	} else if (strcmp(prop, "address") == 0) {
+		for (uint8_t i = 0; i < 8; i++) snprintf(text + i * 2, 3, "%02X", rom[i]);
+	} else if (strcmp(prop, "temperature") == 0 &&
+	           (rom[0] == 0x10 || rom[0] == 0x28 || rom[0] == 0x22 || rom[0] == 0x42)) {
+		OneWireTemperature temp(ds);
+		int16_t raw;
+		if (!simultaneous) {
+			tx[0] = 0x44;
+			if (ds.transaction(ONEWIRE_ADDR_MATCH, rom, tx, 1, NULL, 0) != ONEWIRE_OK) {
+				return -ENOENT;
+			}
+			if (!wait_conversion()) return -EIO;
+		}
+		if (!temp.read_raw(rom, &raw)) return -EIO;
+		snprintf(text, sizeof(text), "%12G", (double)OneWireTemperature::celsius(raw));
+	} else if (strcmp(prop, "sensed.BYTE") == 0 && rom[0] == 0x29) {
+		tx[0] = 0xF0;
+		tx[1] = 0x88;
+		tx[2] = 0x00;
+		if (ds.transaction(ONEWIRE_ADDR_MATCH, rom, tx, 3, rx, 1) != ONEWIRE_OK) {
+			return -ENOENT;
+		}
+		snprintf(text, sizeof(text), "%12d", rx[0]);
+	} else if (strcmp(prop, "memory") == 0 &&
+	           (rom[0] == 0x09 || rom[0] == 0x0B || rom[0] == 0x0F)) {
+		// Read Memory from 'offset', after the command CRC
+		tx[0] = 0xF0;
+		tx[1] = offset & 0xFF;
+		tx[2] = offset >> 8;
+		if (ds.transaction(ONEWIRE_ADDR_MATCH, rom, tx, 3, rx, 1,
+		    ONEWIRE_CHECK_CRC8 | ONEWIRE_CHECK_TX) != ONEWIRE_OK) {
+			return -EIO;
+		}
+		ds.read_bytes(out, size);
+		return size;
+	} else {
+		return -ENOENT;
+	}
+	len = strlen(text);
+	if (offset >= (uint32_t)len) return 0;
+	len -= offset;
+	if ((uint32_t)len > size) len = size;
+	memcpy(out, text + offset, len);
+	return len;
+}
+
+int32_t OneWireSimOwserver::write_path(const char *path, const uint8_t *data, uint32_t size)
+{
+	char text[16];
+	uint8_t rom[8], tx[3], rx[2];
+
+	if (strcmp(path, "/simultaneous/temperature") == 0) {
+		tx[0] = 0x44;
+		if (ds.transaction(ONEWIRE_ADDR_SKIP, NULL, tx, 1, NULL, 0) != ONEWIRE_OK) {
+			return -ENOENT;
+		}
+		simultaneous = wait_conversion();
+		return simultaneous ? 0 : -EIO;
+	}
+	if (path[0] != '/' || strlen(path) < 17 || path[16] != '/') return -ENOENT;
+	memcpy(text, path + 1, 15);
+	text[15] = 0;
+	if (!OneWireOwserver::parse_device(text, rom)) return -ENOENT;
+	if (strcmp(path + 17, "PIO.BYTE") == 0 && rom[0] == 0x29) {
+		if (size >= sizeof(text)) return -EINVAL;
+		memcpy(text, data, size);
+		text[size] = 0;
+		tx[0] = 0x5A;
+		tx[1] = strtoul(text, NULL, 10);
+		tx[2] = ~tx[1];
+		if (ds.transaction(ONEWIRE_ADDR_MATCH, rom, tx, 3, rx, 2) != ONEWIRE_OK) {
+			return -ENOENT;
+		}
+		return rx[0] == 0xAA ? 0 : -EIO;
+	}
+	return -ENOENT;
+}
+
+void OneWireSimOwserver::serve(int fd)
+{
+	uint8_t header[OWSERVER_HEADER], reply[OWSERVER_HEADER];
+
+	while (sim_read_fd(fd, header, OWSERVER_HEADER)) {
+		int32_t payload = sim_get32(header + 4);
+		int32_t type = sim_get32(header + 8);
+		int32_t flags = sim_get32(header + 12);
+		int32_t size = sim_get32(header + 16);
+		int32_t offset = sim_get32(header + 20);
+		int32_t ret = 0, len = 0;
+
+		if (payload < 0 || payload > 65536 || size < 0 || size > 65536) return;
+		char *in = (char *)malloc(payload + 1);
+		uint8_t *out = (uint8_t *)malloc(size + 1);
+		if (!in || !out || !sim_read_fd(fd, (uint8_t *)in, payload)) {
+			free(in);
+			free(out);
+			return;
+		}
+		in[payload] = 0;
+		size_t pathlen = strlen(in) + 1;
+		requests++;
+		switch (type) {
+		case OWSERVER_NOP:
+			break;
+		case OWSERVER_DIRALL:
+			len = dirall((char *)out, size + 1) + 1;
+			break;
+		case OWSERVER_READ:
+			ret = read_path(in, out, size, offset);
+			len = ret > 0 ? ret : 0;
+			break;
+		case OWSERVER_WRITE:
+			if ((int32_t)pathlen > payload) {
+				ret = -EINVAL;
+			} else {
+				ret = write_path(in, (uint8_t *)in + pathlen, payload - pathlen);
+			}
+			break;
+		default:
+			ret = -ENOTSUP;
+			break;
+		}
+		if (type == OWSERVER_DIRALL && len > size) len = size;
+		bool keep = persistent && (flags & OWSERVER_PERSISTENCE);
+		sim_put32(reply, 0);
+		sim_put32(reply + 4, len);
+		sim_put32(reply + 8, ret);
+		sim_put32(reply + 12, keep ? (flags & OWSERVER_PERSISTENCE) : 0);
+		sim_put32(reply + 16, type == OWSERVER_DIRALL ? len - 1 : len);
+		sim_put32(reply + 20, 0);
+		bool sent = write(fd, reply, OWSERVER_HEADER) == OWSERVER_HEADER &&
+			(len == 0 || write(fd, out, len) == len);
+		free(in);
+		free(out);
+		if (!sent || !keep) return;
+	}
+}
+
+#endif // ONEWIRE_HOST
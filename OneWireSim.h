@@ -0,0 +1,397 @@
+#ifndef OneWireSim_h
+#define OneWireSim_h
+
+#include "OneWire.h"
+#include "OneWireDS2482.h"
+#include "OneWireOwserver.h"
+
+#if ONEWIRE_HOST
+
+// In-process simulated 1-Wire bus, for host builds.  OneWireSim is a
+// OneWireBackend, so a OneWire instance given one runs the normal reset(),
+// read_bit(), write_bit() and search() code against virtual devices.
+//
+//    OneWireSim bus;
+//    OneWireSimDS18B20 sensor(0x123456);
+//    bus.attach(sensor);
+//    OneWire ds(bus);
+//
+// Every slot advances the host clock (see util/OneWire_host.h) by the
+// time the same slot takes on real hardware, so micros() reports bus
+// time, and the counters below give the slot cost of each transaction.
+//
+// Overdrive is modelled the way the chips behave: devices switched to
+// overdrive only see overdrive speed slots, the others only see standard
+// speed slots, and a reset at standard speed returns everyone to standard.
+
+class OneWireSim;
+
+// A virtual slave device.  The ROM command layer (Read, Match, Skip and
+// Search ROM) is handled here bit by bit, the way the real chips do it,
+// so several devices on one bus interact correctly during search().
+// Devices only implement their function commands.
+class OneWireSimDevice
+{
+  public:
+    OneWireSimDevice(uint8_t family, uint64_t serial);
+    virtual ~OneWireSimDevice() { }
+
+    uint8_t rom[8];
+
+    // Answers Overdrive Skip and Match ROM (0x3C, 0x69)
+    bool overdrive_capable;
+
+    // Answers Resume ROM (0xA5) after it was the device matched or found
+    bool resume_capable;
+
+  protected:
+    // A reset pulse was seen; forget any function command in progress.
+    virtual void reset(void) { }
+
+    // Each byte written by the master after this device was selected.
+    virtual void write_byte(uint8_t v) = 0;
+
+    // The next byte to send when the master starts reading a byte.
+    virtual uint8_t read_byte(void) { return 0xFF; }
+
+    // A read slot after this device was selected.  The default shifts
+    // out read_byte() LSB first.  Devices which answer single read slots
+    // (conversion busy polling, etc) override this.
+    virtual uint8_t read_function_bit(void);
+
+    // Whether to take part in a Conditional Search (0xEC).
+    virtual bool alarm(void) { return false; }
+
+    // A write 1 slot and a read slot look the same on the wire, and
+    // adapters which work in bytes (DS2480B, DS2482) send both as 1 bits.
+    // Between bytes of a function command the device decides which it
+    // is: true if it expects the master to write the next byte.
+    virtual bool receiving(void) { return true; }
+
+    // The bus this device is attached to, or NULL
+    OneWireSim *bus;
+
+  private:
+    friend class OneWireSim;
+    void reset_pulse(void);
+    void slot_write(uint8_t v);
+    uint8_t slot_read(void);
+    uint8_t slot_one(void);
+    uint8_t rom_bit_value(void) const;
+
+    enum State { IDLE, ROM_COMMAND, READ_ROM, MATCH_ROM, SEARCH_ROM, FUNCTION };
+    State state;
+    bool overdrive;       // currently at overdrive speed
+    bool resume;          // the RC flag: the last device matched or found
+    uint8_t rx, rx_bits;
+    uint8_t tx, tx_bits;
+    uint8_t rom_bit;      // bit position during Read/Match/Search ROM
+    uint8_t search_step;  // 0 = id bit, 1 = complement, 2 = direction
+    OneWireSimDevice *next;
+};
+
+class OneWireSim : public OneWireBackend
+{
+  public:
+    OneWireSim();
+
+    void attach(OneWireSimDevice &dev);
+    void detach(OneWireSimDevice &dev);
+
+    uint8_t reset(void);
+    void write_bit(uint8_t v);
+    uint8_t read_bit(void);
+    bool set_speed(uint8_t speed);
+    bool set_timing(const OneWireTiming *timing);
+
+    // A slot as a byte-level adapter makes it: 0 writes a 0, 1 is a
+    // write 1 or a read slot, whichever each device expects, and the
+    // level sampled is returned.
+    uint8_t touch_bit(uint8_t v);
+
+    // Simulated time, in microseconds
+    uint64_t now(void) const { return onewire_host_clock(); }
+
+    // The analog side of the bus at standard speed.  rise_usec is the
+    // time the pullup takes to raise the bus once it is released, and
+    // hold_usec how long after the falling edge of a read slot devices
+    // hold a 0.  A read samples 0 until the bus has risen, and a slot
+    // started before the bus is high again is lost.  The defaults (0 and
+    // 30) are a short bus where any OneWireTiming preset works.
+    uint8_t rise_usec;
+    uint8_t hold_usec;
+
+    // Noise: if not 0, the master misreads the read slot this many from
+    // now (1 is the next one).  The devices are not affected.
+    uint32_t misread_slot;
+
+    // Counters for profiling.  bus_usec is the total time the bus was
+    // busy with slots, the same as the delays on real hardware.
+    uint32_t resets;
+    uint32_t write_slots;
+    uint32_t read_slots;
+    uint32_t lost_slots;      // started before the bus recovered
+    uint64_t bus_usec;
+    void clear_stats(void);
+
+  private:
+    void elapse(unsigned int usec);
+    bool recovered(void);
+    unsigned int read_usec(void) const {
+        return timing->read_low + timing->read_sample + timing->read_high;
+    }
+    OneWireSimDevice *devices;
+    uint8_t speed;
+    const OneWireTiming *timing;
+    uint64_t ready_at;        // when the bus is high after the last slot
+};
+
+// DS18B20 temperature sensor.  Other family codes with the same
+// scratchpad format (DS1822 0x22, DS28EA00 0x42) may be given.
+class OneWireSimDS18B20 : public OneWireSimDevice
+{
+  public:
+    OneWireSimDS18B20(uint64_t serial, uint8_t family = 0x28);
+
+    // The temperature the next conversion will measure
+    void set_temperature(float celsius);
+
+    // Parasite powered devices answer 0 to Read Power Supply (0xB4)
+    bool parasite;
+
+  protected:
+    void reset(void);
+    void write_byte(uint8_t v);
+    uint8_t read_byte(void);
+    uint8_t read_function_bit(void);
+    bool alarm(void);
+    bool receiving(void);
+
+  private:
+    void update(void);
+    uint32_t conversion_usec(void) const;
+
+    uint8_t scratchpad[9];
+    uint8_t eeprom[3];        // TH, TL, configuration
+    int16_t temperature;      // in 1/16 degree units
+    bool alarm_flag;
+    bool converting;
+    uint8_t command;
+    uint8_t index;
+    uint64_t busy_until;
+};
+
+// DS2408 8-channel addressable switch
+class OneWireSimDS2408 : public OneWireSimDevice
+{
+  public:
+    OneWireSimDS2408(uint64_t serial);
+
+    // Levels applied to the PIO pins from outside (1 = pulled up)
+    void set_inputs(uint8_t levels);
+    uint8_t outputs(void) const { return reg[1]; }
+
+  protected:
+    void reset(void);
+    void write_byte(uint8_t v);
+    uint8_t read_byte(void);
+    bool receiving(void);
+
+  private:
+    uint8_t pio_state(void) const { return inputs & reg[1]; }
+
+    uint8_t reg[8];           // registers 0x88 to 0x8F
+    uint8_t inputs;
+    uint8_t command;
+    uint8_t count;
+    uint16_t address;
+    uint8_t data;
+    uint16_t crc;
+    uint8_t out[3];           // bytes queued for read_byte()
+    uint8_t out_len, out_pos;
+};
+
+// DS2501/DS2502/DS2505 add-only memory, Read Memory (0xF0) with the
+// 8-bit command and data CRCs.
+class OneWireSimDS250x : public OneWireSimDevice
+{
+  public:
+    OneWireSimDS250x(uint64_t serial, uint8_t family = 0x09, uint16_t size = 128);
+    ~OneWireSimDS250x();
+
+    // Program memory, as the factory or a programmer would
+    void program(uint16_t addr, const uint8_t *data, uint16_t len);
+
+  protected:
+    void reset(void);
+    void write_byte(uint8_t v);
+    uint8_t read_byte(void);
+    bool receiving(void);
+
+  private:
+    uint8_t *memory;
+    uint16_t size;
+    uint8_t command;
+    uint8_t count;
+    uint16_t address;
+    uint8_t crc;
+    uint8_t header[3];
+    bool data_crc_sent;
+};
+
+// DS2431 (family 0x2D, 128 bytes, 8 byte scratchpad), DS2433 (0x23, 512
+// bytes) and DS28EC20 (0x43, 2560 bytes) EEPROM: Write, Read and Copy
+// Scratchpad, Read Memory (0xF0), and Extended Read Memory (0xA5) with a
+// CRC16 per page on the DS28EC20.  A copy takes prog_usec, during which
+// the device answers no read slots, then it sends 0xAA.  Slots during a
+// copy are counted in busy_reads: on a real part they take away the
+// programming current.
+class OneWireSimEEPROM : public OneWireSimDevice
+{
+  public:
+    OneWireSimEEPROM(uint64_t serial, uint8_t family = 0x2D);
+    ~OneWireSimEEPROM();
+
+    uint8_t *memory;
+    uint16_t size;
+    uint32_t prog_usec;       // a typical part, under the 10ms maximum
+    uint32_t copies;          // Copy Scratchpads done
+    uint32_t busy_reads;      // bytes read while a copy ran
+
+  protected:
+    void reset(void);
+    void write_byte(uint8_t v);
+    uint8_t read_byte(void);
+    bool receiving(void);
+
+  private:
+    uint8_t scratchpad[32];
+    uint8_t spsize;
+    bool crcs;                // Write and Read Scratchpad send a CRC16
+    uint16_t target;          // TA1, TA2
+    uint8_t es;               // ending offset, PF (0x20) and AA (0x80)
+    uint8_t command;
+    uint8_t count;            // bytes since the command
+    uint16_t address;
+    uint16_t crc;
+    uint8_t out[2];
+    uint8_t out_len, out_pos;
+    uint64_t busy_until;
+};
+
+// DS2480B serial 1-Wire line driver, seen from the serial side: bytes
+// from the host go in, the chip's response bytes come out, and the
+// 1-Wire side is a OneWireSim.  Command mode (reset, single bit, search
+// accelerator, configuration, pulse) and data mode (byte exchange, 0xE3
+// escapes, accelerated search) are modelled; the first 0xC1 after a break
+// or power up is taken as the timing byte, as on the real chip.
+class OneWireSimDS2480B
+{
+  public:
+    OneWireSimDS2480B(OneWireSim &bus);
+
+    // A break on the serial line resets the chip
+    void serial_break(void);
+
+    // Process 'count' bytes from the host.  The responses go in out[],
+    // never more than 'count' bytes, and the number is returned.
+    uint16_t receive(const uint8_t *in, uint16_t count, uint8_t *out);
+
+    // Act as the chip on file descriptor 'fd' (a pty master, etc) until
+    // it is closed or fails.
+    void serve(int fd);
+
+    // The value (0 to 7) of configuration parameter 'p' (1 to 7), all 0
+    // after power up: 3 is the strong pullup duration, 7 for until ended
+    uint8_t parameter(uint8_t p) const { return config[p & 7]; }
+
+  private:
+    void command(uint8_t c, uint8_t *out, uint16_t &n);
+    void data(uint8_t c, uint8_t *out, uint16_t &n);
+    void set_speed(uint8_t code);
+
+    OneWireSim &bus;
+    bool calibrated;
+    bool data_mode;
+    bool escape;              // 0xE3 seen in data mode
+    bool accelerator;
+    uint8_t pulse;            // pulse command running, or 0
+    uint8_t search[16];
+    uint8_t search_len;
+    uint8_t config[8];
+};
+
+// DS2482-100 or DS2482-800 I2C bridge, seen from the I2C side, with
+// OneWireSim buses as its 1-Wire channels.  Give it to OneWireDS2482 in
+// place of a real I2C bus.  Each I2C transfer advances the host clock by
+// its time at 400kHz.  1-Wire commands run on the simulated bus at once,
+// but the busy bit stays set until the host clock reaches the time the
+// command would have finished, so status polling is as on real hardware.
+// Commands sent while busy are not acknowledged.
+class OneWireSimDS2482 : public OneWireI2C
+{
+  public:
+    OneWireSimDS2482(OneWireSim &bus, uint8_t address = 0x18);
+
+    // Make this a DS2482-800, with 'bus' on 'channel' (0 to 7).  Channels
+    // without a bus have no devices.  Channel 0 is the bus given above.
+    void attach(uint8_t channel, OneWireSim &bus);
+
+    bool write(uint8_t addr, const uint8_t *buf, uint8_t len);
+    bool read(uint8_t addr, uint8_t *buf, uint8_t len);
+
+    // The strong pullup is on
+    bool pullup(void) const { return strong; }
+
+    // Status reads which found the chip busy, and commands refused
+    uint32_t busy_polls;
+    uint32_t refused;
+
+  private:
+    void device_reset(void);
+    void one_wire(uint8_t c, uint8_t p);
+    bool busy(void) const;
+
+    OneWireSim *channels[8];
+    bool eight_channel;
+    uint8_t selected;
+    uint8_t address;
+    uint8_t pointer;          // register code, as in Set Read Pointer
+    uint8_t status;
+    uint8_t data;
+    uint8_t config;
+    bool strong;
+    uint64_t busy_until;
+};
+
+// A stand-in for OWFS owserver, serving the devices on a bus through
+// the OneWire code.  It answers DIRALL, READ of "family", "address",
+// "id", "temperature" (DS18x20), "sensed.BYTE" (DS2408) and "memory"
+// (DS250x), and WRITE of "PIO.BYTE" (DS2408) and
+// "/simultaneous/temperature", which converts every sensor at once so
+// the next temperature reads don't convert again.
+class OneWireSimOwserver
+{
+  public:
+    OneWireSimOwserver(OneWire &ds);
+
+    // Answer requests on 'fd' until it is closed.  Without 'persistent'
+    // the connection is closed after each answer, as an owserver which
+    // doesn't grant persistence does.
+    void serve(int fd);
+    bool persistent;
+
+    uint32_t requests;
+
+  private:
+    int32_t dirall(char *out, uint32_t max);
+    int32_t read_path(const char *path, uint8_t *out, uint32_t size, uint32_t offset);
+    int32_t write_path(const char *path, const uint8_t *data, uint32_t size);
+    bool wait_conversion(void);
+
+    OneWire &ds;
+    bool simultaneous;        // a broadcast conversion is still valid
+};
+
+#endif // ONEWIRE_HOST
+#endif // OneWireSim_h
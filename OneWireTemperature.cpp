@@ -0,0 +1,180 @@
+// DS18x20 temperature sensors, see OneWireTemperature.h
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+#include "OneWireTemperature.h"
+
+OneWireTemperature::OneWireTemperature(OneWire &bus) : ow(bus)
+{
+	power = 0;
+	converting = false;
+	start_ms = 0;
+}
+
+bool OneWireTemperature::parasite(void)
+{
+	OneWireLock hold(ow);
+
+	if (!ow.reset()) return false;
+	ow.skip();
+	ow.write(0xB4);         // Read Power Supply
+	// any parasite powered sensor pulls the slot low
+	power = ow.read_bit() ? 1 : 2;
+	return power == 2;
+}
+
+bool OneWireTemperature::start_conversion(void)
+{
+	OneWireLock hold(ow);
+
+	if (power == 0) parasite();
+	if (!ow.reset()) return false;
+	ow.skip();
+	// parasite sensors need the bus powered as soon as the command ends
+	ow.write(0x44, power == 2);
+	start_ms = millis();
+	converting = true;
+	return true;
+}
+
+bool OneWireTemperature::conversion_done(void)
+{
+	if (!converting) return true;
+	if (power == 2) {
+		if (millis() - start_ms < ONEWIRE_CONVERT_MS) return false;
+		ow.depower();
+	} else {
+		// sensors read 0 until they finish
+		if (!ow.read_bit()) return false;
+	}
+	converting = false;
+	return true;
+}
+
+bool OneWireTemperature::convert_all(uint16_t timeout)
+{
+	// held through the conversion, which other traffic would disturb
+	OneWireLock hold(ow);
+
+	if (!start_conversion()) return false;
+	while (!conversion_done()) {
+		if (millis() - start_ms >= timeout) {
+			converting = false;
+			ow.depower();
+			return false;
+		}
+		if (power == 2) delay(1);
+	}
+	return true;
+}
+
+bool OneWireTemperature::read_scratchpad(const uint8_t *rom, uint8_t *data)
+{
+	const uint8_t cmd = 0xBE;       // Read Scratchpad
+
+	// a missing sensor reads as all 1s, which has a bad CRC
+	return ow.transaction(rom ? ONEWIRE_ADDR_MATCH : ONEWIRE_ADDR_SKIP, rom,
+		&cmd, 1, data, 9, ONEWIRE_CHECK_CRC8) == ONEWIRE_OK;
+}
+
+bool OneWireTemperature::read_raw(const uint8_t *rom, int16_t *raw)
+{
+	uint8_t data[9];
+
+	if (!read_scratchpad(rom, data)) return false;
+	*raw = raw_temperature(rom ? rom[0] : 0x28, data);
+	return true;
+}
+
+uint8_t OneWireTemperature::read_all(const uint8_t roms[][8], uint8_t count,
+	int16_t *raw, bool *ok)
+{
+	OneWireLock hold(ow);
+	uint8_t n = 0;
+
+	if (!convert_all()) count = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		bool r = read_raw(roms[i], &raw[i]);
+		if (ok) ok[i] = r;
+		if (r) n++;
+	}
+	return n;
+}
+
+#if ONEWIRE_SEARCH
+bool OneWireTemperature::set_alarm(const uint8_t *rom, int8_t low, int8_t high,
+	bool save)
+{
+	OneWireLock hold(ow);
+	uint8_t address = rom ? ONEWIRE_ADDR_MATCH : ONEWIRE_ADDR_SKIP;
+	uint8_t tx[4], data[9];
+	uint8_t len = 4;
+
+	tx[0] = 0x4E;           // Write Scratchpad: TH, TL, configuration
+	tx[1] = high;
+	tx[2] = low;
+	tx[3] = 0x7F;           // 12 bits
+	if (rom) {
+		if (!read_scratchpad(rom, data)) return false;
+		tx[3] = data[4];
+		if (rom[0] == 0x10) len = 3;    // DS18S20, no configuration
+	}
+	if (ow.transaction(address, rom, tx, len, NULL, 0) != ONEWIRE_OK) return false;
+	if (rom && (!read_scratchpad(rom, data) ||
+	    data[2] != tx[1] || data[3] != tx[2])) {
+		return false;
+	}
+	if (save) {
+		// parasite sensors need the bus powered while they write
+		if (power == 0) parasite();
+		tx[0] = 0x48;           // Copy Scratchpad
+		ow.transaction(address, rom, tx, 1, NULL, 0, ONEWIRE_CHECK_NONE, power == 2);
+		delay(10);
+		ow.depower();
+	}
+	return true;
+}
+
+uint8_t OneWireTemperature::find_alarms(uint8_t roms[][8], uint8_t max, bool convert)
+{
+	OneWireLock hold(ow);
+	OneWireFamilyFilter sensors;
+	OneWireSearchCursor cursor;
+	uint8_t n = 0;
+
+	if (convert && !convert_all()) return 0;
+	// other devices, such as a DS2408, have alarms of their own
+	sensors.include(0x10);
+	sensors.include(0x22);
+	sensors.include(0x28);
+	sensors.include(0x42);
+	while (n < max && ow.search(cursor, roms[n], sensors, false)) {
+#if ONEWIRE_CRC
+		if (OneWire::crc8(roms[n], 7) != roms[n][7]) continue;
+#endif
+		n++;
+	}
+	return n;
+}
+#endif
+
+int16_t OneWireTemperature::raw_temperature(uint8_t family, const uint8_t *data)
+{
+	int16_t raw = (data[1] << 8) | data[0];
+
+	if (family == 0x10) {
+		raw = raw << 3; // 9 bit resolution
+		if (data[7] == 0x10) {
+			// "count remain" gives full 12 bit resolution
+			raw = (raw & 0xFFF0) + 12 - data[6];
+		}
+	} else {
+		uint8_t cfg = (data[4] & 0x60);
+		// at lower res, the low bits are undefined, so let's zero them
+		if (cfg == 0x00) raw = raw & ~7;  // 9 bit resolution, 93.75 ms
+		else if (cfg == 0x20) raw = raw & ~3; // 10 bit res, 187.5 ms
+		else if (cfg == 0x40) raw = raw & ~1; // 11 bit res, 375 ms
+	}
+	return raw;
+}
@@ -0,0 +1,96 @@
+#ifndef OneWireTemperature_h
+#define OneWireTemperature_h
+
+#include "OneWire.h"
+
+// Reading every DS18x20 temperature sensor on a bus (DS18S20, DS18B20,
+// DS1822, DS28EA00).  All the sensors are started together with Skip ROM
+// and Convert T, so a full bus takes one conversion time (750ms at 12
+// bits) rather than one per sensor.  Externally powered sensors hold the
+// bus at 0 during read slots until their conversion is done, so the end
+// is found by polling rather than waiting out the worst case.  Parasite
+// powered sensors can't answer while they need strong pullup power, so
+// if any are present the bus is powered for the full 750ms.
+//
+//    OneWireTemperature temp(ds);
+//    temp.convert_all();
+//    for (i = 0; i < count; i++) {
+//        if (temp.read_raw(roms[i], &raw)) celsius = raw / 16.0;
+//    }
+//
+// For exception reporting, give the sensors alarm thresholds once, then
+// ask only for the ones outside them:
+//
+//    for (i = 0; i < count; i++) temp.set_alarm(roms[i], 5, 30);
+//    ...
+//    n = temp.find_alarms(hot, 8);    // convert, then Conditional Search
+//
+// Each call holds the bus (see OneWireLock) for all its steps, and
+// convert_all() and read_all() for the whole conversion.  Between
+// start_conversion() and conversion_done() another task may use the bus
+// unless the caller holds it.
+
+// Worst case conversion time, 12 bit resolution
+#define ONEWIRE_CONVERT_MS  750
+
+class OneWireTemperature
+{
+  public:
+    OneWireTemperature(OneWire &bus);
+
+    // Ask every sensor whether it is parasite powered (Read Power Supply).
+    // start_conversion() does this itself the first time.
+    bool parasite(void);
+
+    // Start a conversion on every sensor.  Returns false if no device
+    // answered the reset.
+    bool start_conversion(void);
+
+    // Returns true once the conversion started by start_conversion() has
+    // finished, or if none was started.  Each call costs one read slot.
+    bool conversion_done(void);
+
+    // Start a conversion on every sensor and wait for them to finish.
+    // Returns false if there are no devices or 'timeout' ms pass first.
+    bool convert_all(uint16_t timeout = 1000);
+
+    // Read the 9 byte scratchpad of one sensor, or of the only device on
+    // the bus if 'rom' is NULL.  Returns false if the CRC is wrong.
+    bool read_scratchpad(const uint8_t *rom, uint8_t *data);
+
+    // Read the temperature of one sensor, in 1/16 degree C units.
+    bool read_raw(const uint8_t *rom, int16_t *raw);
+
+    // convert_all() and then read_raw() for each of 'count' sensors.
+    // Returns the number read with a good CRC, sets ok[i] if not NULL.
+    uint8_t read_all(const uint8_t roms[][8], uint8_t count, int16_t *raw,
+                     bool *ok = NULL);
+
+#if ONEWIRE_SEARCH
+    // Set the alarm thresholds of one sensor, or of every sensor with Skip
+    // ROM if 'rom' is NULL, in whole degrees C.  A conversion which
+    // measures 'high' or more, or 'low' or less, puts a sensor in alarm.
+    // One sensor keeps its resolution, with Skip ROM they are all set to
+    // 12 bits.  With 'save' the thresholds are also copied to EEPROM.
+    bool set_alarm(const uint8_t *rom, int8_t low, int8_t high, bool save = false);
+
+    // Find the sensors in alarm with a Conditional Search, putting up to
+    // 'max' ROMs in roms[].  Only sensors in alarm answer it, so this costs
+    // a search pass per alarm, however many sensors there are.  With
+    // 'convert' they all convert first (convert_all()).
+    uint8_t find_alarms(uint8_t roms[][8], uint8_t max, bool convert = true);
+#endif
+
+    // Scratchpad to 1/16 degree C units, for family 'family'.  The low
+    // bits that are undefined at lower resolution are cleared.
+    static int16_t raw_temperature(uint8_t family, const uint8_t *data);
+    static float celsius(int16_t raw) { return (float)raw / 16.0f; }
+
+  private:
+    OneWire &ow;
+    uint8_t power;        // 0 = unknown, 1 = external, 2 = parasite
+    bool converting;
+    unsigned long start_ms;
+};
+
+#endif
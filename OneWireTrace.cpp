@@ -0,0 +1,97 @@
+// Bus primitive recorder, see OneWireTrace.h
+
+#include "OneWire.h"
+#include "OneWireTrace.h"
+
+void OneWireTrace::clear(void)
+{
+	head = 0;
+	total = 0;
+	paused = false;
+	stop_on_error = false;
+}
+
+void OneWireTrace::add(uint8_t op, uint8_t value)
+{
+	if (paused) return;
+	OneWireTraceEntry &e = entries[head];
+	e.usec = micros();
+	e.op = op;
+	e.value = value;
+	if (++head >= ONEWIRE_TRACE_SIZE) head = 0;
+	total++;
+}
+
+void OneWireTrace::add_bytes(uint8_t op, const uint8_t *buf, uint16_t count)
+{
+	while (count--) add(op, *buf++);
+}
+
+uint16_t OneWireTrace::count(void) const
+{
+	return (total < ONEWIRE_TRACE_SIZE) ? total : ONEWIRE_TRACE_SIZE;
+}
+
+const OneWireTraceEntry & OneWireTrace::get(uint16_t i) const
+{
+	uint16_t n = count();
+	uint16_t first = (head + ONEWIRE_TRACE_SIZE - n) % ONEWIRE_TRACE_SIZE;
+	return entries[(first + i) % ONEWIRE_TRACE_SIZE];
+}
+
+void OneWireTrace::format(const OneWireTraceEntry &e, char *line)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	char digits[10];
+	uint8_t n = 0;
+	uint32_t t = e.usec;
+
+	do {
+		digits[n++] = '0' + t % 10;
+		t /= 10;
+	} while (t);
+	while (n) *line++ = digits[--n];
+	*line++ = ' ';
+	*line++ = e.op;
+	*line++ = ' ';
+	*line++ = hex[e.value >> 4];
+	*line++ = hex[e.value & 15];
+	*line = 0;
+}
+
+static int8_t hex_digit(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+bool OneWireTrace::parse(const char *line, OneWireTraceEntry *e)
+{
+	uint32_t t = 0;
+	int8_t hi, lo;
+
+	while (*line == ' ' || *line == '\t') line++;
+	if (*line < '0' || *line > '9') return false;
+	while (*line >= '0' && *line <= '9') t = t * 10 + (*line++ - '0');
+	if (*line++ != ' ') return false;
+	switch (*line) {
+	case ONEWIRE_TRACE_RESET:
+	case ONEWIRE_TRACE_WRITE_BIT:
+	case ONEWIRE_TRACE_READ_BIT:
+	case ONEWIRE_TRACE_WRITE_BYTE:
+	case ONEWIRE_TRACE_READ_BYTE:
+		break;
+	default:
+		return false;
+	}
+	e->op = *line++;
+	if (*line++ != ' ') return false;
+	hi = hex_digit(line[0]);
+	lo = hex_digit(line[1]);
+	if (hi < 0 || lo < 0) return false;
+	e->usec = t;
+	e->value = (hi << 4) | lo;
+	return true;
+}
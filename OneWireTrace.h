@@ -0,0 +1,79 @@
+#ifndef OneWireTrace_h
+#define OneWireTrace_h
+
+#include <stdint.h>
+
+// A record of the bus primitives, for finding out what happened on the
+// wire when a unit in the field reports errors.  With ONEWIRE_TRACE set
+// to 1, each OneWire keeps the last ONEWIRE_TRACE_SIZE resets, bits and
+// bytes in trace, with the micros() when each was done and the value
+// written or read:
+//
+//    if (ds.transaction(...) == ONEWIRE_CRC_ERROR) {
+//        char line[ONEWIRE_TRACE_LINE];
+//        for (uint16_t i = 0; i < ds.trace.count(); i++) {
+//            OneWireTrace::format(ds.trace.get(i), line);
+//            Serial.println(line);
+//        }
+//    }
+//
+// Each entry costs a micros() call, made outside the slots.  Setting
+// stop_on_error keeps the entries leading up to the first CRC error, for
+// reading out later.  The lines can be fed to OneWireReplay on a host,
+// see extras/host/trace_replay.cpp.
+
+// Entries kept, the oldest is overwritten
+#ifndef ONEWIRE_TRACE_SIZE
+#define ONEWIRE_TRACE_SIZE 64
+#endif
+
+// Room format() needs
+#define ONEWIRE_TRACE_LINE 16
+
+// Entry types, also the letter used by format()
+#define ONEWIRE_TRACE_RESET       'P'   // value is the presence pulse
+#define ONEWIRE_TRACE_WRITE_BIT   'w'
+#define ONEWIRE_TRACE_READ_BIT    'r'
+#define ONEWIRE_TRACE_WRITE_BYTE  'W'
+#define ONEWIRE_TRACE_READ_BYTE   'R'
+
+struct OneWireTraceEntry
+{
+    uint32_t usec;
+    uint8_t op;
+    uint8_t value;
+};
+
+class OneWireTrace
+{
+  public:
+    OneWireTrace() { clear(); }
+
+    void clear(void);
+    void add(uint8_t op, uint8_t value);
+    void add_bytes(uint8_t op, const uint8_t *buf, uint16_t count);
+
+    // Entries held, and entry i of them, oldest first
+    uint16_t count(void) const;
+    const OneWireTraceEntry &get(uint16_t i) const;
+
+    // Entries added since clear(), including those overwritten
+    uint32_t total;
+
+    // Stop adding entries when true.  stop_on_error sets it at the
+    // first CRC error.
+    bool paused;
+    bool stop_on_error;
+
+    // "123456 W 3C": the time, the entry type and the value in hex.
+    // 'line' needs ONEWIRE_TRACE_LINE bytes.  parse() reads the same,
+    // and returns false if it isn't an entry.
+    static void format(const OneWireTraceEntry &e, char *line);
+    static bool parse(const char *line, OneWireTraceEntry *e);
+
+  private:
+    OneWireTraceEntry entries[ONEWIRE_TRACE_SIZE];
+    uint16_t head;
+};
+
+#endif
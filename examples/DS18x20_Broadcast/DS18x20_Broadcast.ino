@@ -0,0 +1,56 @@
+#include <OneWire.h>
+#include <OneWireTemperature.h>
+
+// OneWire DS18S20, DS18B20, DS1822 Temperature Example, all sensors at once
+//
+// DS18x20_Temperature converts each sensor in turn, waiting a full second
+// for each.  Here every sensor converts together, and the wait ends as
+// soon as the slowest one is done (750ms at the default 12 bit resolution).
+
+OneWire  ds(10);  // on pin 10 (a 4.7K resistor is necessary)
+OneWireTemperature temp(ds);
+
+#define MAX_SENSORS 16
+byte addr[MAX_SENSORS][8];
+byte count = 0;
+
+void setup(void) {
+  Serial.begin(9600);
+  ds.reset_search();
+  while (count < MAX_SENSORS && ds.search(addr[count])) {
+    if (OneWire::crc8(addr[count], 7) != addr[count][7]) continue;
+    if (addr[count][0] == 0x10 || addr[count][0] == 0x28 || addr[count][0] == 0x22) {
+      count++;
+    }
+  }
+  Serial.print(count);
+  Serial.println(" sensors");
+  if (temp.parasite()) Serial.println("Some sensors are parasite powered");
+}
+
+void loop(void) {
+  int16_t raw[MAX_SENSORS];
+  bool ok[MAX_SENSORS];
+  unsigned long start = millis();
+
+  temp.read_all(addr, count, raw, ok);
+  for (byte i = 0; i < count; i++) {
+    Serial.print("ROM =");
+    for (byte j = 0; j < 8; j++) {
+      Serial.write(' ');
+      Serial.print(addr[i][j], HEX);
+    }
+    if (ok[i]) {
+      Serial.print("  Temperature = ");
+      Serial.print(OneWireTemperature::celsius(raw[i]));
+      Serial.println(" Celsius");
+    } else {
+      Serial.println("  CRC is not valid!");
+    }
+  }
+  Serial.print("All sensors read in ");
+  Serial.print(millis() - start);
+  Serial.println(" ms");
+  Serial.println();
+  delay(1000);
+}
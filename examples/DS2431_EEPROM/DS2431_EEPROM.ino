@@ -0,0 +1,57 @@
+#include <OneWire.h>
+#include <OneWireEEPROM.h>
+
+// OneWire DS2431, DS2433, DS28EC20 EEPROM Example
+//
+// Writes a block of data to every EEPROM tag on the bus, reads it back
+// and compares.  The writes go a page at a time through the scratchpad,
+// each copy with the bus powered until it is done.
+
+OneWire  ds(10);  // on pin 10 (a 4.7K resistor is necessary)
+OneWireEEPROM eeprom(ds);
+
+byte data[64];
+
+void setup(void) {
+  Serial.begin(9600);
+  for (byte i = 0; i < sizeof(data); i++) data[i] = i;
+}
+
+void loop(void) {
+  byte addr[8];
+  byte back[sizeof(data)];
+
+  if (!ds.search(addr)) {
+    ds.reset_search();
+    delay(5000);
+    return;
+  }
+  if (OneWire::crc8(addr, 7) != addr[7]) return;
+  if (OneWireEEPROM::memory_size(addr[0]) == 0) return;
+
+  Serial.print("ROM =");
+  for (byte i = 0; i < 8; i++) {
+    Serial.write(' ');
+    Serial.print(addr[i], HEX);
+  }
+  Serial.print("  ");
+  Serial.print(OneWireEEPROM::memory_size(addr[0]));
+  Serial.println(" bytes");
+
+  unsigned long start = millis();
+  if (!eeprom.write(addr, 0, data, sizeof(data))) {
+    Serial.println("  write failed");
+    return;
+  }
+  Serial.print("  wrote ");
+  Serial.print(sizeof(data));
+  Serial.print(" bytes in ");
+  Serial.print(millis() - start);
+  Serial.println(" ms");
+
+  if (!eeprom.read(addr, 0, back, sizeof(back)) || memcmp(back, data, sizeof(data)) != 0) {
+    Serial.println("  read back failed");
+  } else {
+    Serial.println("  read back ok");
+  }
+}
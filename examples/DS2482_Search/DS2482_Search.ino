@@ -0,0 +1,71 @@
+#include <Wire.h>
+#include <OneWire.h>
+#include <OneWireDS2482.h>
+
+// OneWire search through a DS2482 I2C bridge
+//
+// The DS2482 does the 1-Wire timing, so nothing here is timing critical
+// and interrupts are never turned off.  Each search step (two read slots
+// and a write slot) is a single "triplet" command to the chip.  On a
+// DS2482-800, every channel is searched in turn.
+//
+// On AVR boards the library has to be built with ONEWIRE_BACKEND defined
+// to 1 (in the build flags, or at the top of OneWire.h).  Without it
+// this sketch only says so.
+
+#if ONEWIRE_BACKEND
+
+OneWireWire<TwoWire> i2c(Wire);
+OneWireDS2482 bridge(i2c);   // AD0, AD1 (and AD2) low: address 0x18
+OneWire ds(bridge);
+
+void setup(void) {
+  Serial.begin(9600);
+  Wire.begin();
+  Wire.setClock(400000);
+  if (!bridge.begin()) Serial.println("No DS2482 at 0x18");
+}
+
+void search_channel(void) {
+  byte addr[8];
+
+  ds.reset_search();
+  while (ds.search(addr)) {
+    Serial.print("  ROM =");
+    for (byte i = 0; i < 8; i++) {
+      Serial.write(' ');
+      Serial.print(addr[i], HEX);
+    }
+    if (OneWire::crc8(addr, 7) != addr[7]) Serial.print("  CRC is not valid!");
+    Serial.println();
+  }
+}
+
+void loop(void) {
+  if (bridge.select_channel(0)) {
+    for (byte ch = 0; ch < 8; ch++) {
+      bridge.select_channel(ch);
+      Serial.print("Channel ");
+      Serial.println(ch);
+      search_channel();
+    }
+  } else {
+    // a DS2482-100, only one bus
+    search_channel();
+  }
+  Serial.println();
+  delay(5000);
+}
+
+#else
+
+void setup(void) {
+  Serial.begin(9600);
+}
+
+void loop(void) {
+  Serial.println("OneWireDS2482 needs ONEWIRE_BACKEND defined to 1");
+  delay(5000);
+}
+
+#endif
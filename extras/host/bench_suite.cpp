@@ -0,0 +1,372 @@
+// Benchmarks for tracking performance from release to release, written
+// as JSON on stdout:
+//
+//    crc      OneWire::crc8() and crc16() throughput at several sizes,
+//             for the CRC8 method this build uses (ONEWIRE_CRC8_TABLE)
+//    search   a full search() of 1 to 1000 simulated DS18B20s: resets,
+//             slots and bus time, and the host time the driver took
+//    family_search
+//             20 wanted devices among 200 others, found by searching
+//             the whole bus and by a search with an OneWireFamilyFilter
+//    poll     DS18B20s read per second of bus time, as the
+//             DS18x20_Temperature example does it (one sensor per loop,
+//             each converted on its own) and with OneWireTemperature
+//             (one broadcast conversion, then each scratchpad), and
+//             with a conversion and an alarm search which finds the one
+//             sensor out of range
+//    eeprom   a DS28EC20 (2560 bytes) written a page at a time with
+//             Match ROM, a read back and a fixed 10ms for each copy,
+//             then with OneWireEEPROM, and read with OneWireEEPROM
+//
+//    bench_suite [quick]
+//
+// "quick" stops the search at 100 devices and does less CRC work, for
+// "make run".  The Makefile also builds bench_suite_bitcrc, with the
+// bitwise CRC8, for comparing the two.
+//
+// Exits non-zero if a search misses a device or a sensor reads wrong.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "OneWire.h"
+#include "OneWireSim.h"
+#include "OneWireTemperature.h"
+#include "OneWireEEPROM.h"
+
+static int failures = 0;
+
+static void fail(const char *what)
+{
+  fprintf(stderr, "FAILED: %s\n", what);
+  failures++;
+}
+
+static double seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// bytes per second through crc8() or crc16() at 'size'
+static double crc_rate(bool crc16, uint32_t size, double work)
+{
+  static uint8_t buf[8192];
+  volatile uint16_t sink = 0;
+  uint32_t rounds = work / size + 1;
+  double start = seconds();
+
+  for (uint32_t i = 0; i < sizeof(buf); i++) buf[i] = i * 37 + 11;
+  for (uint32_t r = 0; r < rounds; r++) {
+    buf[r % size] ^= r;
+    if (crc16) sink = sink + OneWire::crc16(buf, size);
+    else sink = sink + OneWire::crc8(buf, size);
+  }
+  double sec = seconds() - start;
+  (void)sink;
+  return sec > 0 ? (double)rounds * size / sec : 0;
+}
+
+static void bench_crc(bool quick)
+{
+  static const uint32_t sizes8[] = { 8, 9, 32, 128, 255 };
+  static const uint32_t sizes16[] = { 9, 32, 128, 1024, 8192 };
+  double work = quick ? 2e6 : 32e6;
+  bool first = true;
+
+  printf("  \"crc\": [\n");
+  for (uint8_t i = 0; i < 5; i++) {
+    printf("%s    {\"function\": \"crc8\", \"size\": %u, \"bytes_per_sec\": %.0f}",
+      first ? "" : ",\n", (unsigned)sizes8[i], crc_rate(false, sizes8[i], work));
+    first = false;
+  }
+  for (uint8_t i = 0; i < 5; i++) {
+    printf(",\n    {\"function\": \"crc16\", \"size\": %u, \"bytes_per_sec\": %.0f}",
+      (unsigned)sizes16[i], crc_rate(true, sizes16[i], work));
+  }
+  printf("\n  ],\n");
+}
+
+static void bench_search(bool quick)
+{
+  static const uint16_t populations[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+  bool first = true;
+
+  printf("  \"search\": [\n");
+  for (uint8_t p = 0; p < sizeof(populations) / sizeof(populations[0]); p++) {
+    uint16_t n = populations[p];
+    if (quick && n > 100) break;
+
+    OneWireSim bus;
+    OneWire ds(bus);
+    OneWireSimDS18B20 **devices = (OneWireSimDS18B20 **)malloc(n * sizeof(*devices));
+    uint8_t rom[8];
+    uint16_t found = 0;
+
+    // serials spread over the whole range, the same on every run
+    srand(n);
+    for (uint16_t i = 0; i < n; i++) {
+      uint64_t serial = ((uint64_t)rand() << 32 | (uint32_t)rand()) & 0xFFFFFFFFFFFFull;
+      devices[i] = new OneWireSimDS18B20(serial);
+      bus.attach(*devices[i]);
+    }
+    bus.clear_stats();
+    double start = seconds();
+    ds.reset_search();
+    while (ds.search(rom)) {
+      if (OneWire::crc8(rom, 7) != rom[7]) fail("search ROM CRC");
+      found++;
+    }
+    double host = seconds() - start;
+    if (found != n) fail("search count");
+    printf("%s    {\"devices\": %u, \"found\": %u, \"resets\": %u, \"write_slots\": %u, "
+      "\"read_slots\": %u, \"bus_usec\": %llu, \"bus_usec_per_device\": %.1f, "
+      "\"host_usec\": %.1f}",
+      first ? "" : ",\n", n, found, (unsigned)bus.resets, (unsigned)bus.write_slots,
+      (unsigned)bus.read_slots, (unsigned long long)bus.bus_usec,
+      (double)bus.bus_usec / n, host * 1e6);
+    first = false;
+    for (uint16_t i = 0; i < n; i++) {
+      bus.detach(*devices[i]);
+      delete devices[i];
+    }
+    free(devices);
+  }
+  printf("\n  ],\n");
+}
+
+// A mixed bus: 16 DS18B20s and 4 DS2408s wanted, 120 DS1990A iButtons
+// and 80 DS2431 EEPROMs not.  Only the family codes matter to a search,
+// so they are all simulated as DS18B20s.
+static void bench_family_search(void)
+{
+  static const uint8_t families[4] = { 0x28, 0x29, 0x01, 0x2D };
+  static const uint8_t counts[4] = { 16, 4, 120, 80 };
+  OneWireSim bus;
+  OneWire ds(bus);
+  OneWireSimDS18B20 *devices[220];
+  OneWireFamilyFilter want;
+  uint8_t rom[8];
+  uint16_t n = 0;
+
+  srand(220);
+  for (uint8_t f = 0; f < 4; f++) {
+    for (uint8_t i = 0; i < counts[f]; i++) {
+      uint64_t serial = ((uint64_t)rand() << 32 | (uint32_t)rand()) & 0xFFFFFFFFFFFFull;
+      devices[n] = new OneWireSimDS18B20(serial, families[f]);
+      bus.attach(*devices[n++]);
+    }
+  }
+  want.include(0x28);
+  want.include(0x29);
+
+  printf("  \"family_search\": [\n");
+  for (uint8_t filtered = 0; filtered < 2; filtered++) {
+    uint16_t found = 0;
+    bus.clear_stats();
+    double start = seconds();
+    ds.reset_search();
+    while (filtered ? ds.search(rom, want) : ds.search(rom)) {
+      if (want.contains(rom[0])) found++;
+      else if (filtered) fail("family search, wrong family");
+    }
+    double host = seconds() - start;
+    if (found != 20) fail("family search count");
+    printf("%s    {\"method\": \"%s\", \"devices\": %u, \"wanted\": %u, \"resets\": %u, "
+      "\"write_slots\": %u, \"read_slots\": %u, \"bus_usec\": %llu, \"host_usec\": %.1f}",
+      filtered ? ",\n" : "", filtered ? "filter" : "all", n, found, (unsigned)bus.resets,
+      (unsigned)bus.write_slots, (unsigned)bus.read_slots,
+      (unsigned long long)bus.bus_usec, host * 1e6);
+  }
+  printf("\n  ],\n");
+  for (uint16_t i = 0; i < n; i++) {
+    bus.detach(*devices[i]);
+    delete devices[i];
+  }
+}
+
+// The loop() of examples/DS18x20_Temperature, without the printing.
+// Returns true if a sensor was read, false at the end of the search.
+static bool example_loop(OneWire &ds, int16_t *raw)
+{
+  uint8_t addr[8], data[9];
+
+  if (!ds.search(addr)) {
+    ds.reset_search();
+    delay(250);
+    return false;
+  }
+  if (OneWire::crc8(addr, 7) != addr[7]) return true;
+  ds.reset();
+  ds.select(addr);
+  ds.write(0x44, 1);
+  delay(1000);
+  ds.reset();
+  ds.select(addr);
+  ds.write(0xBE);
+  for (uint8_t i = 0; i < 9; i++) data[i] = ds.read();
+  if (OneWire::crc8(data, 8) != data[8]) fail("example scratchpad CRC");
+  *raw = (data[1] << 8) | data[0];
+  return true;
+}
+
+static void bench_poll(void)
+{
+  static const uint8_t counts[] = { 1, 4, 16 };
+  bool first = true;
+
+  printf("  \"poll\": [\n");
+  for (uint8_t c = 0; c < sizeof(counts); c++) {
+    uint8_t n = counts[c];
+    OneWireSim bus;
+    OneWire ds(bus);
+    OneWireTemperature temp(ds);
+    OneWireSimDS18B20 *sensors[16];
+    uint8_t roms[16][8];
+    int16_t raw[16];
+
+    for (uint8_t i = 0; i < n; i++) {
+      sensors[i] = new OneWireSimDS18B20(0x1000 + i * 0x101);
+      sensors[i]->set_temperature(20.0f + i);
+      bus.attach(*sensors[i]);
+      memcpy(roms[i], sensors[i]->rom, 8);
+    }
+
+    // the example: one pass of the search, a sensor per loop()
+    uint64_t start = bus.now();
+    uint8_t read = 0;
+    int16_t value = 0;
+    ds.reset_search();
+    while (example_loop(ds, &value)) {
+      read++;
+      if (value < 20 * 16 || value >= (20 + n) * 16) fail("example temperature");
+    }
+    if (read != n) fail("example count");
+    double sec = (bus.now() - start) * 1e-6;
+    printf("%s    {\"workflow\": \"example\", \"sensors\": %u, \"sim_sec\": %.3f, "
+      "\"sensors_per_sec\": %.2f}",
+      first ? "" : ",\n", n, sec, n / sec);
+    first = false;
+
+    // OneWireTemperature: one conversion for all of them
+    start = bus.now();
+    if (temp.read_all(roms, n, raw) != n) fail("read_all");
+    for (uint8_t i = 0; i < n; i++) {
+      if (raw[i] != (20 + i) * 16) fail("read_all temperature");
+    }
+    sec = (bus.now() - start) * 1e-6;
+    printf(",\n    {\"workflow\": \"read_all\", \"sensors\": %u, \"sim_sec\": %.3f, "
+      "\"sensors_per_sec\": %.2f}", n, sec, n / sec);
+
+    // alarms: one sensor outside its thresholds, found by a conversion
+    // and a Conditional Search, without reading the others
+    uint8_t alarms[16][8];
+    for (uint8_t i = 0; i < n; i++) temp.set_alarm(roms[i], 0, 20 + n);
+    sensors[n - 1]->set_temperature(40.0f);
+    start = bus.now();
+    if (temp.find_alarms(alarms, 16) != 1 || memcmp(alarms[0], roms[n - 1], 8) != 0) {
+      fail("alarm search");
+    }
+    sec = (bus.now() - start) * 1e-6;
+    printf(",\n    {\"workflow\": \"alarm_search\", \"sensors\": %u, \"sim_sec\": %.3f, "
+      "\"sensors_per_sec\": %.2f}", n, sec, n / sec);
+
+    for (uint8_t i = 0; i < n; i++) {
+      bus.detach(*sensors[i]);
+      delete sensors[i];
+    }
+  }
+  printf("\n  ],\n");
+}
+
+// One DS28EC20 page the way a sketch would do it by hand
+static bool naive_page(OneWire &ds, const uint8_t *rom, uint16_t addr, const uint8_t *data)
+{
+  uint8_t cmd[3] = { 0x0F, (uint8_t)addr, (uint8_t)(addr >> 8) }, sp[37];
+
+  ds.reset();
+  ds.select(rom);
+  ds.write_bytes(cmd, 3);
+  ds.write_bytes(data, 32);
+  ds.read_bytes(sp, 2);
+  ds.reset();
+  ds.select(rom);
+  ds.write(0xAA);
+  ds.read_bytes(sp, 37);
+  if (sp[0] != cmd[1] || sp[1] != cmd[2] || memcmp(sp + 3, data, 32) != 0) return false;
+  ds.reset();
+  ds.select(rom);
+  ds.write(0x55);
+  ds.write_bytes(sp, 3, 1);
+  delay(10);
+  ds.depower();
+  return true;
+}
+
+static void bench_eeprom(void)
+{
+  OneWireSim bus;
+  OneWire ds(bus);
+  OneWireEEPROM eeprom(ds);
+  OneWireSimEEPROM tag(0x0EC20, 0x43);
+  static uint8_t image[2560], back[2560];
+  uint64_t start;
+  double sec;
+
+  for (uint16_t i = 0; i < sizeof(image); i++) image[i] = i * 13 + (i >> 8);
+  bus.attach(tag);
+
+  bus.clear_stats();
+  start = bus.now();
+  for (uint16_t addr = 0; addr < sizeof(image); addr += 32) {
+    if (!naive_page(ds, tag.rom, addr, image + addr)) fail("naive EEPROM page");
+  }
+  sec = (bus.now() - start) * 1e-6;
+  if (memcmp(tag.memory, image, sizeof(image)) != 0) fail("naive EEPROM write");
+  printf("  \"eeprom\": [\n");
+  printf("    {\"operation\": \"write\", \"method\": \"naive\", \"bytes\": %u, \"resets\": %u, "
+    "\"sim_sec\": %.3f, \"bytes_per_sec\": %.0f},\n",
+    (unsigned)sizeof(image), (unsigned)bus.resets, sec, sizeof(image) / sec);
+
+  for (uint16_t i = 0; i < sizeof(image); i++) image[i] ^= 0x5A;
+  bus.clear_stats();
+  start = bus.now();
+  if (!eeprom.write(tag.rom, 0, image, sizeof(image)) ||
+      memcmp(tag.memory, image, sizeof(image)) != 0) {
+    fail("EEPROM write");
+  }
+  sec = (bus.now() - start) * 1e-6;
+  printf("    {\"operation\": \"write\", \"method\": \"OneWireEEPROM\", \"bytes\": %u, \"resets\": %u, "
+    "\"sim_sec\": %.3f, \"bytes_per_sec\": %.0f},\n",
+    (unsigned)sizeof(image), (unsigned)bus.resets, sec, sizeof(image) / sec);
+
+  bus.clear_stats();
+  start = bus.now();
+  if (!eeprom.read(tag.rom, 0, back, sizeof(back)) || memcmp(back, image, sizeof(back)) != 0) {
+    fail("EEPROM read");
+  }
+  sec = (bus.now() - start) * 1e-6;
+  printf("    {\"operation\": \"read\", \"method\": \"OneWireEEPROM\", \"bytes\": %u, \"resets\": %u, "
+    "\"sim_sec\": %.3f, \"bytes_per_sec\": %.0f}\n",
+    (unsigned)sizeof(back), (unsigned)bus.resets, sec, sizeof(back) / sec);
+  printf("  ]\n");
+  bus.detach(tag);
+}
+
+int main(int argc, char **argv)
+{
+  bool quick = (argc > 1 && strcmp(argv[1], "quick") == 0);
+
+  printf("{\n");
+  printf("  \"config\": {\"crc8_table\": %s, \"quick\": %s, \"compiler\": \"%s\"},\n",
+    ONEWIRE_CRC8_TABLE ? "true" : "false", quick ? "true" : "false", __VERSION__);
+  bench_crc(quick);
+  bench_search(quick);
+  bench_family_search();
+  bench_poll();
+  bench_eeprom();
+  printf("}\n");
+  return failures ? 1 : 0;
+}
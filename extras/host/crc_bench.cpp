@@ -0,0 +1,106 @@
+// Compare the OneWireCRC kernels: check that every kernel gives the same
+// CRC8 and CRC16 as OneWire::crc8() and OneWire::crc16(), then report the
+// throughput of each at a range of input sizes.
+//
+// Exits non-zero if any kernel disagrees.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "OneWire.h"
+#include "OneWireCRC.h"
+
+static int failures = 0;
+
+static double seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// the reference: the microcontroller code, in chunks its lengths allow
+static uint8_t ref_crc8(const uint8_t *p, size_t len, uint8_t crc)
+{
+  while (len > 255) {
+    crc = OneWire::crc8(p, 255, crc);
+    p += 255;
+    len -= 255;
+  }
+  return OneWire::crc8(p, len, crc);
+}
+
+static uint16_t ref_crc16(const uint8_t *p, size_t len, uint16_t crc)
+{
+  while (len > 0xFFFF) {
+    crc = OneWire::crc16(p, 0xFFFF, crc);
+    p += 0xFFFF;
+    len -= 0xFFFF;
+  }
+  return OneWire::crc16(p, len, crc);
+}
+
+int main(int argc, char **argv)
+{
+  static const size_t sizes[] = { 9, 32, 128, 1024, 8192, 65536, 1048576 };
+  const size_t nsizes = sizeof(sizes) / sizeof(sizes[0]);
+  const size_t maxsize = sizes[nsizes - 1];
+  // total bytes checksummed per kernel and size, more for a steadier result
+  const double work = (argc > 1) ? atof(argv[1]) * 1e6 : 8e6;
+  uint8_t *buf = (uint8_t *)malloc(maxsize + 64);
+  uint8_t k;
+
+  srand(1);
+  for (size_t i = 0; i < maxsize + 64; i++) buf[i] = rand();
+
+  // every length up to 300 at every alignment, plus the large sizes
+  for (k = ONEWIRE_CRC_BASIC; k < ONEWIRE_CRC_KERNELS; k++) {
+    if (!OneWireCRC::select(k)) continue;
+    for (size_t len = 0; len <= 300 + nsizes; len++) {
+      size_t n = (len <= 300) ? len : sizes[len - 301];
+      for (size_t align = 0; align < 16; align++) {
+        uint8_t seed8 = len * 7 + align;
+        uint16_t seed16 = len * 1009 + align;
+        if (OneWireCRC::crc8(buf + align, n, seed8) != ref_crc8(buf + align, n, seed8) ||
+          OneWireCRC::crc16(buf + align, n, seed16) != ref_crc16(buf + align, n, seed16)) {
+          printf("FAILED: %s kernel, %zu bytes at offset %zu\n",
+            OneWireCRC::name(k), n, align);
+          failures++;
+          align = 16;
+          len = 300 + nsizes;
+        }
+      }
+    }
+  }
+
+  printf("%-8s %-7s", "crc", "kernel");
+  for (size_t s = 0; s < nsizes; s++) printf(" %9zu", sizes[s]);
+  printf("   (MB/s at each input size)\n");
+  for (int width = 8; width <= 16; width += 8) {
+    for (k = ONEWIRE_CRC_BASIC; k < ONEWIRE_CRC_KERNELS; k++) {
+      if (!OneWireCRC::select(k)) continue;
+      printf("%-8s %-7s", width == 8 ? "crc8" : "crc16", OneWireCRC::name(k));
+      for (size_t s = 0; s < nsizes; s++) {
+        size_t reps = (size_t)(work / sizes[s]) + 1;
+        volatile uint16_t sink = 0;
+        double t = seconds();
+        for (size_t r = 0; r < reps; r++) {
+          if (width == 8) {
+            sink ^= OneWireCRC::crc8(buf, sizes[s], (uint8_t)r);
+          } else {
+            sink ^= OneWireCRC::crc16(buf, sizes[s], (uint16_t)r);
+          }
+        }
+        t = seconds() - t;
+        printf(" %9.0f", t > 0 ? reps * sizes[s] / t / 1e6 : 0.0);
+      }
+      printf("\n");
+    }
+  }
+  OneWireCRC::select(ONEWIRE_CRC_AUTO);
+  printf("auto selects: %s\n", OneWireCRC::name(OneWireCRC::selected()));
+
+  free(buf);
+  return failures ? 1 : 0;
+}
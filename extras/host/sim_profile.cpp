@@ -0,0 +1,838 @@
+// Run the transactions from the examples/ sketches against the simulated
+// bus, and report the slot count and bus time each one costs.
+//
+// Exits non-zero if any transaction returns data the virtual devices did
+// not send, so a build box can catch regressions as well as slowdowns.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "OneWire.h"
+#include "OneWireSim.h"
+#include "OneWireAsync.h"
+#include "OneWireTemperature.h"
+#include "OneWireCache.h"
+#include "OneWireCalibration.h"
+#include "OneWireEEPROM.h"
+#include "OneWireDS2480B.h"
+#include "OneWireDS2482.h"
+#include "OneWireOwserver.h"
+
+static OneWireSim bus;
+static OneWire ds(bus);
+static int failures = 0;
+
+static void fail(const char *what)
+{
+  printf("FAILED: %s\n", what);
+  failures++;
+}
+
+static uint64_t started;
+
+// elapsed_ms includes delays as well as bus time, for transactions
+// which wait on the devices
+static void report(const char *name, uint32_t count = 1)
+{
+  printf("%-30s %6u %8u %8u %10llu %10llu %10llu\n", name,
+    (unsigned)bus.resets, (unsigned)bus.write_slots, (unsigned)bus.read_slots,
+    (unsigned long long)bus.bus_usec,
+    (unsigned long long)(count ? bus.bus_usec / count : 0),
+    (unsigned long long)((bus.now() - started) / 1000));
+  bus.clear_stats();
+  started = bus.now();
+}
+
+static void report_serial(const char *name, OneWireDS2480B &adapter)
+{
+  printf("%-30s %8u %8u\n", name, (unsigned)adapter.exchanges,
+    (unsigned)adapter.bytes_sent);
+  adapter.exchanges = 0;
+  adapter.bytes_sent = 0;
+}
+
+// I2C transfers, status polls and total time, including the I2C time
+static void report_i2c(const char *name, OneWireDS2482 &bridge)
+{
+  printf("%-30s %8u %8u %10llu\n", name, (unsigned)bridge.transfers,
+    (unsigned)bridge.polls, (unsigned long long)(bus.now() - started));
+  bridge.transfers = 0;
+  bridge.polls = 0;
+  started = bus.now();
+}
+
+static void report_owserver(const char *name, OneWireOwserver &client)
+{
+  printf("%-30s %8u %8u %8u\n", name, (unsigned)client.requests,
+    (unsigned)client.round_trips, (unsigned)client.connects);
+  client.requests = 0;
+  client.round_trips = 0;
+  client.connects = 0;
+}
+
+// An owserver stand-in for the simulated bus, on a loopback port, served
+// by a child process until it is killed
+static pid_t start_owserver(bool persistent, uint16_t *port)
+{
+  struct sockaddr_in a;
+  socklen_t alen = sizeof(a);
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (s < 0 || bind(s, (struct sockaddr *)&a, sizeof(a)) != 0 || listen(s, 4) != 0 ||
+      getsockname(s, (struct sockaddr *)&a, &alen) != 0) {
+    if (s >= 0) close(s);
+    return -1;
+  }
+  *port = ntohs(a.sin_port);
+  fflush(stdout);
+  pid_t child = fork();
+  if (child == 0) {
+    OneWireSimOwserver server(ds);
+    server.persistent = persistent;
+    int c;
+    while ((c = accept(s, NULL, NULL)) >= 0) {
+      server.serve(c);
+      close(c);
+    }
+    _exit(0);
+  }
+  close(s);
+  return child;
+}
+
+static void stop_owserver(pid_t child)
+{
+  kill(child, SIGTERM);
+  waitpid(child, NULL, 0);
+}
+
+int main()
+{
+  OneWireSimDS18B20 t1(0x000001), t2(0x000002), t3(0x0A0B0C);
+  OneWireSimDS2408 sw(0x004242);
+  OneWireSimDS250x prom(0x00BEEF);
+  OneWireSimDS18B20 *sensors[3] = { &t1, &t2, &t3 };
+  const float temps[3] = { 21.5f, -10.0625f, 85.0f };
+  const uint8_t message[] = "OneWire simulated DS2502 PROM.";
+  uint8_t addr[8], data[32], roms[8][8];
+  uint8_t i, n;
+
+  for (i = 0; i < 3; i++) {
+    sensors[i]->set_temperature(temps[i]);
+    bus.attach(*sensors[i]);
+  }
+  sw.set_inputs(0xA5);
+  prom.program(0, message, sizeof(message));
+  bus.attach(sw);
+  bus.attach(prom);
+
+  printf("%-30s %6s %8s %8s %10s %10s %10s\n", "transaction",
+    "resets", "writes", "reads", "bus_usec", "usec_each", "elapsed_ms");
+
+  // enumerate the bus, as every example does
+  bus.clear_stats();
+  started = bus.now();
+  ds.reset_search();
+  for (n = 0; n < 8 && ds.search(roms[n]); n++) {
+    if (OneWire::crc8(roms[n], 7) != roms[n][7]) fail("search ROM CRC");
+  }
+  if (n != 5) fail("search device count");
+  report("search (5 devices)", n);
+
+  // re-enumerate from the known table, unchanged and then with one
+  // sensor swapped for another
+  bool present[8];
+  uint8_t count = ds.reverify(roms, n, 8, present);
+  if (count != n) fail("reverify, stable bus");
+  report("reverify (5 known)", n);
+  OneWireSimDS18B20 t4(0x777777);
+  bus.detach(t3);
+  bus.attach(t4);
+  count = ds.reverify(roms, n, 8, present);
+  for (i = 0; i < count; i++) {
+    bool expect = memcmp(roms[i], t3.rom, 8) != 0;
+    if (present[i] != expect) fail("reverify presence");
+  }
+  if (count != n + 1 || memcmp(roms[n], t4.rom, 8) != 0) fail("reverify new device");
+  report("reverify (1 removed, 1 new)", count);
+  bus.detach(t4);
+  bus.attach(t3);
+
+  // only the DS2408 and the DS250x, then everything but the DS18B20s
+  OneWireFamilyFilter want, others(true);
+  want.include(sw.rom[0]);
+  want.include(prom.rom[0]);
+  others.exclude(0x28);
+  ds.reset_search();
+  for (i = 0; ds.search(addr, want); i++) {
+    if (!want.contains(addr[0])) fail("family search, wrong family");
+  }
+  ds.reset_search();
+  for (count = 0; ds.search(addr, others); count++) {
+    if (addr[0] == 0x28) fail("family search, excluded family");
+  }
+  if (i != 2 || count != 2) fail("family search count");
+  report("search 2 families, twice", 4);
+
+  // a full search with its own cursor, and between its steps a search
+  // for the DS2408 with another, then rollback() to repeat a step
+  OneWireSearchCursor all, switches;
+  OneWireFamilyFilter ds2408;
+  ds2408.include(0x29);
+  uint8_t again[8];
+  for (i = 0; ds.search(all, addr); i++) {
+    if (memcmp(addr, roms[i], 8) != 0) fail("cursor search order");
+    switches.reset();
+    if (!ds.search(switches, again, ds2408) || memcmp(again, sw.rom, 8) != 0) {
+      fail("interleaved cursor search");
+    }
+    if (i == 2) {
+      all.rollback();
+      if (!ds.search(all, again) || memcmp(again, addr, 8) != 0) fail("cursor rollback");
+    }
+  }
+  if (i != n) fail("cursor search count");
+  report("search + 5 DS2408 + 1 repeated", n + n + 1);
+
+  // noise part way through the second pass, an id bit read as 1 where
+  // every device has 0 so none seems to answer: that pass is repeated,
+  // the search doesn't start over
+  bus.misread_slot = 128 + 41;
+  ds.reset_search();
+  for (i = 0; ds.search(addr); i++) ;
+  if (i != n || bus.misread_slot != 0) fail("search with a misread slot");
+  report("search, 1 misread slot", n);
+
+  // DS18x20_Temperature: convert and read each sensor in turn
+  for (i = 0; i < n; i++) {
+    if (roms[i][0] != 0x28) continue;
+    ds.reset();
+    ds.select(roms[i]);
+    ds.write(0x44, 1);
+    delay(1000);
+    ds.reset();
+    ds.select(roms[i]);
+    ds.write(0xBE);
+    ds.read_bytes(data, 9);
+    if (OneWire::crc8(data, 8) != data[8]) fail("DS18B20 scratchpad CRC");
+    int16_t raw = (data[1] << 8) | data[0];
+    for (uint8_t s = 0; s < 3; s++) {
+      if (memcmp(roms[i], sensors[s]->rom, 8) == 0 && (float)raw / 16.0f != temps[s]) {
+        fail("DS18B20 temperature");
+      }
+    }
+  }
+  report("DS18B20 convert + read", 3);
+
+  // all three at once: Skip ROM + Convert T, poll for the end, then
+  // read each scratchpad
+  OneWireTemperature temp(ds);
+  int16_t raws[8];
+  bool ok[8];
+  for (i = 0; i < 3; i++) sensors[i]->set_temperature(temps[i] + 1.0f);
+  uint8_t good = temp.read_all(roms, n, raws, ok);
+  if (good != 3) fail("broadcast convert sensor count");
+  for (i = 0; i < n; i++) {
+    for (uint8_t s = 0; s < 3; s++) {
+      if (memcmp(roms[i], sensors[s]->rom, 8) == 0 &&
+        (!ok[i] || OneWireTemperature::celsius(raws[i]) != temps[s] + 1.0f)) {
+        fail("broadcast convert temperature");
+      }
+    }
+  }
+  report("DS18B20 broadcast convert + 3", 3);
+
+  // with a parasite powered sensor the bus is powered for 750ms
+  t2.parasite = true;
+  OneWireTemperature ptemp(ds);
+  if (!ptemp.convert_all() || !ptemp.read_raw(t2.rom, &raws[0])) fail("parasite convert");
+  if (OneWireTemperature::celsius(raws[0]) != temps[1] + 1.0f) fail("parasite temperature");
+  t2.parasite = false;
+  report("DS18B20 parasite convert + 1");
+
+  // thresholds which two of the sensors are outside, then one search
+  // pass for each of those
+  for (i = 0; i < 3; i++) {
+    if (!temp.set_alarm(sensors[i]->rom, -5, 50)) fail("set_alarm");
+  }
+  report("DS18B20 set alarms", 3);
+  uint8_t alarms[8][8];
+  count = temp.find_alarms(alarms, 8);
+  if (count != 2 || memcmp(alarms[0], t1.rom, 8) == 0 || memcmp(alarms[1], t1.rom, 8) == 0) {
+    fail("alarm search");
+  }
+  report("DS18B20 convert + alarm search", count);
+  if (!temp.set_alarm(NULL, -20, 100) || temp.find_alarms(alarms, 8) != 0) {
+    fail("alarm search, none in alarm");
+  }
+
+  // the same scratchpad read, in the background
+  OneWireAsync async(ds);
+  uint8_t tx[10];
+  tx[0] = 0x55;
+  memcpy(tx + 1, t1.rom, 8);
+  tx[9] = 0xBE;
+  memset(data, 0, sizeof(data));
+  async.start(true, tx, 10, data, 9);
+  while (async.poll()) ;
+  if (!async.result() || OneWire::crc8(data, 8) != data[8]) fail("async scratchpad read");
+  report("DS18B20 read (OneWireAsync)");
+
+  // DS2408_Switch: read the PIO registers with CRC16
+  memcpy(addr, sw.rom, 8);
+  uint8_t buf[13];
+  buf[0] = 0xF0;
+  buf[1] = 0x88;
+  buf[2] = 0x00;
+  ds.reset();
+  ds.select(addr);
+  ds.write_bytes(buf, 3);
+  ds.read_bytes(buf + 3, 10);
+  ds.reset();
+  if (!OneWire::check_crc16(buf, 11, &buf[11])) fail("DS2408 CRC16");
+  if (buf[3] != 0xA5) fail("DS2408 PIO state");
+  report("DS2408 read PIO registers");
+
+  // the same as one transaction, with the CRC16 checked
+  buf[0] = 0xF0;
+  buf[1] = 0x88;
+  buf[2] = 0x00;
+  if (ds.transaction(ONEWIRE_ADDR_MATCH, addr, buf, 3, buf + 3, 10,
+      ONEWIRE_CHECK_CRC16 | ONEWIRE_CHECK_TX) != ONEWIRE_OK || buf[3] != 0xA5) {
+    fail("DS2408 transaction");
+  }
+  buf[3] ^= 1;
+  if (OneWire::check_crc16(buf, 11, &buf[11])) fail("DS2408 corrupted CRC16");
+  if (ds.transaction(ONEWIRE_ADDR_MATCH, t3.rom, buf, 3, buf + 3, 10,
+      ONEWIRE_CHECK_CRC16 | ONEWIRE_CHECK_TX) != ONEWIRE_CRC_ERROR) {
+    fail("transaction CRC16 error");
+  }
+  report("DS2408 transaction", 2);
+
+  // the same at overdrive speed, then a standard reset for the others
+  ds.reset();
+  ds.overdrive_select(addr);
+  for (i = 0; i < 4; i++) {
+    if (i) {
+      ds.reset();
+      ds.skip();
+    }
+    buf[0] = 0xF0;
+    buf[1] = 0x88;
+    buf[2] = 0x00;
+    ds.write_bytes(buf, 3);
+    ds.read_bytes(buf + 3, 10);
+    if (!OneWire::check_crc16(buf, 11, &buf[11]) || buf[3] != 0xA5) fail("DS2408 overdrive read");
+  }
+  ds.set_speed(ONEWIRE_STANDARD);
+  if (!ds.reset()) fail("standard reset after overdrive");
+  report("DS2408 overdrive, 4 reads", 4);
+
+  // a polling loop on the DS2408: Match ROM the first time, then Resume
+  // ROM, until another device is addressed or a ROM command is sent
+  // behind select()'s back
+  uint8_t spad = 0xBE;
+  ds.set_auto_select(true);
+  for (i = 0; i < 6; i++) {
+    if (i == 2) {
+      if (ds.transaction(ONEWIRE_ADDR_MATCH, t1.rom, &spad, 1, data, 9,
+          ONEWIRE_CHECK_CRC8) != ONEWIRE_OK) {
+        fail("DS18B20 read between resumes");
+      }
+    } else if (i == 4) {
+      ds.reset();
+      ds.write(0xCC);
+    }
+    buf[0] = 0xF0;
+    buf[1] = 0x88;
+    buf[2] = 0x00;
+    if (ds.transaction(ONEWIRE_ADDR_MATCH, addr, buf, 3, buf + 3, 10,
+        ONEWIRE_CHECK_CRC16 | ONEWIRE_CHECK_TX) != ONEWIRE_OK || buf[3] != 0xA5) {
+      fail("DS2408 resumed read");
+    }
+  }
+  ds.set_auto_select(false);
+  report("DS2408 6 reads, 3 resumed", 6);
+
+  // a broadcast between two selects, sent with the caller's own reset,
+  // clears the DS2408's Resume flag, so the second select is a Match ROM
+  {
+    const uint8_t broadcast[2] = { 0xCC, 0x44 };   // Skip ROM, Convert T
+    ds.set_auto_select(true);
+    buf[0] = 0xF0;
+    buf[1] = 0x88;
+    buf[2] = 0x00;
+    ds.transaction(ONEWIRE_ADDR_MATCH, addr, buf, 3, buf + 3, 10);
+    ds.reset();
+    ds.transaction(ONEWIRE_ADDR_NONE, NULL, broadcast, 2, NULL, 0);
+    delay(750);
+    bus.clear_stats();
+    if (ds.transaction(ONEWIRE_ADDR_MATCH, addr, buf, 3, buf + 3, 10,
+        ONEWIRE_CHECK_CRC16 | ONEWIRE_CHECK_TX) != ONEWIRE_OK || buf[3] != 0xA5 ||
+        bus.write_slots != (1 + 8 + 3) * 8) {
+      fail("DS2408 select after a broadcast");
+    }
+    ds.set_auto_select(false);
+    report("DS2408 select after a broadcast");
+  }
+
+  // a bus with one sensor, which the search finds alone, so it is
+  // addressed with Skip ROM until a second one shows up and the
+  // collision fails the CRC
+  {
+    OneWireSim single;
+    OneWire one(single);
+    OneWireSimDS18B20 only(0x000777), late(0x000778);
+    uint8_t rom[8], convert = 0x44;
+    only.set_temperature(30.0f);
+    late.set_temperature(-5.0f);
+    single.attach(only);
+    single.attach(late);
+    one.transaction(ONEWIRE_ADDR_SKIP, NULL, &convert, 1, NULL, 0);
+    delay(750);
+    single.detach(late);
+    one.set_auto_select(true);
+    one.reset_search();
+    while (one.search(rom)) ;
+    single.clear_stats();
+    for (i = 0; i < 4; i++) {
+      if (one.transaction(ONEWIRE_ADDR_MATCH, only.rom, &spad, 1, data, 9,
+          ONEWIRE_CHECK_CRC8) != ONEWIRE_OK || data[0] != (uint8_t)(30 * 16)) {
+        fail("single DS18B20 read");
+      }
+    }
+    if (single.write_slots != 4 * 16) fail("single DS18B20 not skipped");
+    single.attach(late);
+    if (one.transaction(ONEWIRE_ADDR_MATCH, only.rom, &spad, 1, data, 9,
+        ONEWIRE_CHECK_CRC8) != ONEWIRE_CRC_ERROR) {
+      fail("Skip ROM collision");
+    }
+    if (one.transaction(ONEWIRE_ADDR_MATCH, only.rom, &spad, 1, data, 9,
+        ONEWIRE_CHECK_CRC8) != ONEWIRE_OK || data[0] != (uint8_t)(30 * 16)) {
+      fail("single DS18B20 read after collision");
+    }
+    single.detach(only);
+    single.detach(late);
+  }
+
+  // DS250x_PROM: read the first 32 bytes (selected, not skipped, since
+  // this bus has more than one device)
+  const uint8_t cmd[3] = { 0xF0, 0x00, 0x00 };
+  ds.reset();
+  ds.select(prom.rom);
+  ds.write_bytes(cmd, 3, 1);
+  if (ds.read() != OneWire::crc8(cmd, 3)) fail("DS250x command CRC");
+  ds.read_bytes(data, 32);
+  if (memcmp(data, message, sizeof(message)) != 0) fail("DS250x data");
+  report("DS250x read 32 bytes");
+
+  // the whole PROM, checking both CRC8s as the bits arrive
+  uint8_t mem[129];
+  ds.reset();
+  ds.select(prom.rom);
+  ds.write_bytes(cmd, 3, 1);
+  if (!ds.read_bytes_crc8(mem, 1, OneWire::crc8(cmd, 3))) fail("DS250x command CRC8");
+  if (!ds.read_bytes_crc8(mem, 129)) fail("DS250x data CRC8");
+  if (memcmp(mem, message, sizeof(message)) != 0) fail("DS250x data, inline CRC");
+  if (ds.read_bytes_crc8(mem, 1)) fail("DS250x past the end");
+  report("DS250x read 128 + CRC8");
+
+  // DS2431_EEPROM: provisioning EEPROM tags, written and read back
+  {
+    OneWireSimEEPROM ds2431(0x002431), ds2433(0x002433, 0x23), ds28ec20(0x0EC20, 0x43);
+    OneWireSimEEPROM *tags[3] = { &ds2431, &ds2433, &ds28ec20 };
+    const char *names[3] = { "DS2431", "DS2433", "DS28EC20" };
+    OneWireEEPROM eeprom(ds);
+    uint8_t image[2560], back[2560];
+    char name[40];
+
+    for (uint16_t j = 0; j < sizeof(image); j++) image[j] = j * 7 + (j >> 8);
+    for (i = 0; i < 3; i++) {
+      OneWireSimEEPROM &tag = *tags[i];
+      bus.attach(tag);
+      bus.clear_stats();
+      started = bus.now();
+      if (!eeprom.write(tag.rom, 0, image, tag.size) ||
+          memcmp(tag.memory, image, tag.size) != 0) {
+        fail("EEPROM write");
+      }
+      if (tag.busy_reads) fail("EEPROM read during a copy");
+      snprintf(name, sizeof(name), "%s write %u", names[i], tag.size);
+      report(name, tag.size / 32);
+      if (!eeprom.read(tag.rom, 0, back, tag.size) || memcmp(back, image, tag.size) != 0) {
+        fail("EEPROM read");
+      }
+      snprintf(name, sizeof(name), "%s read %u", names[i], tag.size);
+      report(name);
+    }
+    // part of a DS2431 row, and a read across DS28EC20 pages, both
+    // ending part way through
+    if (!eeprom.write(ds2431.rom, 13, message, 7) || memcmp(ds2431.memory + 13, message, 7) != 0 ||
+        memcmp(ds2431.memory + 8, image + 8, 5) != 0 || ds2431.memory[20] != image[20]) {
+      fail("DS2431 partial row");
+    }
+    if (!eeprom.read(ds28ec20.rom, 50, back, 100) || memcmp(back, image + 50, 100) != 0) {
+      fail("DS28EC20 read across pages");
+    }
+    // a bit misread in the second page fails its CRC, and a missing
+    // device the write
+    bus.misread_slot = (32 + 5) * 8 + 3;
+    if (eeprom.read(ds28ec20.rom, 64, back, 64)) fail("DS28EC20 page CRC");
+    bus.detach(ds2433);
+    if (eeprom.write(ds2433.rom, 0, image, 32)) fail("EEPROM write to a missing device");
+    bus.detach(ds2431);
+    bus.detach(ds28ec20);
+    report("EEPROM partial, CRC, missing", 5);
+  }
+
+  // three parts of a program reading the same devices within the TTL
+  OneWireCache cache(ds, 500);
+  uint8_t block[ONEWIRE_CACHE_DATA];
+  for (uint8_t reader = 0; reader < 3; reader++) {
+    for (i = 0; i < 3; i++) {
+      if (!cache.read(sensors[i]->rom, OneWireCache::scratchpad, block) ||
+          OneWireTemperature::raw_temperature(0x28, block) !=
+          (int16_t)((temps[i] + 1.0f) * 16)) {
+        fail("cache scratchpad");
+      }
+    }
+    if (!cache.read(sw.rom, OneWireCache::ds2408_registers, block) || block[0] != 0xA5) {
+      fail("cache DS2408 registers");
+    }
+  }
+  if (cache.hits != 8 || cache.misses != 4) fail("cache hits");
+  report("cache, 3 readers x 4 devices", 12);
+
+  // the same, wanted first and read in one refresh, after the TTL
+  delay(500);
+  for (uint8_t reader = 0; reader < 3; reader++) {
+    for (i = 0; i < 3; i++) cache.want(sensors[i]->rom, OneWireCache::scratchpad);
+    cache.want(sw.rom, OneWireCache::ds2408_registers);
+  }
+  if (cache.refresh() != 0 || cache.coalesced != 8 || cache.misses != 8) {
+    fail("cache refresh");
+  }
+  report("cache, 12 wants, 1 refresh", 12);
+
+  // two DS2408 reads which differ only in their start address, each
+  // built where the other was, are two entries: the first is the same
+  // read as ds2408_registers and found cached, the second goes to the bus
+  {
+    uint32_t hits = cache.hits, misses = cache.misses;
+    uint8_t direct[10];
+    for (i = 0; i < 2; i++) {
+      OneWireCacheRead from = { { 0xF0, (uint8_t)(0x88 + i), 0x00 }, 3, (uint8_t)(10 - i),
+        ONEWIRE_CHECK_CRC16 | ONEWIRE_CHECK_TX };
+      if (!cache.read(sw.rom, from, block)) fail("cache DS2408 register read");
+    }
+    buf[0] = 0xF0;
+    buf[1] = 0x89;
+    buf[2] = 0x00;
+    if (ds.transaction(ONEWIRE_ADDR_MATCH, sw.rom, buf, 3, direct, 9,
+        ONEWIRE_CHECK_CRC16 | ONEWIRE_CHECK_TX) != ONEWIRE_OK ||
+        memcmp(block, direct, 9) != 0 || cache.hits != hits + 1 || cache.misses != misses + 1) {
+      fail("cache reads told apart by their command");
+    }
+    report("cache, 2 reads at one address", 2);
+  }
+
+  // OneWireGroup on this bus and three more, one of them empty: a
+  // broadcast conversion, then each bus's sensor matched with its own
+  // ROM in the same slots
+  {
+    OneWireSim bus1, bus2, bus3;
+    OneWireSimDS18B20 g1(0x000101), g2(0x000102);
+    OneWireBackend *buses[4] = { &bus, &bus1, &bus2, &bus3 };
+    const uint8_t *roms4[4] = { t1.rom, g1.rom, g2.rom, t1.rom };
+    uint8_t pads[4][9], *bufs[4] = { pads[0], pads[1], pads[2], pads[3] };
+    OneWireGroup group;
+
+    g1.set_temperature(21.5f);
+    g2.set_temperature(-3.0f);
+    bus1.attach(g1);
+    bus2.attach(g2);
+    bus.clear_stats();
+    started = bus.now();
+    if (!group.begin(buses, 4) || group.reset() != 0x07) fail("group reset");
+    group.write(0xCC);
+    group.write(0x44);
+    delay(750);
+    if (group.reset() != 0x07) fail("group reset after convert");
+    group.write(0x55);
+    group.write_bytes(roms4, 8);
+    group.write(0xBE);
+    group.read_bytes(bufs, 9);
+    for (i = 0; i < 3; i++) {
+      if (OneWire::crc8(pads[i], 8) != pads[i][8]) fail("group scratchpad CRC");
+    }
+    if (OneWireTemperature::raw_temperature(0x28, pads[1]) != (int16_t)(21.5f * 16) ||
+        OneWireTemperature::raw_temperature(0x28, pads[2]) != (int16_t)(-3.0f * 16)) {
+      fail("group temperatures");
+    }
+    report("OneWireGroup, 4 buses", 3);
+    if (ds.transaction(ONEWIRE_ADDR_MATCH, t1.rom, &spad, 1, data, 9, ONEWIRE_CHECK_CRC8) !=
+        ONEWIRE_OK || memcmp(data, pads[0], 9) != 0) {
+      fail("group scratchpad on the shared bus");
+    }
+    bus1.detach(g1);
+    bus2.detach(g2);
+  }
+
+  // a search and the 3 scratchpads with each timing preset
+  OneWireTiming fast = OneWireTiming::minimum;
+  fast.fast_reset = true;
+  const OneWireTiming *timings[4] = {
+    &OneWireTiming::standard, &OneWireTiming::minimum, &fast,
+    &OneWireTiming::conservative
+  };
+  const char *timing_names[4] = {
+    "search + 3 reads, standard", "search + 3 reads, minimum",
+    "search + 3 reads, fast reset", "search + 3 reads, conservative"
+  };
+  for (uint8_t t = 0; t < 4; t++) {
+    if (!ds.set_timing(timings[t])) fail("set_timing");
+    ds.reset_search();
+    for (i = 0; ds.search(addr); i++) ;
+    if (i != n) fail("search with timing");
+    for (i = 0; i < 3; i++) {
+      uint8_t cmd = 0xBE;
+      if (ds.transaction(ONEWIRE_ADDR_MATCH, sensors[i]->rom, &cmd, 1, data, 9,
+          ONEWIRE_CHECK_CRC8) != ONEWIRE_OK) {
+        fail("read with timing");
+      }
+    }
+    report(timing_names[t], 1);
+  }
+  ds.set_timing(&OneWireTiming::standard);
+
+  // calibrate a bus which takes 2us to rise, then check it again after
+  // the rise time grows to 6us, past what the tuned recovery allows
+  OneWireCalibration cal(ds);
+  bus.rise_usec = 2;
+  if (!cal.run(NULL, &OneWireTiming::conservative) || cal.rise_usec != 2 ||
+      cal.recovery_usec != 4) {
+    fail("calibration");
+  }
+  report("calibrate, 2us rise", cal.passes);
+  ds.set_timing(&cal.timing);
+  ds.reset_search();
+  for (i = 0; ds.search(addr); i++) ;
+  if (i != n || bus.lost_slots) fail("search calibrated");
+  for (i = 0; i < 3; i++) {
+    uint8_t cmd = 0xBE;
+    if (ds.transaction(ONEWIRE_ADDR_MATCH, sensors[i]->rom, &cmd, 1, data, 9,
+        ONEWIRE_CHECK_CRC8) != ONEWIRE_OK) {
+      fail("read calibrated");
+    }
+  }
+  report("search + 3 reads, calibrated");
+  bus.rise_usec = 6;
+  cal.passes = 0;
+  if (!cal.check() || cal.rise_usec != 6 || cal.recovery_usec != 8) {
+    fail("calibration check");
+  }
+  report("check, recalibrate at 6us", cal.passes);
+  bus.rise_usec = 0;
+  ds.set_timing(&OneWireTiming::standard);
+
+  // the same bus behind a simulated DS2480B on a pty, served by a
+  // child process, counting serial round trips instead of slots
+  printf("\n%-30s %8s %8s\n", "DS2480B transaction", "trips", "bytes");
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  int slave = -1;
+  if (master >= 0 && grantpt(master) == 0 && unlockpt(master) == 0) {
+    slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  }
+  if (slave < 0) {
+    fail("DS2480B pty");
+    return 1;
+  }
+  fflush(stdout);
+  pid_t child = fork();
+  if (child == 0) {
+    close(slave);
+    OneWireSimDS2480B chip(bus);
+    chip.serve(master);
+    // begin() sets the strong pullup duration to "until ended", and no
+    // other parameter
+    for (uint8_t p = 1; p < 8; p++) {
+      if (chip.parameter(p) != (p == 3 ? 7 : 0)) _exit(1);
+    }
+    _exit(0);
+  }
+  close(master);
+
+  OneWireDS2480B adapter;
+  if (!adapter.begin(slave)) fail("DS2480B begin");
+  OneWire ow(adapter);
+  uint8_t found[8][8];
+  adapter.exchanges = adapter.bytes_sent = 0;
+  ow.reset_search();
+  for (i = 0; i < 8 && ow.search(found[i]); i++) ;
+  if (i != n || memcmp(found, roms, sizeof(found[0]) * n) != 0) fail("DS2480B search");
+  report_serial("search (5 devices)", adapter);
+
+  uint8_t be = 0xBE;
+  if (ow.transaction(ONEWIRE_ADDR_MATCH, t1.rom, &be, 1, data, 9, ONEWIRE_CHECK_CRC8) != ONEWIRE_OK) {
+    fail("DS2480B scratchpad");
+  }
+  report_serial("DS18B20 read scratchpad", adapter);
+
+  buf[0] = 0xF0;
+  buf[1] = 0x88;
+  buf[2] = 0x00;
+  if (ow.transaction(ONEWIRE_ADDR_MATCH, sw.rom, buf, 3, buf + 3, 10,
+      ONEWIRE_CHECK_CRC16 | ONEWIRE_CHECK_TX) != ONEWIRE_OK || buf[3] != 0xA5) {
+    fail("DS2480B DS2408 read");
+  }
+  report_serial("DS2408 read PIO registers", adapter);
+
+  // a powered write, as for a parasite Convert T
+  ow.reset();
+  ow.skip();
+  ow.write(0x44, 1);
+  ow.depower();
+  if (!ow.verify(t2.rom) || ow.verify(t4.rom)) fail("DS2480B verify");
+  report_serial("powered write, 2 verify", adapter);
+  if (adapter.error) fail("DS2480B response");
+
+  adapter.end();
+  close(slave);
+  int status = 1;
+  waitpid(child, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) fail("DS2480B configuration");
+
+  // the same bus on channel 0 of a simulated DS2482-800, and a second
+  // bus with one sensor on channel 3
+  printf("\n%-30s %8s %8s %10s\n", "DS2482 transaction", "i2c", "polls", "usec");
+  OneWireSim bus3;
+  OneWireSimDS18B20 t5(0x000005);
+  bus3.attach(t5);
+  OneWireSimDS2482 bridge_chip(bus);
+  bridge_chip.attach(3, bus3);
+  OneWireDS2482 bridge(bridge_chip);
+  if (!bridge.begin()) fail("DS2482 begin");
+  OneWire ow2(bridge);
+  bridge.transfers = bridge.polls = 0;
+  started = bus.now();
+  ow2.reset_search();
+  for (i = 0; i < 8 && ow2.search(found[i]); i++) ;
+  if (i != n || memcmp(found, roms, sizeof(found[0]) * n) != 0) fail("DS2482 search");
+  report_i2c("search (5 devices)", bridge);
+
+  if (ow2.transaction(ONEWIRE_ADDR_MATCH, t1.rom, &be, 1, data, 9, ONEWIRE_CHECK_CRC8) != ONEWIRE_OK) {
+    fail("DS2482 scratchpad");
+  }
+  report_i2c("DS18B20 read scratchpad", bridge);
+
+  buf[0] = 0xF0;
+  buf[1] = 0x88;
+  buf[2] = 0x00;
+  if (ow2.transaction(ONEWIRE_ADDR_MATCH, sw.rom, buf, 3, buf + 3, 10,
+      ONEWIRE_CHECK_CRC16 | ONEWIRE_CHECK_TX) != ONEWIRE_OK || buf[3] != 0xA5) {
+    fail("DS2482 DS2408 read");
+  }
+  report_i2c("DS2408 read PIO registers", bridge);
+
+  ow2.reset();
+  ow2.skip();
+  ow2.write(0x44, 1);
+  if (!bridge_chip.pullup()) fail("DS2482 strong pullup on");
+  ow2.depower();
+  if (bridge_chip.pullup()) fail("DS2482 strong pullup off");
+  if (!ow2.verify(t2.rom) || ow2.verify(t4.rom)) fail("DS2482 verify");
+  report_i2c("powered write, 2 verify", bridge);
+
+  if (!bridge.select_channel(3)) fail("DS2482 channel select");
+  ow2.reset_search();
+  if (!ow2.search(found[0]) || memcmp(found[0], t5.rom, 8) != 0 || ow2.search(found[1])) {
+    fail("DS2482 channel 3 search");
+  }
+  report_i2c("channel 3 select + search", bridge);
+  if (bridge.error || bridge_chip.refused) fail("DS2482 response");
+
+  // the same bus behind an owserver stand-in on loopback, counting
+  // requests, round trips and connections
+  printf("\n%-30s %8s %8s %8s\n", "owserver transaction", "requests", "trips", "connects");
+  for (i = 0; i < 3; i++) sensors[i]->set_temperature(temps[i] + 2.0f);
+  uint16_t port = 0;
+  pid_t server = start_owserver(true, &port);
+  OneWireOwserver client;
+  if (server < 0 || !client.begin("127.0.0.1", port)) fail("owserver connect");
+  client.connects = 0;
+  i = client.search(found, 8);
+  if (i != n || memcmp(found, roms, sizeof(found[0]) * n) != 0) fail("owserver search");
+  report_owserver("search (5 devices)", client);
+
+  char text[3][16];
+  char paths[3][40];
+  int results[3];
+  for (i = 0; i < 3; i++) {
+    if (client.read_property(sensors[i]->rom, "temperature", text[i], sizeof(text[i])) <= 0 ||
+        atof(text[i]) != temps[i] + 2.0f) {
+      fail("owserver temperature");
+    }
+  }
+  report_owserver("3 temperatures, one by one", client);
+
+  for (i = 0; i < 3; i++) {
+    OneWireOwserver::device_path(paths[i], sizeof(paths[i]), sensors[i]->rom, "temperature");
+    client.queue_read(paths[i], (uint8_t *)text[i], sizeof(text[i]) - 1, &results[i]);
+  }
+  if (client.run() != 3) fail("owserver pipelined temperature");
+  report_owserver("3 temperatures, pipelined", client);
+
+  if (!client.write("/simultaneous/temperature", (const uint8_t *)"1", 1)) {
+    fail("owserver simultaneous");
+  }
+  for (i = 0; i < 3; i++) {
+    client.queue_read(paths[i], (uint8_t *)text[i], sizeof(text[i]) - 1, &results[i]);
+  }
+  if (client.run() != 3) fail("owserver simultaneous read");
+  for (i = 0; i < 3; i++) {
+    text[i][results[i] > 0 ? results[i] : 0] = 0;
+    if (atof(text[i]) != temps[i] + 2.0f) fail("owserver simultaneous temperature");
+  }
+  report_owserver("simultaneous + 3 pipelined", client);
+
+  char mempath[40];
+  OneWireOwserver::device_path(mempath, sizeof(mempath), prom.rom, "memory");
+  if (client.read(mempath, mem, sizeof(message)) != (int)sizeof(message) ||
+      memcmp(mem, message, sizeof(message)) != 0) {
+    fail("owserver DS250x memory");
+  }
+  char piopath[40], sensedpath[40];
+  OneWireOwserver::device_path(piopath, sizeof(piopath), sw.rom, "PIO.BYTE");
+  OneWireOwserver::device_path(sensedpath, sizeof(sensedpath), sw.rom, "sensed.BYTE");
+  client.queue_write(piopath, (const uint8_t *)"165", 3, &results[0]);
+  client.queue_read(sensedpath, (uint8_t *)text[1], sizeof(text[1]) - 1, &results[1]);
+  if (client.run() != 2 || results[1] <= 0) fail("owserver DS2408");
+  text[1][results[1] > 0 ? results[1] : 0] = 0;
+  if (atoi(text[1]) != 0xA5) fail("owserver DS2408 PIO");
+  report_owserver("DS250x memory, DS2408 PIO", client);
+  client.end();
+  stop_owserver(server);
+
+  // a server which closes after every answer, the client resends
+  server = start_owserver(false, &port);
+  if (server < 0 || !client.begin("127.0.0.1", port)) fail("owserver connect");
+  client.connects = 0;
+  for (i = 0; i < 3; i++) {
+    client.queue_read(paths[i], (uint8_t *)text[i], sizeof(text[i]) - 1, &results[i]);
+  }
+  if (client.run() != 3) fail("owserver without persistence");
+  report_owserver("3 temps, no persistence", client);
+  client.end();
+  stop_owserver(server);
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+// Print the OneWireTelemetry counters for two simulated buses after a
+// mix of traffic, including a device which goes missing, a bus with
+// nothing on it and a search which loses its device part way.  Built with
+// ONEWIRE_TELEMETRY=1, see the Makefile.
+//
+// Exits non-zero if a counter doesn't match the traffic sent.
+
+#include <stdio.h>
+#include <string.h>
+#include "OneWire.h"
+#include "OneWireSim.h"
+#include "OneWireTemperature.h"
+
+#if !ONEWIRE_TELEMETRY
+#error "build with -DONEWIRE_TELEMETRY=1"
+#endif
+
+static int failures = 0;
+
+static void check(const char *what, uint32_t got, uint32_t want)
+{
+  if (got != want) {
+    printf("FAILED: %s is %lu, expected %lu\n", what, (unsigned long)got,
+      (unsigned long)want);
+    failures++;
+  }
+}
+
+static void print(const char *name, const OneWireTelemetry &t)
+{
+  printf("%s\n", name);
+  printf("  resets %lu (%lu without presence), %lu bad CRCs\n",
+    (unsigned long)t.resets, (unsigned long)t.no_presence, (unsigned long)t.crc_errors);
+  printf("  bits written %lu, read %lu; bytes written %lu, read %lu\n",
+    (unsigned long)t.bits_written, (unsigned long)t.bits_read,
+    (unsigned long)t.bytes_written, (unsigned long)t.bytes_read);
+  printf("  searches %lu (%lu restarted), transactions %lu, longest %lu us\n",
+    (unsigned long)t.searches, (unsigned long)t.search_restarts,
+    (unsigned long)t.transactions, (unsigned long)t.transaction_max_usec);
+  // only the GPIO slots turn interrupts off, so 0 on the simulated bus
+  printf("  interrupts off %lu us, longest %u us\n", (unsigned long)t.irq_usec,
+    t.irq_max_usec);
+  printf("  transaction ms:");
+  for (uint8_t i = 0; i < ONEWIRE_TELEMETRY_BINS; i++) {
+    if (i == ONEWIRE_TELEMETRY_BINS - 1) printf("  >=%u: %lu", 1u << (i - 1),
+      (unsigned long)t.transaction_ms[i]);
+    else printf("  <%u: %lu", 1u << i, (unsigned long)t.transaction_ms[i]);
+  }
+  printf("\n");
+}
+
+int main()
+{
+  OneWireSim bus1, bus2;
+  OneWireSimDS18B20 t1(0x000001), t2(0x000002);
+  OneWireSimDS2408 sw(0x004242);
+  OneWire ds1(bus1), ds2(bus2);
+  OneWireTemperature temp(ds1);
+  uint8_t rom[8], data[10];
+  int16_t raw;
+
+  bus1.attach(t1);
+  bus1.attach(t2);
+  bus1.attach(sw);
+
+  // bus 1: a full search, a conversion, reads, and a missing device
+  ds1.reset_search();
+  while (ds1.search(rom)) ;
+  temp.convert_all();
+  temp.read_raw(t1.rom, &raw);
+  temp.read_raw(t2.rom, &raw);
+  bus1.detach(t2);
+  if (temp.read_raw(t2.rom, &raw)) {
+    printf("FAILED: read a missing sensor\n");
+    failures++;
+  }
+  uint8_t cmd[3] = { 0xF0, 0x88, 0x00 };
+  ds1.transaction(ONEWIRE_ADDR_MATCH, sw.rom, cmd, 3, data, 10,
+    ONEWIRE_CHECK_CRC16 | ONEWIRE_CHECK_TX);
+
+  // a search which loses the devices after the first
+  bus1.attach(t2);
+  ds1.reset_search();
+  ds1.search(rom);
+  bus1.detach(t1);
+  bus1.detach(t2);
+  bus1.detach(sw);
+  ds1.search(rom);
+  print("bus 1", ds1.telemetry);
+
+  // 4 searches for 3 devices and 2 more, the second of which restarts
+  // after repeating its pass ONEWIRE_SEARCH_RETRIES times;
+  // 3 scratchpad reads and the DS2408 registers, one scratchpad bad
+  check("bus 1 searches", ds1.telemetry.searches, 4 + 2);
+  check("bus 1 restarts", ds1.telemetry.search_restarts, 1);
+  check("bus 1 no presence", ds1.telemetry.no_presence, 1 + ONEWIRE_SEARCH_RETRIES);
+  check("bus 1 crc errors", ds1.telemetry.crc_errors, 1);
+  check("bus 1 transactions", ds1.telemetry.transactions, 4);
+
+  // bus 2: nothing attached
+  ds2.reset();
+  ds2.reset();
+  ds2.reset_search();
+  ds2.search(rom);
+  print("bus 2", ds2.telemetry);
+  check("bus 2 no presence", ds2.telemetry.no_presence, 3);
+  check("bus 2 resets", ds2.telemetry.resets, 3);
+  check("bus 2 restarts", ds2.telemetry.search_restarts, 0);
+
+  ds1.telemetry.clear();
+  check("cleared", ds1.telemetry.resets, 0);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,313 @@
+// Play back a OneWireTrace recording through the driver, and list the
+// transactions in it: the ROMs found by search() and selected, the bytes
+// sent and received, and whether their CRCs are right.
+//
+//    trace_replay FILE           decode the recording in FILE
+//    trace_replay FILE N         decode it N times, and report the speed
+//    trace_replay --record FILE  record a session on the simulated bus,
+//                                with one sensor missing at the end
+//
+// FILE has one entry per line as OneWireTrace::format() writes them.
+// Other lines, such as the rest of a serial log, are skipped.  Built
+// with ONEWIRE_TRACE=1, see the Makefile.
+//
+// Exits non-zero if the driver doesn't write what the recording shows.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "OneWire.h"
+#include "OneWireReplay.h"
+#include "OneWireSim.h"
+
+#if !ONEWIRE_TRACE
+#error "build with -DONEWIRE_TRACE=1"
+#endif
+
+struct Totals {
+  uint32_t transactions;
+  uint32_t absent;
+  uint32_t searches;
+  uint32_t crc_errors;
+};
+
+static bool print = true;
+
+static void show(const OneWireTraceEntry *first, uint32_t usec, const char *what,
+  const char *detail)
+{
+  if (print) printf("%10lu  %-8s %s\n", (unsigned long)(usec - first->usec), what, detail);
+}
+
+static void hex(char *out, const uint8_t *buf, uint16_t count)
+{
+  for (uint16_t i = 0; i < count; i++) out += sprintf(out, "%s%02X", i ? " " : "", buf[i]);
+  *out = 0;
+}
+
+static void rom_text(char *out, const uint8_t *rom)
+{
+  sprintf(out, "%02X.%02X%02X%02X%02X%02X%02X.%02X%s", rom[0], rom[1], rom[2],
+    rom[3], rom[4], rom[5], rom[6], rom[7],
+    OneWire::crc8(rom, 7) == rom[7] ? "" : " (bad CRC)");
+}
+
+// The ROM a search pass wrote, taken from the recording when the
+// driver's search() doesn't follow it (the recording starts part way
+// through an enumeration).  Returns false if the pass failed.
+static bool search_from_trace(OneWireReplay &replay, uint8_t *rom)
+{
+  uint8_t id, cmp, dir;
+
+  memset(rom, 0, 8);
+  replay.write(0xF0, 1);
+  for (uint8_t n = 0; n < 64; n++) {
+    id = replay.read_bit();
+    cmp = replay.read_bit();
+    if (id && cmp) return false;
+    dir = (id != cmp) ? id : 0;
+    const OneWireTraceEntry *e = replay.peek();
+    if (e && e->op == ONEWIRE_TRACE_WRITE_BIT) dir = e->value & 1;
+    replay.write_bit(dir);
+    if (dir) rom[n >> 3] |= 1 << (n & 7);
+  }
+  return true;
+}
+
+// The recorded bytes of type 'op' from here on, up to 'max', passed
+// through the driver
+static uint16_t take_bytes(OneWireReplay &replay, OneWire &ds, uint8_t op,
+  uint8_t *buf, uint16_t max)
+{
+  uint16_t n = 0;
+  const OneWireTraceEntry *e;
+
+  while (n < max && (e = replay.peek()) && e->op == op) {
+    if (op == ONEWIRE_TRACE_READ_BYTE) {
+      buf[n++] = ds.read();
+    } else {
+      buf[n++] = e->value;
+      ds.write(e->value, 1);
+    }
+  }
+  return n;
+}
+
+static void decode(OneWireReplay &replay, OneWire &ds, const OneWireTraceEntry *first,
+  Totals &totals)
+{
+  char line[400], text[48];
+  uint8_t rom[8], tx[32], rx[64];
+  const OneWireTraceEntry *e;
+
+  memset(&totals, 0, sizeof(totals));
+  replay.rewind();
+  ds.reset_search();
+  while (replay.peek()) {
+    uint32_t start = replay.tell();
+    uint32_t usec = replay.peek()->usec;
+    if (!ds.reset()) {
+      if (replay.done()) break;
+      totals.absent++;
+      show(first, usec, "reset", "no presence");
+      continue;
+    }
+    totals.transactions++;
+    e = replay.peek();
+    if (!e || e->op != ONEWIRE_TRACE_WRITE_BYTE) {
+      show(first, usec, "reset", "");
+      continue;
+    }
+    uint8_t cmd = e->value;
+
+    if (cmd == 0xF0) {
+      // let the driver do the search, if it follows the recording
+      uint32_t mismatches = replay.mismatches;
+      bool found, driver = true;
+      totals.searches++;
+      replay.seek(start);
+      found = ds.search(rom);
+      if (replay.tell() == start || replay.mismatches != mismatches) {
+        replay.mismatches = mismatches;
+        replay.seek(start);
+        replay.reset();
+        ds.reset_search();
+        found = search_from_trace(replay, rom);
+        driver = false;
+      }
+      if (!found) {
+        show(first, usec, "search", "none");
+        continue;
+      }
+      rom_text(text, rom);
+      if (!driver) strcat(text, " (from the trace)");
+      show(first, usec, "search", text);
+      continue;
+    }
+
+    ds.write(cmd, 1);
+    uint16_t romcount = 0;
+    const char *what = "command";
+    if (cmd == 0x55 || cmd == 0x69) {
+      what = "match";
+      romcount = take_bytes(replay, ds, ONEWIRE_TRACE_WRITE_BYTE, rom, 8);
+    } else if (cmd == 0xCC || cmd == 0x3C) {
+      what = "skip";
+    } else if (cmd == 0xA5) {
+      what = "resume";
+    } else if (cmd == 0x33) {
+      what = "read ROM";
+    }
+    // the function command and data, then whatever else there is
+    // before the next reset (status polling, more bytes than fit)
+    uint16_t ntx, nrx, more = 0;
+    ntx = take_bytes(replay, ds, ONEWIRE_TRACE_WRITE_BYTE, tx, sizeof(tx));
+    nrx = take_bytes(replay, ds, ONEWIRE_TRACE_READ_BYTE, rx, sizeof(rx));
+    while ((e = replay.peek()) && e->op != ONEWIRE_TRACE_RESET) {
+      if (e->op == ONEWIRE_TRACE_READ_BIT) ds.read_bit();
+      else if (e->op == ONEWIRE_TRACE_WRITE_BIT) ds.write_bit(e->value);
+      else if (e->op == ONEWIRE_TRACE_READ_BYTE) ds.read();
+      else ds.write(e->value, 1);
+      more++;
+    }
+
+    char *p = line;
+    if (romcount == 8) {
+      rom_text(text, rom);
+      p += sprintf(p, "%s ", text);
+    }
+    if (ntx) {
+      hex(p, tx, ntx);
+      p += strlen(p);
+    }
+    if (nrx) {
+      p += sprintf(p, " -> ");
+      hex(p, rx, nrx);
+      p += strlen(p);
+    }
+    if (more) p += sprintf(p, " + %u more", more);
+
+    // the CRCs of the reads this tool knows
+    int crc_ok = -1;
+    if (cmd == 0x33 && nrx >= 8) {
+      crc_ok = OneWire::crc8(rx, 7) == rx[7];
+    } else if (ntx == 1 && tx[0] == 0xBE && nrx == 9) {
+      crc_ok = OneWire::crc8(rx, 8) == rx[8];
+    } else if (romcount == 8 && rom[0] == 0x29 && ntx == 3 && tx[0] == 0xF0 &&
+               nrx >= 2) {
+      uint8_t all[sizeof(tx) + sizeof(rx)];
+      memcpy(all, tx, ntx);
+      memcpy(all + ntx, rx, nrx);
+      crc_ok = OneWire::check_crc16(all, ntx + nrx - 2, all + ntx + nrx - 2);
+    }
+    if (crc_ok == 0) totals.crc_errors++;
+    if (crc_ok >= 0) sprintf(p, crc_ok ? "  CRC ok" : "  BAD CRC");
+    show(first, usec, what, line);
+  }
+}
+
+// A session on the simulated bus, ending with a read of a sensor which
+// has gone missing
+static int record(const char *file)
+{
+  OneWireSim bus;
+  OneWireSimDS18B20 t1(0x000001), t2(0x000002), t3(0x0A0B0C);
+  OneWireSimDS2408 sw(0x004242);
+  OneWire ds(bus);
+  uint8_t rom[8], data[10];
+  uint8_t convert = 0x44, scratchpad = 0xBE, pio[3] = { 0xF0, 0x88, 0x00 };
+  char line[ONEWIRE_TRACE_LINE];
+
+  bus.attach(t1);
+  bus.attach(t2);
+  bus.attach(t3);
+  bus.attach(sw);
+  ds.reset_search();
+  while (ds.search(rom)) ;
+  ds.transaction(ONEWIRE_ADDR_SKIP, NULL, &convert, 1, NULL, 0);
+  delay(800);
+  ds.transaction(ONEWIRE_ADDR_MATCH, t1.rom, &scratchpad, 1, data, 9, ONEWIRE_CHECK_CRC8);
+  ds.transaction(ONEWIRE_ADDR_MATCH, t3.rom, &scratchpad, 1, data, 9, ONEWIRE_CHECK_CRC8);
+  ds.transaction(ONEWIRE_ADDR_MATCH, sw.rom, pio, 3, data, 10,
+    ONEWIRE_CHECK_CRC16 | ONEWIRE_CHECK_TX);
+  bus.detach(t2);
+  ds.trace.stop_on_error = true;
+  if (ds.transaction(ONEWIRE_ADDR_MATCH, t2.rom, &scratchpad, 1, data, 9,
+      ONEWIRE_CHECK_CRC8) != ONEWIRE_CRC_ERROR) {
+    printf("FAILED: read a missing sensor\n");
+    return 1;
+  }
+  // not recorded, the trace stopped at the error
+  ds.reset();
+
+  FILE *f = fopen(file, "w");
+  if (!f) {
+    perror(file);
+    return 1;
+  }
+  for (uint16_t i = 0; i < ds.trace.count(); i++) {
+    OneWireTrace::format(ds.trace.get(i), line);
+    fprintf(f, "%s\n", line);
+  }
+  fclose(f);
+  printf("recorded %u entries in %s\n", ds.trace.count(), file);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc == 3 && strcmp(argv[1], "--record") == 0) return record(argv[2]);
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: trace_replay FILE [repeat] | --record FILE\n");
+    return 2;
+  }
+
+  FILE *f = fopen(argv[1], "r");
+  if (!f) {
+    perror(argv[1]);
+    return 1;
+  }
+  OneWireTraceEntry *entries = NULL;
+  uint32_t count = 0, room = 0, other = 0;
+  char text[256];
+  while (fgets(text, sizeof(text), f)) {
+    if (count == room) {
+      room = room ? room * 2 : 1024;
+      entries = (OneWireTraceEntry *)realloc(entries, room * sizeof(entries[0]));
+    }
+    if (OneWireTrace::parse(text, &entries[count])) count++;
+    else other++;
+  }
+  fclose(f);
+  if (!count) {
+    fprintf(stderr, "%s: no trace entries\n", argv[1]);
+    return 1;
+  }
+
+  OneWireReplay replay(entries, count);
+  OneWire ds(replay);
+  Totals totals;
+  decode(replay, ds, entries, totals);
+  printf("%lu entries (%lu other lines), %lu transactions, %lu without presence, "
+    "%lu searches, %lu CRC errors, %lu mismatches, %lu skipped\n",
+    (unsigned long)count, (unsigned long)other, (unsigned long)totals.transactions,
+    (unsigned long)totals.absent, (unsigned long)totals.searches,
+    (unsigned long)totals.crc_errors, (unsigned long)replay.mismatches,
+    (unsigned long)replay.skipped);
+  int result = replay.mismatches ? 1 : 0;
+
+  if (argc == 3) {
+    long repeat = atol(argv[2]);
+    struct timespec a, b;
+    print = false;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    for (long i = 0; i < repeat; i++) decode(replay, ds, entries, totals);
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    double sec = (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) * 1e-9;
+    printf("decoded %ld times in %.3f s, %.1f M entries/s\n", repeat, sec,
+      sec > 0 ? count * repeat / sec / 1e6 : 0.0);
+  }
+  free(entries);
+  return result;
+}
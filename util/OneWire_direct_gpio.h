@@ -1,13 +1,18 @@
 #ifndef OneWire_Direct_GPIO_h
 #define OneWire_Direct_GPIO_h
 
-// This header should ONLY be included by OneWire.cpp.  These defines are
-// meant to be private, used within OneWire.cpp, but not exposed to Arduino
-// sketches or other libraries which may include OneWire.h.
+// This header should ONLY be included by the OneWire .cpp files.  These
+// defines are meant to be private, used within OneWire.cpp and its
+// companions, but not exposed to Arduino sketches or other libraries which
+// may include OneWire.h.
 
 #include <stdint.h>
 
 // Platform specific I/O definitions
+//
+// DIRECT_READ_PORT(base) is defined where every pin of a port shares the
+// same registers with one bit per pin, so several pins can be driven with
+// a combined mask and read back together (used by OneWireGroup).
 
 #if defined(__AVR__)
 #define PIN_TO_BASEREG(pin)             (portInputRegister(digitalPinToPort(pin)))
@@ -17,12 +22,14 @@
 #define IO_REG_MASK_ATTR
 #if defined(__AVR_ATmega4809__)
 #define DIRECT_READ(base, mask)         (((*(base)) & (mask)) ? 1 : 0)
+#define DIRECT_READ_PORT(base)          (*(base))
 #define DIRECT_MODE_INPUT(base, mask)   ((*((base)-8)) &= ~(mask))
 #define DIRECT_MODE_OUTPUT(base, mask)  ((*((base)-8)) |= (mask))
 #define DIRECT_WRITE_LOW(base, mask)    ((*((base)-4)) &= ~(mask))
 #define DIRECT_WRITE_HIGH(base, mask)   ((*((base)-4)) |= (mask))
 #else
 #define DIRECT_READ(base, mask)         (((*(base)) & (mask)) ? 1 : 0)
+#define DIRECT_READ_PORT(base)          (*(base))
 #define DIRECT_MODE_INPUT(base, mask)   ((*((base)+1)) &= ~(mask))
 #define DIRECT_MODE_OUTPUT(base, mask)  ((*((base)+1)) |= (mask))
 #define DIRECT_WRITE_LOW(base, mask)    ((*((base)+2)) &= ~(mask))
@@ -48,6 +55,7 @@
 #define IO_REG_BASE_ATTR
 #define IO_REG_MASK_ATTR
 #define DIRECT_READ(base, mask)         ((*((base)+16) & (mask)) ? 1 : 0)
+#define DIRECT_READ_PORT(base)          (*((base)+16))
 #define DIRECT_MODE_INPUT(base, mask)   (*((base)+20) &= ~(mask))
 #define DIRECT_MODE_OUTPUT(base, mask)  (*((base)+20) |= (mask))
 #define DIRECT_WRITE_LOW(base, mask)    (*((base)+8) = (mask))
@@ -60,6 +68,7 @@
 #define IO_REG_BASE_ATTR
 #define IO_REG_MASK_ATTR
 #define DIRECT_READ(base, mask)         ((*((base)+2) & (mask)) ? 1 : 0)
+#define DIRECT_READ_PORT(base)          (*((base)+2))
 #define DIRECT_MODE_INPUT(base, mask)   (*((base)+1) &= ~(mask))
 #define DIRECT_MODE_OUTPUT(base, mask)  (*((base)+1) |= (mask))
 #define DIRECT_WRITE_LOW(base, mask)    (*((base)+34) = (mask))
@@ -76,6 +85,7 @@
 #define IO_REG_BASE_ATTR
 #define IO_REG_MASK_ATTR
 #define DIRECT_READ(base, mask)         (((*((base)+15)) & (mask)) ? 1 : 0)
+#define DIRECT_READ_PORT(base)          (*((base)+15))
 #define DIRECT_MODE_INPUT(base, mask)   ((*((base)+5)) = (mask))
 #define DIRECT_MODE_OUTPUT(base, mask)  ((*((base)+4)) = (mask))
 #define DIRECT_WRITE_LOW(base, mask)    ((*((base)+13)) = (mask))
@@ -94,6 +104,7 @@
 #define IO_REG_BASE_ATTR
 #define IO_REG_MASK_ATTR
 #define DIRECT_READ(base, mask)         (((*(base+4)) & (mask)) ? 1 : 0)  //PORTX + 0x10
+#define DIRECT_READ_PORT(base)          (*((base)+4))
 #define DIRECT_MODE_INPUT(base, mask)   ((*(base+2)) = (mask))            //TRISXSET + 0x08
 #define DIRECT_MODE_OUTPUT(base, mask)  ((*(base+1)) = (mask))            //TRISXCLR + 0x04
 #define DIRECT_WRITE_LOW(base, mask)    ((*(base+8+1)) = (mask))          //LATXCLR  + 0x24
@@ -264,14 +275,19 @@ void directModeOutput(IO_REG_TYPE pin)
 #define DIRECT_MODE_OUTPUT(base, pin)   directModeOutput(pin)
 // https://github.com/PaulStoffregen/OneWire/pull/47
 // https://github.com/stickbreaker/OneWire/commit/6eb7fc1c11a15b6ac8c60e5671cf36eb6829f82c
+// A critical section is a spinlock, which also keeps the other core off
+// the bus.  Each bus has its own lock, a portMUX_TYPE *onewire_mux must
+// be in scope where these are used; the slots take it as a parameter.
 #ifdef  interrupts
 #undef  interrupts
 #endif
 #ifdef  noInterrupts
 #undef  noInterrupts
 #endif
-#define noInterrupts() {portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;portENTER_CRITICAL(&mux)
-#define interrupts() portEXIT_CRITICAL(&mux);}
+#define noInterrupts() portENTER_CRITICAL(onewire_mux)
+#define interrupts() portEXIT_CRITICAL(onewire_mux)
+#define ONEWIRE_MUX_PARAM , portMUX_TYPE *onewire_mux
+#define ONEWIRE_MUX_ARG(mux) , (mux)
 //#warning "ESP32 OneWire testing"
 
 #elif defined(ARDUINO_ARCH_STM32)
@@ -293,6 +309,7 @@ void directModeOutput(IO_REG_TYPE pin)
 #define IO_REG_BASE_ATTR
 #define IO_REG_MASK_ATTR
 #define DIRECT_READ(base, mask)         (((*((base)+8)) & (mask)) ? 1 : 0)
+#define DIRECT_READ_PORT(base)          (*((base)+8))
 #define DIRECT_MODE_INPUT(base, mask)   ((*((base)+1)) = (mask))
 #define DIRECT_MODE_OUTPUT(base, mask)  ((*((base)+2)) = (mask))
 #define DIRECT_WRITE_LOW(base, mask)    ((*((base)+5)) = (mask))
@@ -501,6 +518,20 @@ void directWriteHigh(IO_REG_TYPE mask)
 #define DIRECT_MODE_OUTPUT(base, pin)   pinMode(pin,OUTPUT)
 #warning "OneWire. RP2040 in Fallback mode. Using API calls for pinMode,digitalRead and digitalWrite."
 
+#elif ONEWIRE_HOST
+// Linux host build.  There are no pins, every OneWire instance must be
+// given a OneWireBackend.  The direct I/O is inert and reads an idle bus.
+#define PIN_TO_BASEREG(pin)             (0)
+#define PIN_TO_BITMASK(pin)             (pin)
+#define IO_REG_TYPE unsigned int
+#define IO_REG_BASE_ATTR
+#define IO_REG_MASK_ATTR __attribute__ ((unused))
+#define DIRECT_READ(base, pin)          (1)
+#define DIRECT_WRITE_LOW(base, pin)
+#define DIRECT_WRITE_HIGH(base, pin)
+#define DIRECT_MODE_INPUT(base, pin)
+#define DIRECT_MODE_OUTPUT(base, pin)
+
 #else
 #define PIN_TO_BASEREG(pin)             (0)
 #define PIN_TO_BITMASK(pin)             (pin)
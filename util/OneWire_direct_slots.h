@@ -0,0 +1,190 @@
+#ifndef OneWire_Direct_Slots_h
+#define OneWire_Direct_Slots_h
+
+// The reset pulse and bit slots on a direct GPIO pin, shared by OneWire
+// and OneWireFixed.  Include after OneWire_direct_gpio.h (and any
+// redefinition of noInterrupts() and interrupts()).  These are always
+// inlined, so the callers can keep the pin register and mask in local
+// variables across a whole transaction, or as constants for OneWireFixed.
+// The standard speed slot lengths come from a OneWireTiming.
+//
+// SLOT_IRQ_OFF() runs after interrupts are disabled, before the pin is
+// touched, and SLOT_IRQ_ON() after they are enabled again, so a file
+// including this can time each window (OneWire.cpp does, for telemetry,
+// into the bus passed with SLOT_IRQ_ARG).
+//
+// Where the critical sections lock the bus (ESP32), the slots take the
+// lock as a last parameter, passed with ONEWIRE_MUX_ARG(lock).
+
+#ifndef SLOT_IRQ_OFF
+#define SLOT_IRQ_OFF()
+#define SLOT_IRQ_ON()
+#define SLOT_IRQ_PARAM
+#define SLOT_IRQ_ARG
+#endif
+
+#ifndef ONEWIRE_MUX_PARAM
+#define ONEWIRE_MUX_PARAM
+#define ONEWIRE_MUX_ARG(mux)
+#endif
+
+// Perform the onewire reset function.  We will wait up to 250uS for
+// the bus to come high, if it doesn't then it is broken or shorted
+// and we return a 0;
+//
+// Returns 1 if a device asserted a presence pulse, 0 otherwise.
+//
+static inline __attribute__((always_inline))
+uint8_t slot_reset(volatile IO_REG_TYPE *reg, IO_REG_TYPE mask, uint8_t speed,
+	const OneWireTiming *t ONEWIRE_MUX_PARAM SLOT_IRQ_PARAM)
+{
+	uint8_t r;
+	uint8_t retries = 125;
+
+	(void)reg;
+	(void)mask;
+	noInterrupts();
+	SLOT_IRQ_OFF();
+	DIRECT_MODE_INPUT(reg, mask);
+	interrupts();
+	SLOT_IRQ_ON();
+	// wait until the wire is high... just in case
+	do {
+		if (--retries == 0) return 0;
+		delayMicroseconds(2);
+	} while ( !DIRECT_READ(reg, mask));
+
+	if (speed == ONEWIRE_OVERDRIVE) {
+		// the 70us low time must not exceed 80us, so the whole
+		// overdrive reset is done with interrupts disabled
+		noInterrupts();
+		SLOT_IRQ_OFF();
+		DIRECT_WRITE_LOW(reg, mask);
+		DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+		delayMicroseconds(70);
+		DIRECT_MODE_INPUT(reg, mask);	// allow it to float
+		delayMicroseconds(8);
+		r = !DIRECT_READ(reg, mask);
+		interrupts();
+		SLOT_IRQ_ON();
+		delayMicroseconds(40);
+		return r;
+	}
+	noInterrupts();
+	SLOT_IRQ_OFF();
+	DIRECT_WRITE_LOW(reg, mask);
+	DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+	interrupts();
+	SLOT_IRQ_ON();
+	delayMicroseconds(t->reset_low);
+	noInterrupts();
+	SLOT_IRQ_OFF();
+	DIRECT_MODE_INPUT(reg, mask);	// allow it to float
+	delayMicroseconds(t->reset_sample);
+	r = !DIRECT_READ(reg, mask);
+	interrupts();
+	SLOT_IRQ_ON();
+	if (r && t->fast_reset) {
+		// wait for the end of the presence pulse, not the whole time
+		uint16_t left = t->reset_high;
+		while (!DIRECT_READ(reg, mask) && left > 2) {
+			delayMicroseconds(2);
+			left -= 2;
+		}
+		delayMicroseconds(t->reset_recovery);
+	} else {
+		delayMicroseconds(t->reset_high);
+	}
+	return r;
+}
+
+static inline __attribute__((always_inline))
+void slot_write(volatile IO_REG_TYPE *reg, IO_REG_TYPE mask, uint8_t speed,
+	const OneWireTiming *t, uint8_t v ONEWIRE_MUX_PARAM SLOT_IRQ_PARAM)
+{
+	(void)reg;
+	(void)mask;
+	if (speed == ONEWIRE_OVERDRIVE) {
+		if (v & 1) {
+			noInterrupts();
+			SLOT_IRQ_OFF();
+			DIRECT_WRITE_LOW(reg, mask);
+			DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+			delayMicroseconds(1);
+			DIRECT_WRITE_HIGH(reg, mask);	// drive output high
+			interrupts();
+			SLOT_IRQ_ON();
+			delayMicroseconds(8);
+		} else {
+			noInterrupts();
+			SLOT_IRQ_OFF();
+			DIRECT_WRITE_LOW(reg, mask);
+			DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+			delayMicroseconds(8);
+			DIRECT_WRITE_HIGH(reg, mask);	// drive output high
+			interrupts();
+			SLOT_IRQ_ON();
+			delayMicroseconds(2);
+		}
+		return;
+	}
+	if (v & 1) {
+		noInterrupts();
+		SLOT_IRQ_OFF();
+		DIRECT_WRITE_LOW(reg, mask);
+		DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+		delayMicroseconds(t->write1_low);
+		DIRECT_WRITE_HIGH(reg, mask);	// drive output high
+		interrupts();
+		SLOT_IRQ_ON();
+		delayMicroseconds(t->write1_high);
+	} else {
+		noInterrupts();
+		SLOT_IRQ_OFF();
+		DIRECT_WRITE_LOW(reg, mask);
+		DIRECT_MODE_OUTPUT(reg, mask);	// drive output low
+		delayMicroseconds(t->write0_low);
+		DIRECT_WRITE_HIGH(reg, mask);	// drive output high
+		interrupts();
+		SLOT_IRQ_ON();
+		delayMicroseconds(t->write0_high);
+	}
+}
+
+static inline __attribute__((always_inline))
+uint8_t slot_read(volatile IO_REG_TYPE *reg, IO_REG_TYPE mask, uint8_t speed,
+	const OneWireTiming *t ONEWIRE_MUX_PARAM SLOT_IRQ_PARAM)
+{
+	uint8_t r;
+
+	(void)reg;
+	(void)mask;
+	if (speed == ONEWIRE_OVERDRIVE) {
+		noInterrupts();
+		SLOT_IRQ_OFF();
+		DIRECT_MODE_OUTPUT(reg, mask);
+		DIRECT_WRITE_LOW(reg, mask);
+		delayMicroseconds(1);
+		DIRECT_MODE_INPUT(reg, mask);	// let pin float, pull up will raise
+		delayMicroseconds(1);
+		r = DIRECT_READ(reg, mask);
+		interrupts();
+		SLOT_IRQ_ON();
+		delayMicroseconds(8);
+		return r;
+	}
+	noInterrupts();
+	SLOT_IRQ_OFF();
+	DIRECT_MODE_OUTPUT(reg, mask);
+	DIRECT_WRITE_LOW(reg, mask);
+	delayMicroseconds(t->read_low);
+	DIRECT_MODE_INPUT(reg, mask);	// let pin float, pull up will raise
+	delayMicroseconds(t->read_sample);
+	r = DIRECT_READ(reg, mask);
+	interrupts();
+	SLOT_IRQ_ON();
+	delayMicroseconds(t->read_high);
+	return r;
+}
+
+#endif
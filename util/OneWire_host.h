@@ -0,0 +1,49 @@
+#ifndef OneWire_Host_h
+#define OneWire_Host_h
+
+// Minimal stand-ins for the Arduino core functions used by OneWire, so
+// the library can be compiled and run on a Linux host.  Time is virtual:
+// delayMicroseconds() advances a clock rather than sleeping, and the
+// host backends (OneWireSim, etc) advance the same clock for each slot
+// they perform.  So micros() measures bus time, not CPU time.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define INPUT  0
+#define OUTPUT 1
+#define LOW    0
+#define HIGH   1
+
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef pgm_read_byte
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+// One clock shared by every translation unit (inline functions with a
+// static local are merged by the linker).
+inline uint64_t & onewire_host_clock()
+{
+	static uint64_t usec = 0;
+	return usec;
+}
+
+inline void delayMicroseconds(unsigned int us) { onewire_host_clock() += us; }
+inline void delay(unsigned long ms) { onewire_host_clock() += (uint64_t)ms * 1000; }
+inline unsigned long micros(void) { return (unsigned long)onewire_host_clock(); }
+inline unsigned long millis(void) { return (unsigned long)(onewire_host_clock() / 1000); }
+
+inline void pinMode(uint8_t, uint8_t) { }
+inline int digitalRead(uint8_t) { return HIGH; }
+inline void digitalWrite(uint8_t, uint8_t) { }
+
+// Nothing to protect on the host, the backends are not interrupt driven
+#define noInterrupts()
+#define interrupts()
+
+#endif